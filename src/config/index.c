@@ -0,0 +1,164 @@
+/* Copyright (C) 2016-2021 Shengyu Zhang <i@silverrainz.me>
+ *
+ * This file is part of Srain.
+ *
+ * Srain is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file index.c
+ * @brief Name index of server and chat groups of a libconfig configuration,
+ * so that configuration readers need not to walk lists linearly
+ * @author Shengyu Zhang <i@silverrainz.me>
+ * @version 1.2.0
+ * @date 2021-03-08
+ */
+
+#include <glib.h>
+#include <libconfig.h>
+
+#include "config/config.h"
+#include "./index.h"
+
+#include "log.h"
+
+struct _SrnConfigIndex {
+    GHashTable *server_table; // Name -> GPtrArray of groups in "server-list"
+    GHashTable *chat_table; // Name -> GPtrArray of groups in "server.chat-list"
+    GHashTable *server_chat_table; // Server group -> chat table of its "chat-list"
+};
+
+static GHashTable* index_setting_list(config_setting_t *list);
+
+/**
+ * @brief srn_config_index_new builds index of given configuration, the index
+ * becomes invalid once the configuration is destroyed.
+ *
+ * @param cfg
+ *
+ * @return A new SrnConfigIndex.
+ */
+SrnConfigIndex* srn_config_index_new(config_t *cfg){
+    GHashTableIter iter;
+    GPtrArray *servers;
+    SrnConfigIndex *self;
+
+    self = g_malloc0(sizeof(SrnConfigIndex));
+    self->server_table = index_setting_list(config_lookup(cfg, "server-list"));
+    self->chat_table = index_setting_list(config_lookup(cfg, "server.chat-list"));
+    self->server_chat_table = g_hash_table_new_full(g_direct_hash,
+            g_direct_equal, NULL, (GDestroyNotify)g_hash_table_destroy);
+
+    g_hash_table_iter_init(&iter, self->server_table);
+    while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&servers)){
+        for (int i = 0; i < servers->len; i++){
+            config_setting_t *server;
+
+            server = g_ptr_array_index(servers, i);
+            g_hash_table_insert(self->server_chat_table, server,
+                    index_setting_list(config_setting_lookup(server, "chat-list")));
+        }
+    }
+
+    DBG_FR("Indexed %d servers and %d chats",
+            g_hash_table_size(self->server_table),
+            g_hash_table_size(self->chat_table));
+
+    return self;
+}
+
+void srn_config_index_free(SrnConfigIndex *self){
+    g_hash_table_destroy(self->server_chat_table);
+    g_hash_table_destroy(self->chat_table);
+    g_hash_table_destroy(self->server_table);
+    g_free(self);
+}
+
+/**
+ * @brief srn_config_index_lookup_server looks up groups in "server-list"
+ * with given name.
+ *
+ * @return A GPtrArray of config_setting_t in order of appearance, or NULL.
+ */
+GPtrArray* srn_config_index_lookup_server(SrnConfigIndex *self,
+        const char *srv_name){
+    if (!srv_name){
+        return NULL;
+    }
+    return g_hash_table_lookup(self->server_table, srv_name);
+}
+
+/**
+ * @brief srn_config_index_lookup_chat looks up groups in "chat-list" with
+ * given name.
+ *
+ * @param self
+ * @param server is a group returned by srn_config_index_lookup_server(),
+ * if NULL, looks up in "server.chat-list".
+ * @param chat_name
+ *
+ * @return A GPtrArray of config_setting_t in order of appearance, or NULL.
+ */
+GPtrArray* srn_config_index_lookup_chat(SrnConfigIndex *self,
+        config_setting_t *server, const char *chat_name){
+    GHashTable *chat_table;
+
+    if (!chat_name){
+        return NULL;
+    }
+    if (server){
+        chat_table = g_hash_table_lookup(self->server_chat_table, server);
+    } else {
+        chat_table = self->chat_table;
+    }
+    if (!chat_table){
+        return NULL;
+    }
+    return g_hash_table_lookup(chat_table, chat_name);
+}
+
+/**
+ * @brief index_setting_list indexes groups of a list by their "name" setting.
+ * Keys of returned table is owned by the configuration.
+ */
+static GHashTable* index_setting_list(config_setting_t *list){
+    GHashTable *table;
+
+    table = g_hash_table_new_full(g_str_hash, g_str_equal,
+            NULL, (GDestroyNotify)g_ptr_array_unref);
+    if (!list){
+        return table;
+    }
+
+    for (int i = 0, count = config_setting_length(list); i < count; i++){
+        const char *name = NULL;
+        GPtrArray *settings;
+        config_setting_t *setting;
+
+        setting = config_setting_get_elem(list, i);
+        if (!setting) break;
+        if (config_setting_lookup_string(setting, "name", &name) != CONFIG_TRUE){
+            continue;
+        }
+
+        settings = g_hash_table_lookup(table, name);
+        if (!settings){
+            settings = g_ptr_array_new();
+            g_hash_table_insert(table, (char *)name, settings);
+        }
+        g_ptr_array_add(settings, setting);
+    }
+
+    return table;
+}
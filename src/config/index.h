@@ -0,0 +1,34 @@
+/* Copyright (C) 2016-2021 Shengyu Zhang <i@silverrainz.me>
+ *
+ * This file is part of Srain.
+ *
+ * Srain is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Internal header file */
+
+#ifndef __IN_INDEX_H
+#define __IN_INDEX_H
+
+#include <glib.h>
+#include <libconfig.h>
+
+#include "config/config.h"
+
+SrnConfigIndex* srn_config_index_new(config_t *cfg);
+void srn_config_index_free(SrnConfigIndex *self);
+GPtrArray* srn_config_index_lookup_server(SrnConfigIndex *self, const char *srv_name);
+GPtrArray* srn_config_index_lookup_chat(SrnConfigIndex *self, config_setting_t *server, const char *chat_name);
+
+#endif /* __IN_INDEX_H */
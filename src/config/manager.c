@@ -30,6 +30,7 @@
 
 #include "config/config.h"
 #include "./password2.h"
+#include "./index.h"
 
 #include "log.h"
 #include "path.h"
@@ -37,7 +38,8 @@
 #include "version.h"
 
 
-static SrnRet load_config(SrnConfigManager *mgr, config_t *cfg, const char *file);
+static SrnRet load_config(SrnConfigManager *mgr, config_t *cfg,
+        SrnConfigIndex **index, const char *file);
 
 SrnConfigManager *srn_config_manager_new(SrnVersion *ver){
     SrnConfigManager *mgr;
@@ -46,12 +48,18 @@ SrnConfigManager *srn_config_manager_new(SrnVersion *ver){
     mgr->ver = ver;
     config_init(&mgr->user_cfg);
     config_init(&mgr->system_cfg);
+    mgr->user_index = srn_config_index_new(&mgr->user_cfg);
+    mgr->system_index = srn_config_index_new(&mgr->system_cfg);
     srn_config_manager_init_secret_schema(mgr);
+    srn_config_manager_init_secret_cache(mgr);
 
     return mgr;
 }
 
 void srn_config_manager_free(SrnConfigManager *mgr){
+    srn_config_manager_finalize_secret_cache(mgr);
+    srn_config_index_free(mgr->user_index);
+    srn_config_index_free(mgr->system_index);
     config_destroy(&mgr->user_cfg);
     config_destroy(&mgr->system_cfg);
     g_free(mgr);
@@ -61,7 +69,7 @@ SrnRet srn_config_manager_load_system_config(SrnConfigManager *mgr,
         const char *file){
     SrnRet ret;
 
-    ret = load_config(mgr, &mgr->system_cfg, file);
+    ret = load_config(mgr, &mgr->system_cfg, &mgr->system_index, file);
     if (!RET_IS_OK(ret)){
         return RET_ERR(_("Failed to read system configuration file: %1$s"),
                 RET_MSG(ret));
@@ -73,7 +81,7 @@ SrnRet srn_config_manager_load_user_config(SrnConfigManager *mgr,
         const char *file){
     SrnRet ret;
 
-    ret = load_config(mgr, &mgr->user_cfg, file);
+    ret = load_config(mgr, &mgr->user_cfg, &mgr->user_index, file);
     if (!RET_IS_OK(ret)){
         return RET_ERR(_("Failed to read user configuration file: %1$s"),
                 RET_MSG(ret));
@@ -81,13 +89,15 @@ SrnRet srn_config_manager_load_user_config(SrnConfigManager *mgr,
     return SRN_OK;
 }
 
-static SrnRet load_config(SrnConfigManager *mgr, config_t *cfg, const char *file){
+static SrnRet load_config(SrnConfigManager *mgr, config_t *cfg,
+        SrnConfigIndex **index, const char *file){
     char *dir;
     // const char *rawver;
     SrnVersion *ver;
     SrnRet ret;
 
     /* Clear previous config */
+    srn_config_index_free(*index);
     config_destroy(cfg);
     config_init(cfg);
 
@@ -127,6 +137,9 @@ static SrnRet load_config(SrnConfigManager *mgr, config_t *cfg, const char *file
 
     ret = SRN_OK;
 FIN:
+    /* Index is always rebuilt because readers work on the partially loaded
+     * configuration too */
+    *index = srn_config_index_new(cfg);
     if (dir){
         g_free(dir);
     }
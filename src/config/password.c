@@ -26,6 +26,28 @@
 #include "ret.h"
 #include "meta.h"
 #include "i18n.h"
+#include "log.h"
+
+typedef struct _SrnSecretWaiter SrnSecretWaiter;
+
+struct _SrnSecretWaiter {
+    SrnConfigPasswordCallback callback;
+    gpointer user_data;
+    GDestroyNotify destroy;
+};
+
+typedef struct _SrnSecretLookup SrnSecretLookup;
+
+struct _SrnSecretLookup {
+    SrnConfigManager *mgr;
+    char *key;
+};
+
+static char* secret_key_new(SecretSchema *schema, const char *attr1, const char *attr2);
+static bool lookup_secret_cache(SrnConfigManager *mgr, const char *key, char **passwd);
+static void update_secret_cache(SrnConfigManager *mgr, const char *key, const char *passwd);
+static void on_password_lookup(GObject *source, GAsyncResult *result, gpointer user_data);
+static void srn_secret_waiter_free(SrnSecretWaiter *waiter);
 
 void srn_config_manager_init_secret_schema(SrnConfigManager *mgr){
     static SecretSchema srv_secret_schema = {
@@ -76,6 +98,30 @@ void srn_config_manager_init_secret_schema(SrnConfigManager *mgr){
     mgr->user_secret_schema = &user_secret_schema;
 }
 
+void srn_config_manager_init_secret_cache(SrnConfigManager *mgr){
+    mgr->secret_cache = g_hash_table_new_full(g_str_hash, g_str_equal,
+            g_free, g_free);
+    mgr->secret_pending_table = g_hash_table_new_full(g_str_hash, g_str_equal,
+            g_free, NULL);
+    mgr->secret_cancellable = g_cancellable_new();
+}
+
+void srn_config_manager_finalize_secret_cache(SrnConfigManager *mgr){
+    GHashTableIter iter;
+    GSList *waiters;
+
+    /* Callbacks of cancelled lookups will not touch the manager */
+    g_cancellable_cancel(mgr->secret_cancellable);
+    g_object_unref(mgr->secret_cancellable);
+
+    g_hash_table_iter_init(&iter, mgr->secret_pending_table);
+    while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&waiters)){
+        g_slist_free_full(waiters, (GDestroyNotify)srn_secret_waiter_free);
+    }
+    g_hash_table_destroy(mgr->secret_pending_table);
+    g_hash_table_destroy(mgr->secret_cache);
+}
+
 SecretSchema* srn_config_manager_get_server_secret_schema(SrnConfigManager *mgr) {
     return mgr->srv_secret_schema;
 }
@@ -91,11 +137,18 @@ SecretSchema* srn_config_manager_get_user_secret_schema(SrnConfigManager *mgr) {
 SrnRet srn_config_manager_lookup_server_password(SrnConfigManager *mgr,
         char **passwd, const char *srv_name){
     char *tmp;
+    char *key;
     GError *err;
     SrnRet ret;
 
     g_return_val_if_fail(passwd, SRN_ERR);
 
+    key = secret_key_new(mgr->srv_secret_schema, srv_name, NULL);
+    if (lookup_secret_cache(mgr, key, passwd)){
+        g_free(key);
+        return SRN_OK;
+    }
+
     err = NULL;
     ret = SRN_OK;
     tmp = secret_password_lookup_sync(mgr->srv_secret_schema, NULL, &err,
@@ -104,12 +157,15 @@ SrnRet srn_config_manager_lookup_server_password(SrnConfigManager *mgr,
     if (err) {
         ret = RET_ERR("%s", err->message);
         g_error_free(err);
+    } else {
+        update_secret_cache(mgr, key, tmp);
     }
     if (tmp) {
         // Make sure the returnd password can be freed by g_free().
         *passwd = g_strdup(tmp);
         secret_password_free(tmp);
     }
+    g_free(key);
 
     return ret;
 }
@@ -129,6 +185,12 @@ SrnRet srn_config_manager_store_server_password(SrnConfigManager *mgr,
     if (err) {
         ret = RET_ERR("%s", err->message);
         g_error_free(err);
+    } else {
+        char *key;
+
+        key = secret_key_new(mgr->srv_secret_schema, srv_name, NULL);
+        update_secret_cache(mgr, key, passwd);
+        g_free(key);
     }
 
     return ret;
@@ -146,6 +208,12 @@ SrnRet srn_config_manager_clear_server_password(SrnConfigManager *mgr, const cha
     if (err) {
         ret = RET_ERR("%s", err->message);
         g_error_free(err);
+    } else {
+        char *key;
+
+        key = secret_key_new(mgr->srv_secret_schema, srv_name, NULL);
+        update_secret_cache(mgr, key, NULL);
+        g_free(key);
     }
 
     return ret;
@@ -154,11 +222,18 @@ SrnRet srn_config_manager_clear_server_password(SrnConfigManager *mgr, const cha
 SrnRet srn_config_manager_lookup_channel_password(SrnConfigManager *mgr,
         char **passwd, const char *srv_name, const char *chan_name){
     char *tmp;
+    char *key;
     GError *err;
     SrnRet ret;
 
     g_return_val_if_fail(passwd, SRN_ERR);
 
+    key = secret_key_new(mgr->chan_secret_schema, srv_name, chan_name);
+    if (lookup_secret_cache(mgr, key, passwd)){
+        g_free(key);
+        return SRN_OK;
+    }
+
     err = NULL;
     ret = SRN_OK;
     tmp = secret_password_lookup_sync(mgr->chan_secret_schema, NULL, &err,
@@ -168,12 +243,15 @@ SrnRet srn_config_manager_lookup_channel_password(SrnConfigManager *mgr,
     if (err) {
         ret = RET_ERR("%s", err->message);
         g_error_free(err);
+    } else {
+        update_secret_cache(mgr, key, tmp);
     }
     if (tmp) {
         // Make sure the returnd password can be freed by g_free().
         *passwd = g_strdup(tmp);
         secret_password_free(tmp);
     }
+    g_free(key);
 
     return ret;
 }
@@ -194,6 +272,12 @@ SrnRet srn_config_manager_store_channel_password(SrnConfigManager *mgr,
     if (err) {
         ret = RET_ERR("%s", err->message);
         g_error_free(err);
+    } else {
+        char *key;
+
+        key = secret_key_new(mgr->chan_secret_schema, srv_name, chan_name);
+        update_secret_cache(mgr, key, passwd);
+        g_free(key);
     }
 
     return ret;
@@ -213,6 +297,12 @@ SrnRet srn_config_manager_clear_channel_password(SrnConfigManager *mgr,
     if (err) {
         ret = RET_ERR("%s", err->message);
         g_error_free(err);
+    } else {
+        char *key;
+
+        key = secret_key_new(mgr->chan_secret_schema, srv_name, chan_name);
+        update_secret_cache(mgr, key, NULL);
+        g_free(key);
     }
 
     return ret;
@@ -221,11 +311,18 @@ SrnRet srn_config_manager_clear_channel_password(SrnConfigManager *mgr,
 SrnRet srn_config_manager_lookup_user_password(SrnConfigManager *mgr,
         char **passwd, const char *srv_name, const char *user_name){
     char *tmp;
+    char *key;
     GError *err;
     SrnRet ret;
 
     g_return_val_if_fail(passwd, SRN_ERR);
 
+    key = secret_key_new(mgr->user_secret_schema, srv_name, user_name);
+    if (lookup_secret_cache(mgr, key, passwd)){
+        g_free(key);
+        return SRN_OK;
+    }
+
     err = NULL;
     ret = SRN_OK;
     tmp = secret_password_lookup_sync(mgr->user_secret_schema, NULL, &err,
@@ -235,12 +332,15 @@ SrnRet srn_config_manager_lookup_user_password(SrnConfigManager *mgr,
     if (err) {
         ret = RET_ERR("%s", err->message);
         g_error_free(err);
+    } else {
+        update_secret_cache(mgr, key, tmp);
     }
     if (tmp) {
         // Make sure the returnd password can be freed by g_free().
         *passwd = g_strdup(tmp);
         secret_password_free(tmp);
     }
+    g_free(key);
 
     return ret;
 }
@@ -261,6 +361,12 @@ SrnRet srn_config_manager_store_user_password(SrnConfigManager *mgr,
     if (err) {
         ret = RET_ERR("%s", err->message);
         g_error_free(err);
+    } else {
+        char *key;
+
+        key = secret_key_new(mgr->user_secret_schema, srv_name, user_name);
+        update_secret_cache(mgr, key, passwd);
+        g_free(key);
     }
 
     return ret;
@@ -280,7 +386,160 @@ SrnRet srn_config_manager_clear_user_password(SrnConfigManager *mgr,
     if (err) {
         ret = RET_ERR("%s", err->message);
         g_error_free(err);
+    } else {
+        char *key;
+
+        key = secret_key_new(mgr->user_secret_schema, srv_name, user_name);
+        update_secret_cache(mgr, key, NULL);
+        g_free(key);
     }
 
     return ret;
 }
+
+/**
+ * @brief srn_config_manager_lookup_channel_password_async looks up channel
+ * password without blocking the main loop, the result is cached so
+ * subsequent lookups of the same channel are free.
+ *
+ * @param mgr
+ * @param passwd is filled with the password if it is already cached.
+ * @param srv_name
+ * @param chan_name
+ * @param callback is called with the password when the lookup finishes, the
+ * password is NULL if there is no password or the lookup fails. It is not
+ * called if the password is already cached or the manager is finalized.
+ * @param user_data
+ * @param destroy is used to free user_data, can be NULL.
+ *
+ * @return TRUE if the password is cached.
+ */
+bool srn_config_manager_lookup_channel_password_async(SrnConfigManager *mgr,
+        char **passwd, const char *srv_name, const char *chan_name,
+        SrnConfigPasswordCallback callback, gpointer user_data,
+        GDestroyNotify destroy){
+    char *key;
+    GSList *waiters;
+    SrnSecretWaiter *waiter;
+    SrnSecretLookup *lookup;
+
+    g_return_val_if_fail(passwd, FALSE);
+
+    key = secret_key_new(mgr->chan_secret_schema, srv_name, chan_name);
+    if (lookup_secret_cache(mgr, key, passwd)){
+        if (destroy){
+            destroy(user_data);
+        }
+        g_free(key);
+        return TRUE;
+    }
+
+    waiter = g_malloc0(sizeof(SrnSecretWaiter));
+    waiter->callback = callback;
+    waiter->user_data = user_data;
+    waiter->destroy = destroy;
+
+    /* Only one D-Bus round trip for the same password */
+    if (g_hash_table_lookup_extended(mgr->secret_pending_table, key,
+                NULL, (gpointer *)&waiters)){
+        g_hash_table_insert(mgr->secret_pending_table, key,
+                g_slist_prepend(waiters, waiter));
+        return FALSE;
+    }
+    g_hash_table_insert(mgr->secret_pending_table, g_strdup(key),
+            g_slist_prepend(NULL, waiter));
+
+    lookup = g_malloc0(sizeof(SrnSecretLookup));
+    lookup->mgr = mgr;
+    lookup->key = key;
+    secret_password_lookup(mgr->chan_secret_schema,
+            mgr->secret_cancellable, on_password_lookup, lookup,
+            SRN_CONFIG_SECRET_SCHEMA_ATTR_SERVER, srv_name,
+            SRN_CONFIG_SECRET_SCHEMA_ATTR_CHANNEL, chan_name,
+            NULL);
+
+    return FALSE;
+}
+
+static char* secret_key_new(SecretSchema *schema, const char *attr1,
+        const char *attr2){
+    return g_strdup_printf("%s\n%s\n%s",
+            schema->name, attr1 ? attr1 : "", attr2 ? attr2 : "");
+}
+
+static bool lookup_secret_cache(SrnConfigManager *mgr, const char *key,
+        char **passwd){
+    const char *val;
+
+    if (!g_hash_table_lookup_extended(mgr->secret_cache, key,
+                NULL, (gpointer *)&val)){
+        return FALSE;
+    }
+    if (val){
+        g_free(*passwd);
+        *passwd = g_strdup(val);
+    }
+    return TRUE;
+}
+
+static void update_secret_cache(SrnConfigManager *mgr, const char *key,
+        const char *passwd){
+    g_hash_table_insert(mgr->secret_cache, g_strdup(key), g_strdup(passwd));
+}
+
+static void on_password_lookup(GObject *source, GAsyncResult *result,
+        gpointer user_data){
+    char *passwd;
+    GError *err;
+    GSList *lst;
+    GSList *waiters;
+    SrnConfigManager *mgr;
+    SrnSecretLookup *lookup;
+
+    lookup = user_data;
+    err = NULL;
+    passwd = secret_password_lookup_finish(result, &err);
+    if (g_error_matches(err, G_IO_ERROR, G_IO_ERROR_CANCELLED)){
+        // Manager has been freed
+        g_error_free(err);
+        goto FIN;
+    }
+
+    mgr = lookup->mgr;
+    if (err){
+        WARN_FR(_("Error occurred while looking up channel password: %1$s"),
+                err->message);
+        g_error_free(err);
+    } else {
+        update_secret_cache(mgr, lookup->key, passwd);
+    }
+
+    waiters = NULL;
+    g_hash_table_lookup_extended(mgr->secret_pending_table, lookup->key,
+            NULL, (gpointer *)&waiters);
+    g_hash_table_remove(mgr->secret_pending_table, lookup->key);
+
+    waiters = g_slist_reverse(waiters);
+    for (lst = waiters; lst; lst = g_slist_next(lst)){
+        SrnSecretWaiter *waiter;
+
+        waiter = lst->data;
+        // Waiters still get a callback on failure, e.g. JOIN without key
+        waiter->callback(mgr, passwd, waiter->user_data);
+    }
+    g_slist_free_full(waiters, (GDestroyNotify)srn_secret_waiter_free);
+
+FIN:
+    if (passwd){
+        secret_password_free(passwd);
+    }
+    g_free(lookup->key);
+    g_free(lookup);
+}
+
+static void srn_secret_waiter_free(SrnSecretWaiter *waiter){
+    if (waiter->destroy){
+        waiter->destroy(waiter->user_data);
+    }
+    g_free(waiter);
+}
@@ -25,5 +25,7 @@
 #include "config/password.h"
 
 void srn_config_manager_init_secret_schema(SrnConfigManager *mgr);
+void srn_config_manager_init_secret_cache(SrnConfigManager *mgr);
+void srn_config_manager_finalize_secret_cache(SrnConfigManager *mgr);
 
 #endif /* __IN_PASSWORD_H */
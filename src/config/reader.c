@@ -30,6 +30,7 @@
 #include "core/core.h"
 #include "config/config.h"
 #include "config/password.h"
+#include "./index.h"
 #include "i18n.h"
 #include "utils.h"
 #include "log.h"
@@ -38,6 +39,7 @@
 static int config_lookup_string_ex(const config_t *config, const char *path, char **value);
 static int config_setting_lookup_string_ex(const config_setting_t *config, const char *name, char **value);
 static char* config_setting_get_string_elem_ex(const config_setting_t *setting, int index);
+static int config_setting_lookup_string_list_ex(config_setting_t *config, const char *name, GList **lst);
 static int config_lookup_bool_ex(const config_t *config, const char *name, bool *value);
 static int config_setting_lookup_bool_ex(const config_setting_t *config, const char *name, bool *value);
 
@@ -49,12 +51,12 @@ static SrnRet read_application_config_from_cfg(config_t *cfg, SrnApplicationConf
 
 static SrnRet read_server_config_list_from_cfg(config_t *cfg, GList **srv_cfg_list);
 static SrnRet read_server_config_from_server(config_setting_t *server, SrnServerConfig *cfg);
-static SrnRet read_server_config_from_server_list(config_setting_t *server_list, SrnServerConfig *cfg, const char *srv_name);
-static SrnRet read_server_config_from_cfg(config_t *cfg, SrnServerConfig *srv_cfg, const char *srv_name);
+static SrnRet read_server_config_from_cfg(config_t *cfg, SrnConfigIndex *index, SrnServerConfig *srv_cfg, const char *srv_name);
 
 static SrnRet read_chat_config_from_chat(config_setting_t *chat, SrnChatConfig *cfg);
-static SrnRet read_chat_config_from_chat_list(config_setting_t *chat_list, SrnChatConfig *cfg, const char *chat_name);
-static SrnRet read_chat_config_from_cfg(config_t *cfg, SrnChatConfig *chat_cfg, const char *srv_name, const char *chat_name);
+static SrnRet read_chat_config_from_chats(GPtrArray *chats, SrnChatConfig *cfg);
+static SrnRet read_chat_config_from_cfg(config_t *cfg, SrnConfigIndex *index, SrnChatConfig *chat_cfg, const char *srv_name, const char *chat_name);
+static void on_channel_password_lookup(SrnConfigManager *mgr, const char *passwd, gpointer user_data);
 
 static SrnRet read_user_config_from_user(config_setting_t *user, SrnUserConfig *cfg);
 
@@ -126,13 +128,15 @@ SrnRet srn_config_manager_read_server_config(SrnConfigManager *mgr,
         SrnServerConfig *cfg, const char *srv_name){
     SrnRet ret;
 
-    ret = read_server_config_from_cfg(&mgr->system_cfg, cfg, srv_name);
+    ret = read_server_config_from_cfg(&mgr->system_cfg, mgr->system_index,
+            cfg, srv_name);
     if (!RET_IS_OK(ret)){
         return RET_ERR(_("Error occurred while reading server config in %1$s: %2$s"),
                 config_setting_source_file(config_root_setting(&mgr->system_cfg)),
                 RET_MSG(ret));
     }
-    ret = read_server_config_from_cfg(&mgr->user_cfg, cfg, srv_name);
+    ret = read_server_config_from_cfg(&mgr->user_cfg, mgr->user_index,
+            cfg, srv_name);
     if (!RET_IS_OK(ret)){
         return RET_ERR(_("Error occurred while reading server config in %1$s: %2$s"),
                 config_setting_source_file(config_root_setting(&mgr->user_cfg)),
@@ -207,26 +211,34 @@ SrnRet srn_config_manager_read_chat_config(SrnConfigManager *mgr,
         SrnChatConfig *cfg, const char *srv_name, const char *chat_name){
     SrnRet ret;
 
-    ret = read_chat_config_from_cfg(&mgr->system_cfg, cfg, srv_name, chat_name);
+    ret = read_chat_config_from_cfg(&mgr->system_cfg, mgr->system_index,
+            cfg, srv_name, chat_name);
     if (!RET_IS_OK(ret)){
         return RET_ERR(_("Error occurred while reading chat config in %1$s: %2$s"),
                 config_setting_source_file(config_root_setting(&mgr->system_cfg)),
                 RET_MSG(ret));
     }
 
-    ret = read_chat_config_from_cfg(&mgr->user_cfg, cfg, srv_name, chat_name);
+    ret = read_chat_config_from_cfg(&mgr->user_cfg, mgr->user_index,
+            cfg, srv_name, chat_name);
     if (!RET_IS_OK(ret)){
         return RET_ERR(_("Error occurred while reading chat config in %1$s: %2$s"),
                 config_setting_source_file(config_root_setting(&mgr->user_cfg)),
                 RET_MSG(ret));
     }
 
-    // In fact we don't known whether this chat is channel
-    ret = srn_config_manager_lookup_channel_password(mgr,
-            &cfg->password, srv_name, chat_name);
-    if (!RET_IS_OK(ret)){
-        WARN_FR(_("Error occurred while looking up channel password: %1$s"),
-                RET_MSG(ret));
+    // In fact we don't known whether this chat is channel.
+    // The chat is not yet created now, the password will be filled in once
+    // the lookup finishes, see on_channel_password_lookup().
+    if (srv_name && chat_name){
+        char **names;
+
+        names = g_new0(char *, 3);
+        names[0] = g_strdup(srv_name);
+        names[1] = g_strdup(chat_name);
+        srn_config_manager_lookup_channel_password_async(mgr, &cfg->password,
+                srv_name, chat_name, on_channel_password_lookup, names,
+                (GDestroyNotify)g_strfreev);
     }
 
     return SRN_OK;
@@ -436,33 +448,10 @@ static SrnRet read_server_config_from_server(config_setting_t *server,
     return SRN_OK;
 }
 
-static SrnRet read_server_config_from_server_list(config_setting_t *server_list,
-        SrnServerConfig *cfg, const char *srv_name){
-    int count;
-    SrnRet ret;
-
-    count = config_setting_length(server_list);
-    for (int i = 0; i < count; i++){
-        const char *name = NULL;
-        config_setting_t *server;
-
-        server = config_setting_get_elem(server_list, i);
-        if (!server) break;
-
-        config_setting_lookup_string(server, "name", &name);
-        if (g_strcmp0(srv_name, name) != 0) continue;
-
-        DBG_FR("Read: server-list.[name = %s], srv_name: %s", name, srv_name);
-        ret = read_server_config_from_server(server, cfg);
-        if (!RET_IS_OK(ret)) return ret;
-    }
-
-    return SRN_OK;
-}
-
-static SrnRet read_server_config_from_cfg(config_t *cfg, SrnServerConfig *srv_cfg,
-        const char *srv_name){
+static SrnRet read_server_config_from_cfg(config_t *cfg, SrnConfigIndex *index,
+        SrnServerConfig *srv_cfg, const char *srv_name){
     SrnRet ret;
+    GPtrArray *servers;
     config_setting_t *server;
 
     /* Read server */
@@ -474,11 +463,11 @@ static SrnRet read_server_config_from_cfg(config_t *cfg, SrnServerConfig *srv_cf
     }
 
     /* Read server_list[name = srv_name] */
-    config_setting_t *server_list;
-
-    server_list = config_lookup(cfg, "server-list");
-    if (server_list){
-        ret = read_server_config_from_server_list(server_list, srv_cfg, srv_name);
+    servers = srn_config_index_lookup_server(index, srv_name);
+    for (int i = 0; servers && i < servers->len; i++){
+        DBG_FR("Read: server-list.[name = %s]", srv_name);
+        ret = read_server_config_from_server(
+                g_ptr_array_index(servers, i), srv_cfg);
         if (!RET_IS_OK(ret)) return ret;
     }
 
@@ -486,14 +475,24 @@ static SrnRet read_server_config_from_cfg(config_t *cfg, SrnServerConfig *srv_cf
 }
 
 static SrnRet read_chat_config_from_chat(config_setting_t *chat, SrnChatConfig *cfg){
+    const char *priority;
+
+    config_setting_lookup_bool_ex(chat, "log", &cfg->log);
+    config_setting_lookup_bool_ex(chat, "snapshot", &cfg->snapshot);
     config_setting_lookup_bool_ex(chat, "notify", &cfg->ui->notify);
     config_setting_lookup_bool_ex(chat, "show-topic", &cfg->ui->show_topic);
     config_setting_lookup_bool_ex(chat, "show-avatar", &cfg->ui->show_avatar);
     config_setting_lookup_bool_ex(chat, "show-user-list", &cfg->ui->show_user_list);
     config_setting_lookup_bool_ex(chat, "render-mirc-color", &cfg->render_mirc_color);
+    if (config_setting_lookup_string(chat, "priority", &priority)){
+        cfg->priority = srn_chat_priority_from_string(priority);
+    }
+    config_setting_lookup_int(chat, "presence-window", &cfg->presence_window);
     config_setting_lookup_bool_ex(chat, "preview-url", &cfg->ui->preview_url);
     config_setting_lookup_bool_ex(chat, "auto-preview-url", &cfg->ui->auto_preview_url);
     config_setting_lookup_string_ex(chat, "nick-completion-suffix", &cfg->ui->nick_completion_suffix);
+    config_setting_lookup_string_list_ex(chat, "highlight", &cfg->highlight_list);
+    config_setting_lookup_string_list_ex(chat, "never-highlight", &cfg->never_highlight_list);
 
     /* Read autorun command list */
     config_setting_t *cmds;
@@ -516,32 +515,21 @@ static SrnRet read_chat_config_from_chat(config_setting_t *chat, SrnChatConfig *
     return SRN_OK;
 }
 
-static SrnRet read_chat_config_from_chat_list(config_setting_t *chat_list,
-        SrnChatConfig *cfg, const char *chat_name){
+static SrnRet read_chat_config_from_chats(GPtrArray *chats, SrnChatConfig *cfg){
     SrnRet ret;
 
-    for (int i = 0, count = config_setting_length(chat_list); i < count; i++){
-        const char *name = NULL;
-        config_setting_t *chat;
-
-        chat = config_setting_get_elem(chat_list, i);
-        if (!chat) break;
-        if (config_setting_lookup_string(chat, "name", &name) != CONFIG_TRUE){
-            continue;
-        }
-        if (g_strcmp0(chat_name, name) != 0) continue;
-
-        DBG_FR("Read: chat-list.%s, chat_name: %s", name, chat_name);
-        ret = read_chat_config_from_chat(chat, cfg);
+    for (int i = 0; chats && i < chats->len; i++){
+        ret = read_chat_config_from_chat(g_ptr_array_index(chats, i), cfg);
         if (!RET_IS_OK(ret)) return ret;
     }
 
     return SRN_OK;
 }
 
-static SrnRet read_chat_config_from_cfg(config_t *cfg, SrnChatConfig *chat_cfg,
-        const char *srv_name, const char *chat_name){
+static SrnRet read_chat_config_from_cfg(config_t *cfg, SrnConfigIndex *index,
+        SrnChatConfig *chat_cfg, const char *srv_name, const char *chat_name){
     SrnRet ret;
+    GPtrArray *servers;
 
     /* Read server.chat */
     config_setting_t *chat;
@@ -554,56 +542,61 @@ static SrnRet read_chat_config_from_cfg(config_t *cfg, SrnChatConfig *chat_cfg,
     }
 
     /* Read server.chat_list[name = chat_name] */
-    if (chat_name){
-        config_setting_t *chat_list;
+    ret = read_chat_config_from_chats(
+            srn_config_index_lookup_chat(index, NULL, chat_name), chat_cfg);
+    if (!RET_IS_OK(ret)) return ret;
 
-        chat_list = config_lookup(cfg, "server.chat-list");
-        if (chat_list){
-            ret = read_chat_config_from_chat_list(chat_list, chat_cfg, chat_name);
-            if (!RET_IS_OK(ret)) return ret;
-        }
-    }
+    servers = srn_config_index_lookup_server(index, srv_name);
+    for (int i = 0; servers && i < servers->len; i++){
+        config_setting_t *server;
 
-    if (srv_name){
-        config_setting_t *server_list;
+        server = g_ptr_array_index(servers, i);
 
-        server_list = config_lookup(cfg, "server-list");
-        if (server_list){
-            for (int i = 0, count = config_setting_length(server_list); i < count; i++){
-                const char *name = NULL;
-                config_setting_t *server;
-                config_setting_t *chat;
+        /* Read server_list.[name = srv_name].chat */
+        chat = config_setting_lookup(server, "chat");
+        if (chat){
+            DBG_FR("Read server-list.[name = %s].chat, chat_name: %s",
+                    srv_name, chat_name);
+            ret = read_chat_config_from_chat(chat, chat_cfg);
+            if (!RET_IS_OK(ret)) return ret;
+        }
 
-                server = config_setting_get_elem(server_list, i);
-                if (!server) break;
+        /* Read server_list.[name = srv_name].chat_list[name = chat_name] */
+        ret = read_chat_config_from_chats(
+                srn_config_index_lookup_chat(index, server, chat_name), chat_cfg);
+        if (!RET_IS_OK(ret)) return ret;
+    }
 
-                config_setting_lookup_string(server, "name", &name);
-                if (g_strcmp0(srv_name, name) != 0) continue;
+    return SRN_OK;
+}
 
-                /* Read server_list.[name = srv_name].chat */
-                chat = config_setting_lookup(server, "chat");
-                if (chat){
-                    DBG_FR("Read server-list.[name = %s].chat, srv_name: %s, chat_name: %s",
-                            name, srv_name, chat_name);
-                    ret = read_chat_config_from_chat(chat, chat_cfg);
-                    if (!RET_IS_OK(ret)) return ret;
-                }
+/**
+ * @brief on_channel_password_lookup fills in the password of chat once the
+ * asynchronous lookup finishes.
+ */
+static void on_channel_password_lookup(SrnConfigManager *mgr,
+        const char *passwd, gpointer user_data){
+    char **names;
+    SrnServer *srv;
+    SrnChat *chat;
 
-                /* Read server_list.[name = srv_name].chat_list[name = chat_name] */
-                if (chat_name){
-                    config_setting_t *chat_list;
+    if (!passwd){
+        return;
+    }
 
-                    chat_list = config_setting_lookup(server, "server.chat-list");
-                    if (chat_list){
-                        ret = read_chat_config_from_chat_list(chat_list, chat_cfg, chat_name);
-                        if (!RET_IS_OK(ret)) return ret;
-                    }
-                }
-            }
-        }
+    names = user_data;
+    srv = srn_application_get_server(srn_application_get_default(), names[0]);
+    if (!srv){
+        return;
+    }
+    chat = srn_server_get_chat(srv, names[1]);
+    if (!chat || chat->cfg->password){
+        // Chat is gone, or password is specified by user
+        return;
     }
 
-    return SRN_OK;
+    DBG_FR("Channel password of %s/%s is filled in", names[0], names[1]);
+    str_assign(&chat->cfg->password, passwd);
 }
 
 static SrnRet read_user_config_from_user(config_setting_t *user, SrnUserConfig *cfg){
@@ -683,6 +676,35 @@ static char* config_setting_get_string_elem_ex(const config_setting_t *setting,
     return g_strdup(config_setting_get_string_elem(setting, index));
 }
 
+/**
+ * @brief config_setting_lookup_string_list_ex appends all strings of a
+ * string array to list.
+ *
+ * @param config
+ * @param name
+ * @param lst
+ *
+ * @return CONFIG_TRUE if the string array is found.
+ */
+static int config_setting_lookup_string_list_ex(config_setting_t *config,
+        const char *name, GList **lst){
+    config_setting_t *setting;
+
+    setting = config_setting_lookup(config, name);
+    if (!setting) return CONFIG_FALSE;
+
+    for (int i = 0; i < config_setting_length(setting); i++){
+        const char *val;
+
+        val = config_setting_get_string_elem(setting, i);
+        if (!val) continue;
+
+        *lst = g_list_append(*lst, g_strdup(val));
+    }
+
+    return CONFIG_TRUE;
+}
+
 static int config_lookup_bool_ex(const config_t *config, const char *name,
         bool *value){
     int intval;
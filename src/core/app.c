@@ -42,6 +42,7 @@ static SrnApplication *app_instance = NULL;
 
 static void init_logger(SrnApplication *app);
 static void finalize_logger(SrnApplication *app);
+static gboolean auto_connect_server_idle(gpointer user_data);
 
 /*****************************************************************************
  * Exported functions
@@ -49,6 +50,7 @@ static void finalize_logger(SrnApplication *app);
 
 SrnApplication* srn_application_new(void){
     char *path;
+    gint64 startup_time;
     SrnRet ret;
     SrnVersion *ver;
     SrnConfigManager *cfg_mgr;
@@ -58,6 +60,8 @@ SrnApplication* srn_application_new(void){
     // Keep only one instance
     g_return_val_if_fail(!app_instance, NULL);
 
+    startup_time = g_get_monotonic_time();
+
     ver = srn_version_new(PACKAGE_VERSION "-" PACKAGE_BUILD);
     ret = srn_version_parse(ver);
     if (!RET_IS_OK(ret)){
@@ -90,8 +94,10 @@ SrnApplication* srn_application_new(void){
     app->ver = ver;
     app->cfg = cfg;
     app->cfg_mgr = cfg_mgr;
+    app->startup_time = startup_time;
 
     init_logger(app);
+    srn_application_log_startup_phase(app, "config loaded");
     srn_application_init_ui_event(app);
     srn_application_init_irc_event(app);
 
@@ -99,11 +105,13 @@ SrnApplication* srn_application_new(void){
             app, &app->ui_app_events, cfg->ui);
 
     app->pattern_set = srn_pattern_set_new();
+    app->timer_wheel = srn_timer_wheel_new();
 
     app->cmd_ctx = srn_command_context_new();
     srn_command_context_bind(app->cmd_ctx, cmd_bindings);
 
     app_instance = app;
+    srn_application_log_startup_phase(app, "application created");
 
     return app;
 }
@@ -115,6 +123,12 @@ SrnApplication* srn_application_get_default(void){
 
 void srn_application_quit(SrnApplication *app){
     // TODO: cleanup
+    if (app->auto_connect_idle){
+        g_source_remove(app->auto_connect_idle);
+        app->auto_connect_idle = 0;
+    }
+    g_list_free_full(app->auto_connect_list, g_free);
+    app->auto_connect_list = NULL;
     finalize_logger(app);
 }
 
@@ -282,22 +296,8 @@ SrnRet srn_application_add_server_with_config(SrnApplication *app,
         return ret;
     }
 
-    /* Auto join chat */
-    // FIXME: This should be done in server.c?
-    for (GList *lst = srv->cfg->auto_join_chat_list;
-            lst;
-            lst = g_list_next(lst)){
-        const char *name;
-
-        name = lst->data;
-        ret = srn_server_add_chat(srv, name);
-        if (!RET_IS_OK(ret)){
-            ret = RET_ERR(_("Failed to add chat \"%1$s\": %2$s"),
-                    name, RET_MSG(ret));
-            sui_message_box(_("Error"), RET_MSG(ret));
-            continue;
-        }
-    }
+    // Auto join chats are created when server registered,
+    // see srn_server_add_auto_join_chats()
 
     /* Run server autorun commands */
     for (GList *lst = srv->cfg->auto_run_cmd_list; lst; lst = g_list_next(lst)){
@@ -392,30 +392,64 @@ bool srn_application_is_server_valid(SrnApplication *app, SrnServer *srv) {
     return g_list_find(app->srv_list, srv) != NULL;
 }
 
+/**
+ * @brief srn_application_auto_connect_server adds and connects servers in
+ * the auto connect list. Servers are added one per main loop iteration so the
+ * window is drawn first and stays responsive, connections are established
+ * asynchronously and in parallel.
+ *
+ * @param app
+ */
 void srn_application_auto_connect_server(SrnApplication *app) {
-    SrnRet ret;
-
-    for (GList *lst = app->cfg->auto_connect_srv_list;
-            lst;
-            lst = g_list_next(lst)){
-        const char *name;
+    g_return_if_fail(!app->auto_connect_idle);
 
-        name = lst->data;
-        ret = srn_application_add_server(app, name);
-        if (!RET_IS_OK(ret)){
-            ret = RET_ERR(_("Failed to add server \"%1$s\": %2$s"),
-                    name, RET_MSG(ret));
-            sui_message_box(_("Error"), RET_MSG(ret));
-            continue;
-        }
-        srn_server_connect(srn_application_get_server(app, name));
+    app->auto_connect_list = g_list_copy_deep(app->cfg->auto_connect_srv_list,
+            (GCopyFunc)g_strdup, NULL);
+    if (!app->auto_connect_list){
+        return;
     }
+    app->auto_connect_idle = g_idle_add_full(G_PRIORITY_LOW,
+            auto_connect_server_idle, app, NULL);
+}
+
+void srn_application_log_startup_phase(SrnApplication *app, const char *phase){
+    LOG_FR("Startup phase \"%s\" reached at %.3lfms", phase,
+            (g_get_monotonic_time() - app->startup_time) / 1000.0);
 }
 
 /*****************************************************************************
  * Static functions
  *****************************************************************************/
 
+static gboolean auto_connect_server_idle(gpointer user_data){
+    char *name;
+    SrnRet ret;
+    SrnApplication *app;
+
+    app = user_data;
+    name = app->auto_connect_list->data;
+    app->auto_connect_list = g_list_delete_link(app->auto_connect_list,
+            app->auto_connect_list);
+
+    ret = srn_application_add_server(app, name);
+    if (RET_IS_OK(ret)){
+        srn_server_connect(srn_application_get_server(app, name));
+    } else {
+        ret = RET_ERR(_("Failed to add server \"%1$s\": %2$s"),
+                name, RET_MSG(ret));
+        sui_message_box(_("Error"), RET_MSG(ret));
+    }
+    g_free(name);
+
+    if (app->auto_connect_list){
+        return G_SOURCE_CONTINUE;
+    }
+
+    srn_application_log_startup_phase(app, "all auto-connect servers connecting");
+    app->auto_connect_idle = 0;
+    return G_SOURCE_REMOVE;
+}
+
 static void init_logger(SrnApplication *app) {
     SrnRet ret;
 
@@ -31,6 +31,7 @@
 #include <glib.h>
 
 #include "core/core.h"
+#include "config/password.h"
 #include "sui/sui.h"
 #include "libecdsaauth/op.h"
 #include "libecdsaauth/keypair.h"
@@ -44,6 +45,9 @@
 static gboolean do_period_ping(gpointer user_data);
 static void add_numeric_error_message(SrnChat *chat, int event, const char
         *origin, const char **params, int count);
+static void join_channel(SrnServer *srv, SrnChat *chat);
+static void on_join_password_lookup(SrnConfigManager *mgr, const char *passwd,
+        gpointer user_data);
 
 static void irc_event_connect(SircSession *sirc, const char *event);
 static void irc_event_connect_fail(SircSession *sirc, const char *event,
@@ -251,10 +255,14 @@ static void irc_event_disconnect(SircSession *sirc, const char *event,
     /* Stop period ping */
     if (srv->ping_timer){
         DBG_FR("Ping timer %d removed", srv->ping_timer);
-        g_source_remove(srv->ping_timer);
+        srn_timer_wheel_remove(srn_application_get_default()->timer_wheel,
+                srv->ping_timer);
         srv->ping_timer = 0;
     }
 
+    srn_server_clear_netsplit(srv);
+    srn_server_clear_requested_chats(srv);
+
     ret = srn_server_state_transfrom(srv, SRN_SERVER_ACTION_DISCONNECT_FINISH);
     g_return_if_fail(RET_IS_OK(ret));
     if (!srn_server_is_valid(srv)) {
@@ -326,7 +334,9 @@ static void irc_event_welcome(SircSession *sirc, int event,
 
     /* Start peroid ping */
     srv->last_pong = get_time_since_first_call_ms();
-    srv->ping_timer = g_timeout_add(SRN_SERVER_PING_INTERVAL, do_period_ping, srv);
+    srv->ping_timer = srn_timer_wheel_add(
+            srn_application_get_default()->timer_wheel, "ping",
+            SRN_SERVER_PING_INTERVAL, do_period_ping, srv);
     DBG_FR("Ping timer %d created", srv->ping_timer);
 
     // Set your actually nick
@@ -382,15 +392,30 @@ static void irc_event_welcome(SircSession *sirc, int event,
         }
     }
 
+    /* Create auto join chats when first registered */
+    if (!srv->auto_joined){
+        char *phase;
+
+        phase = g_strdup_printf("server %s registered", srv->name);
+        srn_application_log_startup_phase(srn_application_get_default(), phase);
+        g_free(phase);
+
+        srn_server_add_auto_join_chats(srv);
+        g_return_if_fail(srn_server_is_valid(srv));
+    }
+
     /* Join all channels already exists */
     list = srv->chat_list;
     while (list){
         SrnChat *chat = list->data;
         if (sirc_target_is_channel(srv->irc, chat->name)){
-            sirc_cmd_join(srv->irc, chat->name, chat->cfg->password);
+            join_channel(srv, chat);
         }
         list = g_list_next(list);
     }
+
+    /* Run actions which are waiting for registration */
+    srn_server_finish_deferred_actions(srv);
 }
 
 static void irc_event_nick(SircSession *sirc, const char *event,
@@ -416,10 +441,14 @@ static void irc_event_nick(SircSession *sirc, const char *event,
         SrnChatUser *chat_user;
 
         chat_user = lst->data;
+        lst = g_list_next(lst);
+        if (srn_chat_hide_presence(chat_user->chat, chat_user,
+                    SRN_CHAT_PRESENCE_NICK)){
+            continue;
+        }
         // TODO: dialog nick track support
         srn_chat_add_misc_message_with_user_fmt(chat_user->chat, chat_user,
                 _("%1$s is now known as %2$s"), old_nick, new_nick);
-        lst = g_list_next(lst);
     }
     if (srv_user->is_me){
         srn_chat_add_misc_message_with_user_fmt(srv->chat, srv->chat->user,
@@ -446,23 +475,30 @@ static void irc_event_quit(SircSession *sirc, const char *event,
     srv_user = srn_server_get_user(srv, origin);
     g_return_if_fail(srv_user);
 
-    if (reason) {
-        snprintf(buf, sizeof(buf), _("%1$s has quit: %2$s"), origin, reason);
-    } else {
-        snprintf(buf, sizeof(buf), _("%1$s has quit"), origin);
-    }
+    // QUIT messages of a netsplit are coalesced into a summary
+    if (!srn_server_netsplit_quit(srv, srv_user, reason)) {
+        if (reason) {
+            snprintf(buf, sizeof(buf), _("%1$s has quit: %2$s"), origin, reason);
+        } else {
+            snprintf(buf, sizeof(buf), _("%1$s has quit"), origin);
+        }
 
-    lst = srv_user->chat_user_list;
-    while (lst){
-        SrnChatUser *chat_user;
+        lst = srv_user->chat_user_list;
+        while (lst){
+            SrnChatUser *chat_user;
 
-        // TODO: dialog support
-        chat_user = lst->data;
-        srn_chat_add_misc_message_with_user(chat_user->chat, chat_user, buf);
-        lst = g_list_next(lst);
-    }
+            // TODO: dialog support
+            chat_user = lst->data;
+            lst = g_list_next(lst);
+            if (srn_chat_hide_presence(chat_user->chat, chat_user,
+                        SRN_CHAT_PRESENCE_QUIT)){
+                continue;
+            }
+            srn_chat_add_misc_message_with_user(chat_user->chat, chat_user, buf);
+        }
 
-    srn_server_user_set_is_online(srv_user, FALSE);
+        srn_server_user_set_is_online(srv_user, FALSE);
+    }
 
     // If the quit user is your ghost (own your exact original nick)
     // and your are using alternate nick (bacause of original nick is in use),
@@ -498,10 +534,17 @@ static void irc_event_join(SircSession *sirc, const char *event,
     chat = srn_server_get_chat(srv, chan);
     g_return_if_fail(chat);
 
+    if (!srv_user->is_me && srn_server_netsplit_join(srv, srv_user, chat)) {
+        return;
+    }
+
     if (srv_user->is_me) {
         snprintf(buf, sizeof(buf), _("You have joined the channel"));
         srn_chat_set_is_joined(chat, TRUE);
         chat_user = chat->user;
+        if (srn_server_pop_requested_chat(srv, chan)){
+            sui_activate_buffer(chat->ui);
+        }
     } else {
         snprintf(buf, sizeof(buf), _("%1$s has joined"), origin);
         chat_user = srn_chat_add_and_get_user(chat, srv_user);
@@ -510,6 +553,9 @@ static void irc_event_join(SircSession *sirc, const char *event,
     g_return_if_fail(!chat_user->is_joined);
     srn_chat_user_set_is_joined(chat_user, TRUE);
 
+    if (srn_chat_hide_presence(chat, chat_user, SRN_CHAT_PRESENCE_JOIN)){
+        return;
+    }
     srn_chat_add_misc_message_with_user(chat, chat_user, buf);
 }
 
@@ -540,7 +586,9 @@ static void irc_event_part(SircSession *sirc, const char *event,
         snprintf(buf, sizeof(buf), _("%1$s has left"), origin);
     }
 
-    srn_chat_add_misc_message_with_user(chat, chat_user, buf);
+    if (!srn_chat_hide_presence(chat, chat_user, SRN_CHAT_PRESENCE_PART)){
+        srn_chat_add_misc_message_with_user(chat, chat_user, buf);
+    }
     srn_chat_user_set_is_joined(chat_user, FALSE);
 
     /* You has left a channel */
@@ -1858,6 +1906,21 @@ static void irc_event_numeric(SircSession *sirc, int event,
                 chan = params[1];
                 msg = params[2];
 
+                switch (event) {
+                    case SIRC_RFC_ERR_NOSUCHCHANNEL:
+                    case SIRC_RFC_ERR_TOOMANYCHANNELS:
+                    case SIRC_RFC_ERR_CHANNELISFULL:
+                    case SIRC_RFC_ERR_INVITEONLYCHAN:
+                    case SIRC_RFC_ERR_BANNEDFROMCHAN:
+                    case SIRC_RFC_ERR_BADCHANNELKEY:
+                    case SIRC_RFC_ERR_BADCHANMASK:
+                        // Failed to join, do not activate it when joined later
+                        srn_server_pop_requested_chat(srv, chan);
+                        break;
+                    default:
+                        break;
+                }
+
                 chat = srn_server_get_chat(srv, chan);
                 if (!chat) {
                     // Fallback to general numeric error if no such channel
@@ -1966,3 +2029,58 @@ static void add_numeric_error_message(SrnChat *chat, int event, const char
 
     g_string_free(buf, TRUE);
 }
+
+/**
+ * @brief Join a channel with its key.
+ *
+ * If the key of channel is still being looked up from keyring, the JOIN
+ * command is sent when the lookup finishes, otherwise a keyed channel will
+ * be joined without key.
+ *
+ * @param srv
+ * @param chat
+ */
+static void join_channel(SrnServer *srv, SrnChat *chat){
+    char *passwd;
+    char **names;
+
+    if (chat->cfg->password){
+        sirc_cmd_join(srv->irc, chat->name, chat->cfg->password);
+        return;
+    }
+
+    passwd = NULL;
+    names = g_new0(char *, 3);
+    names[0] = g_strdup(srv->name);
+    names[1] = g_strdup(chat->name);
+    if (srn_config_manager_lookup_channel_password_async(
+                srn_application_get_default()->cfg_mgr, &passwd,
+                srv->name, chat->name, on_join_password_lookup, names,
+                (GDestroyNotify)g_strfreev)){
+        // Lookup is already done, no password or the password is cached
+        sirc_cmd_join(srv->irc, chat->name, passwd);
+        g_free(passwd);
+    }
+}
+
+static void on_join_password_lookup(SrnConfigManager *mgr, const char *passwd,
+        gpointer user_data){
+    char **names;
+    SrnServer *srv;
+    SrnChat *chat;
+
+    names = user_data;
+    srv = srn_application_get_server(srn_application_get_default(), names[0]);
+    // Channels will be joined again when the server is registered
+    if (!srv || !srn_server_is_registered(srv)){
+        return;
+    }
+    chat = srn_server_get_chat(srv, names[1]);
+    if (!chat || chat->is_joined){
+        return;
+    }
+
+    // Password may be filled by config reader or user during the lookup
+    sirc_cmd_join(srv->irc, chat->name,
+            chat->cfg->password ? chat->cfg->password : passwd);
+}
@@ -118,6 +118,7 @@ static SrnRet ui_event_activate(SuiApplication *app, SuiEvent event, GVariantDic
     srn_app = sui_application_get_ctx(app);
     opts = sui_application_get_options(app);
     sui_new_window(app, &srn_app->ui_win_events);
+    srn_application_log_startup_phase(srn_app, "window created");
 
     if (!opts->no_auto_connect) {
         srn_application_auto_connect_server(srn_app);
@@ -127,6 +128,21 @@ static SrnRet ui_event_activate(SuiApplication *app, SuiEvent event, GVariantDic
 }
 
 static SrnRet ui_event_shutdown(SuiApplication *app, SuiEvent event, GVariantDict *params){
+    GList *srv_lst;
+
+    /* Buffered snapshot messages are written before exiting */
+    srv_lst = srn_application_get_default()->srv_list;
+    for (; srv_lst; srv_lst = g_list_next(srv_lst)){
+        GList *chat_lst;
+        SrnServer *srv;
+
+        srv = srv_lst->data;
+        chat_lst = srv->chat_list;
+        for (; chat_lst; chat_lst = g_list_next(chat_lst)){
+            srn_chat_flush_snapshot(chat_lst->data);
+        }
+    }
+
     return SRN_OK;
 }
 
@@ -276,7 +292,7 @@ static SrnRet ui_event_join(SuiBuffer *sui, SuiEvent event, GVariantDict *params
     g_variant_dict_lookup(params, "channel", SUI_EVENT_PARAM_STRING, &chan);
     g_variant_dict_lookup(params, "password", SUI_EVENT_PARAM_STRING, &passwd);
 
-    return sirc_cmd_join(srv->irc, chan, passwd);
+    return srn_server_join_chat(srv, chan, passwd);
 }
 
 static SrnRet ui_event_part(SuiBuffer *sui, SuiEvent event, GVariantDict *params){
@@ -297,14 +313,24 @@ static SrnRet ui_event_part(SuiBuffer *sui, SuiEvent event, GVariantDict *params
 
 static SrnRet ui_event_query(SuiBuffer *sui, SuiEvent event, GVariantDict *params){
     const char *nick = NULL;
+    SrnRet ret;
     SrnServer *srv;
+    SrnChat *chat;
 
     srv = ctx_get_server(sui);
     g_return_val_if_fail(srn_server_is_valid(srv), SRN_ERR);
 
     g_variant_dict_lookup(params, "nick", SUI_EVENT_PARAM_STRING, &nick);
 
-    return srn_server_add_chat(srv, nick);
+    ret = srn_server_add_chat(srv, nick);
+    if (!RET_IS_OK(ret)){
+        return ret;
+    }
+    chat = srn_server_get_chat(srv, nick);
+    g_return_val_if_fail(chat, SRN_ERR);
+    sui_activate_buffer(chat->ui);
+
+    return ret;
 }
 
 static SrnRet ui_event_unquery(SuiBuffer *sui, SuiEvent event, GVariantDict *params){
@@ -399,6 +425,10 @@ static SrnRet ui_event_cutover(SuiBuffer *sui, SuiEvent event, GVariantDict *par
 
     app->cur_srv = srv;
     srv->cur_chat = chat;
+    // Chat opened by user is no longer a low priority one
+    srn_chat_set_priority(chat, SRN_CHAT_PRIORITY_NORMAL);
+    srn_chat_rehydrate_snapshot(chat);
+    srn_chat_flush_deferred_messages(chat);
 
     return SRN_OK;
 }
@@ -34,7 +34,18 @@
 #include "log.h"
 #include "utils.h"
 
+typedef struct _SrnUrlJoin SrnUrlJoin;
+
+/* Channels in URL, joined after server registered */
+struct _SrnUrlJoin {
+    char *path;
+    char *fragment;
+};
+
 static SrnRet join_comma_separated_chans(SrnServer *srv, const char *comma_chans);
+static void on_server_registered(SrnServer *srv, bool registered,
+        gpointer user_data);
+static void srn_url_join_free(SrnUrlJoin *join);
 
 SrnRet srn_application_open_url(SrnApplication *app, const char *url){
     const char *scheme;
@@ -127,34 +138,30 @@ SrnRet srn_application_open_url(SrnApplication *app, const char *url){
         if (!RET_IS_OK(ret)){
             goto FIN;
         }
-
-        srn_server_wait_until_registered(srv);
     }
 
-    if (!srn_server_is_registered(srv)){
+    // Server is neither registered nor going to be registered
+    if (!srn_server_is_registered(srv)
+            && srv->state != SRN_SERVER_STATE_CONNECTING
+            && srv->state != SRN_SERVER_STATE_CONNECTED){
         ret =  RET_ERR(_("Failed to register on server \"%1$s\""), srv->name);
         goto FIN;
     }
 
-    /*  Join channels in URL */
-    if (!str_is_empty(path)){
-        if (path[0] == '/') {
-            path++;    // Skip root of URL path
-        }
-        ret = join_comma_separated_chans(srv, path);
-        if (!RET_IS_OK(ret)) {
-            ret = RET_ERR(_("Failed to join channel on server \"%1$s\": %2$s"),
-                    srv->name, RET_MSG(ret));
-            goto FIN;
-        }
-    }
-    if (!str_is_empty(fragment)){
-        ret = join_comma_separated_chans(srv, fragment);
-        if (!RET_IS_OK(ret)) {
-            ret = RET_ERR(_("Failed to join channel on server \"%1$s\": %2$s"),
-                    srv->name, RET_MSG(ret));
-            goto FIN;
+    /*  Join channels in URL once registered */
+    if (!str_is_empty(path) || !str_is_empty(fragment)){
+        SrnUrlJoin *join;
+
+        join = g_malloc0(sizeof(SrnUrlJoin));
+        if (!str_is_empty(path)){
+            if (path[0] == '/') {
+                path++;    // Skip root of URL path
+            }
+            str_assign(&join->path, path);
         }
+        str_assign(&join->fragment, fragment);
+        srn_server_run_when_registered(srv, on_server_registered, join,
+                (GDestroyNotify)srn_url_join_free);
     }
 
     ret = SRN_OK;
@@ -224,3 +231,41 @@ static SrnRet join_comma_separated_chans(SrnServer *srv, const char *comma_chans
 
     return ret;
 }
+
+static void on_server_registered(SrnServer *srv, bool registered,
+        gpointer user_data){
+    SrnRet ret;
+    SrnUrlJoin *join;
+
+    join = user_data;
+    if (!registered){
+        srn_chat_add_error_message_fmt(srv->chat,
+                _("Failed to register on server \"%1$s\""), srv->name);
+        return;
+    }
+
+    if (!str_is_empty(join->path)){
+        ret = join_comma_separated_chans(srv, join->path);
+        if (!RET_IS_OK(ret)) {
+            goto ERR;
+        }
+    }
+    if (!str_is_empty(join->fragment)){
+        ret = join_comma_separated_chans(srv, join->fragment);
+        if (!RET_IS_OK(ret)) {
+            goto ERR;
+        }
+    }
+    return;
+
+ERR:
+    srn_chat_add_error_message_fmt(srv->chat,
+            _("Failed to join channel on server \"%1$s\": %2$s"),
+            srv->name, RET_MSG(ret));
+}
+
+static void srn_url_join_free(SrnUrlJoin *join){
+    str_assign(&join->path, NULL);
+    str_assign(&join->fragment, NULL);
+    g_free(join);
+}
@@ -29,10 +29,24 @@
 #include "utils.h"
 #include "config/config.h"
 #include "extra_data.h"
+#include "intern.h"
 
 #include "sirc/sirc.h"
 
-static void add_message(SrnChat *self, SrnMessage *msg);
+static void add_message(SrnChat *self, SrnMessage *msg,
+        SrnRenderFlags rflags, SrnFilterFlags fflags);
+static bool add_rendered_message(SrnChat *self, SrnMessage *msg);
+static bool render_remaining(SrnMessage *msg, SrnRenderFlags flags);
+static void on_message_rendered(SrnMessage *msg, SrnRet ret,
+        void *user_data);
+static void on_deferred_message_rendered(SrnMessage *msg, SrnRet ret,
+        void *user_data);
+static void on_mentioned_message_rendered(SrnMessage *msg, SrnRet ret,
+        void *user_data);
+static bool is_deferrable(SrnChat *self, SrnMessage *msg);
+static bool collapse_message(SrnChat *self, SrnMessage *msg,
+        SrnFilterFlags fflags);
+static void append_message(SrnChat *self, SrnMessage *msg);
 
 SrnChat* srn_chat_new(SrnServer *srv, const char *name, SrnChatType type,
         SrnChatConfig *cfg){
@@ -41,14 +55,16 @@ SrnChat* srn_chat_new(SrnServer *srv, const char *name, SrnChatType type,
 
     self = g_malloc0(sizeof(SrnChat));
 
-    str_assign(&self->name, name);
+    srn_intern_assign(&self->name, name);
     self->type = type;
     self->cfg = cfg;
+    self->priority = cfg->priority;
     self->is_joined = FALSE;
     self->srv = srv;
     self->user = srn_chat_add_and_get_user(self, srv->user);
     self->_user = srn_chat_add_and_get_user(self, srv->_user);
     self->extra_data = srn_extra_data_new();
+    self->render_queue = srn_render_queue_new();
 
     // Init self->ui
     events = &srn_application_get_default()->ui_events;
@@ -67,13 +83,24 @@ SrnChat* srn_chat_new(SrnServer *srv, const char *name, SrnChatType type,
             g_warn_if_reached();
     }
 
+    if (self->type != SRN_CHAT_TYPE_SERVER){
+        srn_chat_open_snapshot(self);
+    }
+
     return self;
 }
 
 void srn_chat_free(SrnChat *self){
-    str_assign(&self->name, NULL);
+    // Messages being rendered are dropped
+    srn_render_queue_free(self->render_queue);
+
+    srn_intern_assign(&self->name, NULL);
 
     srn_extra_data_free(self->extra_data);
+    srn_chat_close_snapshot(self);
+    srn_chat_clear_hidden_presence(self);
+
+    g_list_free(self->deferred_msg_list);
 
     // Free user list, self->user and self->_user also in this list
     g_list_free_full(self->user_list, (GDestroyNotify)srn_chat_user_free);
@@ -86,6 +113,10 @@ void srn_chat_free(SrnChat *self){
 void srn_chat_set_config(SrnChat *self, SrnChatConfig *cfg){
     sui_buffer_set_config(self->ui, cfg->ui);
     self->cfg = cfg;
+    srn_render_invalidate(self->extra_data);
+    if (!srn_chat_is_visible(self)){
+        self->priority = cfg->priority;
+    }
 }
 
 void srn_chat_set_is_joined(SrnChat *self, bool joined){
@@ -141,18 +172,32 @@ SrnRet srn_chat_rm_user(SrnChat *self, SrnChatUser *user){
     }
     self->user_list = g_list_delete_link(self->user_list, lst);
 
+    // User is going to be freed, the latest message can not be compared with
+    // new messages anymore, see collapse_message()
+    if (self->last_msg && self->last_msg->sender == user){
+        self->last_msg = NULL;
+    }
+
     return SRN_OK;
 }
 
 
 SrnChatUser* srn_chat_get_user(SrnChat *self, const char *nick){
+    const char *fold;
     GList *lst;
     SrnChatUser *user;
 
+    /* Nickname of SrnServerUser is interned, compare their folds instead of
+     * strings */
+    fold = srn_intern_lookup_fold(nick);
+    if (!fold){
+        return NULL;
+    }
+
     lst = self->user_list;
     while (lst){
         user = lst->data;
-        if (sirc_target_equal(user->srv_user->nick, nick)){
+        if (srn_intern_get_fold(user->srv_user->nick) == fold){
             return user;
         }
         lst = g_list_next(lst);
@@ -172,20 +217,7 @@ void srn_chat_add_sent_message(SrnChat *self, const char *content){
     fflags = SRN_FILTER_FLAG_LOG;
     msg = srn_message_new(self, user, content, SRN_MESSAGE_TYPE_SENT);
 
-    if (srn_render_message(msg, rflags) != SRN_OK){
-        goto cleanup;
-    }
-    if (!srn_filter_message(msg, fflags)){
-        /* Ignore this message */
-        goto cleanup;
-    }
-
-    add_message(self, msg);
-
-    return;
-
-cleanup:
-    srn_message_free(msg);
+    add_message(self, msg, rflags, fflags);
 }
 
 void srn_chat_add_recv_message(SrnChat *self, SrnChatUser *user, const char *content){
@@ -202,19 +234,7 @@ void srn_chat_add_recv_message(SrnChat *self, SrnChatUser *user, const char *con
     fflags = SRN_FILTER_FLAG_USER | SRN_FILTER_FLAG_PATTERN | SRN_FILTER_FLAG_LOG;
 
     msg = srn_message_new(self, user, content, SRN_MESSAGE_TYPE_RECV);
-    if (srn_render_message(msg, rflags) != SRN_OK){
-        goto cleanup;
-    }
-    if (!srn_filter_message(msg, fflags)){
-        goto cleanup;
-    }
-
-    add_message(self, msg);
-
-    return;
-
-cleanup:
-    srn_message_free(msg);
+    add_message(self, msg, rflags, fflags);
 }
 
 void srn_chat_add_notice_message(SrnChat *self, SrnChatUser *user, const char *content){
@@ -231,19 +251,7 @@ void srn_chat_add_notice_message(SrnChat *self, SrnChatUser *user, const char *c
     fflags = SRN_FILTER_FLAG_USER | SRN_FILTER_FLAG_PATTERN | SRN_FILTER_FLAG_LOG;
 
     msg = srn_message_new(self, user, content, SRN_MESSAGE_TYPE_NOTICE);
-    if (srn_render_message(msg, rflags) != SRN_OK){
-        goto cleanup;
-    }
-    if (!srn_filter_message(msg, fflags)){
-        goto cleanup;
-    }
-
-    add_message(self, msg);
-
-    return;
-
-cleanup:
-    srn_message_free(msg);
+    add_message(self, msg, rflags, fflags);
 }
 
 void srn_chat_add_action_message(SrnChat *self, SrnChatUser *user, const char *content){
@@ -264,23 +272,7 @@ void srn_chat_add_action_message(SrnChat *self, SrnChatUser *user, const char *c
         fflags |= SRN_FILTER_FLAG_USER | SRN_FILTER_FLAG_PATTERN;
         rflags |= SRN_RENDER_FLAG_PATTERN | SRN_RENDER_FLAG_MENTION;
     }
-    if (srn_render_message(msg, rflags) != SRN_OK){
-        goto cleanup;
-    }
-    if (!srn_filter_message(msg, fflags)){
-        goto cleanup;
-    }
-
-    if (!msg->ui){
-        goto cleanup;
-    }
-
-    add_message(self, msg);
-
-    return;
-
-cleanup:
-    srn_message_free(msg);
+    add_message(self, msg, rflags, fflags);
 }
 
 /**
@@ -302,15 +294,7 @@ void srn_chat_add_misc_message(SrnChat *self, const char *content){
 
     rflags = SRN_RENDER_FLAG_URL;
     msg = srn_message_new(self, self->_user, content, SRN_MESSAGE_TYPE_MISC);
-    if (srn_render_message(msg, rflags) != SRN_OK){
-        goto cleanup;
-    }
-
-    add_message(self, msg);
-    return;
-
-cleanup:
-    srn_message_free(msg);
+    add_message(self, msg, rflags, 0);
 }
 
 /**
@@ -340,18 +324,7 @@ void srn_chat_add_misc_message_with_user(SrnChat *self, SrnChatUser *user,
     rflags = SRN_RENDER_FLAG_URL;
     fflags = SRN_FILTER_FLAG_USER | SRN_FILTER_FLAG_PATTERN | SRN_FILTER_FLAG_LOG;
     msg = srn_message_new(self, user, content, SRN_MESSAGE_TYPE_MISC);
-    if (srn_render_message(msg, rflags) != SRN_OK){
-        goto cleanup;
-    }
-    if (!srn_filter_message(msg, fflags)){
-        goto cleanup;
-    }
-
-    add_message(self, msg);
-    return;
-
-cleanup:
-    srn_message_free(msg);
+    add_message(self, msg, rflags, fflags);
 }
 
 void srn_chat_add_misc_message_with_user_fmt(SrnChat *self, SrnChatUser *user,
@@ -378,15 +351,7 @@ void srn_chat_add_error_message(SrnChat *self, const char *content){
 
     rflags = SRN_RENDER_FLAG_URL;
     msg = srn_message_new(self, self->_user, content, SRN_MESSAGE_TYPE_ERROR);
-    if (srn_render_message(msg, rflags) != SRN_OK){
-        goto cleanup;
-    }
-
-    add_message(self, msg);
-    return;
-
-cleanup:
-    srn_message_free(msg);
+    add_message(self, msg, rflags, 0);
 }
 
 /**
@@ -416,19 +381,7 @@ void srn_chat_add_error_message_with_user(SrnChat *self, SrnChatUser *user,
     rflags = SRN_RENDER_FLAG_URL;
     fflags = SRN_FILTER_FLAG_USER | SRN_FILTER_FLAG_PATTERN | SRN_FILTER_FLAG_LOG;
     msg = srn_message_new(self, user, content, SRN_MESSAGE_TYPE_ERROR);
-    if (srn_render_message(msg, rflags) != SRN_OK){
-        goto cleanup;
-    }
-    if (!srn_filter_message(msg, fflags)){
-        goto cleanup;
-    }
-
-    add_message(self, msg);
-
-    return;
-
-cleanup:
-    srn_message_free(msg);
+    add_message(self, msg, rflags, fflags);
 }
 
 void srn_chat_add_error_message_with_user_fmt(SrnChat *self, SrnChatUser *user,
@@ -465,8 +418,363 @@ void srn_chat_set_topic_setter(SrnChat *self, const char *setter){
     sui_set_topic_setter(self->ui, setter);
 }
 
-static void add_message(SrnChat *self, SrnMessage *msg){
-    self->msg_list = g_list_append(self->msg_list, msg);
+/**
+ * @brief srn_chat_is_visible returns whether the buffer of given chat is
+ * being shown to user.
+ *
+ * @param self
+ *
+ * @return
+ */
+bool srn_chat_is_visible(SrnChat *self){
+    SrnApplication *app;
+
+    app = srn_application_get_default();
+
+    return app->cur_srv == self->srv && self->srv->cur_chat == self;
+}
+
+/**
+ * @brief srn_chat_set_priority changes the priority of chat, it is usually
+ * used for promoting a low priority chat when it is opened by user.
+ *
+ * @param self
+ * @param priority
+ */
+void srn_chat_set_priority(SrnChat *self, SrnChatPriority priority){
+    SrnChatPriority prev;
+
+    g_return_if_fail(priority != SRN_CHAT_PRIORITY_UNKNOWN);
+
+    if (self->priority == priority){
+        return;
+    }
+    prev = self->priority;
+    self->priority = priority;
+
+    DBG_FR("Priority of chat %s is changed from %s to %s", self->name,
+            srn_chat_priority_to_string(prev),
+            srn_chat_priority_to_string(priority));
+
+    if (prev == SRN_CHAT_PRIORITY_LOG_ONLY){
+        SrnMessage *msg;
+
+        /* The marker is not queued but added immediately, so that it is
+         * ahead of the messages being rendered, which are shown since now,
+         * including the mentioned message causing the promotion. If the
+         * chat is still invisible, it is deferred and flushed before the
+         * mentioned message, see add_rendered_message() */
+        msg = srn_message_new(self, self->_user,
+                _("Messages before this point were only written to log"),
+                SRN_MESSAGE_TYPE_MISC);
+        msg->render_flags = SRN_RENDER_FLAG_URL;
+        if (!add_rendered_message(self, msg)){
+            srn_message_free(msg);
+        }
+    }
+}
+
+/**
+ * @brief srn_chat_flush_deferred_messages renders the messages which are
+ * deferred when chat is invisible, and adds them to UI once they are
+ * rendered, before the messages which are still being rendered.
+ *
+ * @param self
+ */
+void srn_chat_flush_deferred_messages(SrnChat *self){
+    if (!self->deferred_msg_list){
+        return;
+    }
+
+    DBG_FR("Flushing %d deferred messages of chat %s",
+            g_list_length(self->deferred_msg_list), self->name);
+
+    /* The list is in reverse order, pushing them to head from the latest
+     * one keeps their order. Only the remaining renderers are applied */
+    for (GList *lst = self->deferred_msg_list; lst; lst = g_list_next(lst)){
+        SrnMessage *msg;
+
+        msg = lst->data;
+        srn_render_queue_push_head(self->render_queue, msg,
+                msg->render_flags & ~msg->rendered_flags,
+                on_deferred_message_rendered, self);
+    }
+    g_list_free(self->deferred_msg_list);
+    self->deferred_msg_list = NULL;
+}
+
+/**
+ * @brief add_message queues message for rendering, it is filtered and added
+ * to chat once rendered, see add_rendered_message(). Ownership of message is
+ * transferred.
+ *
+ * Renderers applied on worker thread depend on current state of chat:
+ * if the chat is log-only and not visible, only mention renderer is applied;
+ * if the chat is not visible, URL renderer is deferred; otherwise all
+ * renderers are applied.
+ */
+static void add_message(SrnChat *self, SrnMessage *msg,
+        SrnRenderFlags rflags, SrnFilterFlags fflags){
+    SrnRenderFlags first_rflags;
+
+    switch (msg->type) {
+        case SRN_MESSAGE_TYPE_RECV:
+        case SRN_MESSAGE_TYPE_ACTION:
+        case SRN_MESSAGE_TYPE_NOTICE:
+            // Only speaking counts as activity, JOIN/PART/QUIT does not
+            if (msg->sender != self->_user){
+                msg->sender->srv_user->last_active = msg->time;
+                msg->sender->last_active = msg->time;
+            }
+            break;
+        default:
+            break;
+    }
+
+    if (self->priority == SRN_CHAT_PRIORITY_LOG_ONLY
+            && !srn_chat_is_visible(self)){
+        first_rflags = rflags & SRN_RENDER_FLAG_MENTION;
+    } else if (is_deferrable(self, msg)){
+        first_rflags = rflags & ~SRN_RENDER_FLAG_URL;
+    } else {
+        first_rflags = rflags;
+    }
+
+    msg->render_flags = rflags;
+    msg->filter_flags = fflags;
+    srn_render_queue_push(self->render_queue, msg, first_rflags,
+            on_message_rendered, self);
+}
+
+/**
+ * @brief add_rendered_message filters and adds message to chat, messages are
+ * added in the order they are passed to add_message().
+ *
+ * If the chat is not visible, message is rendered by all renderers except
+ * URL renderer (so that mentions are detected and filters see the same
+ * plain text as visible chat) and passed to filters (including logging).
+ * URL rendering and the creation of SuiMessage are deferred until
+ * srn_chat_flush_deferred_messages() is called.
+ *
+ * If the chat is log-only, message is only passed to filters, unless we are
+ * mentioned, then the chat is promoted to normal priority.
+ *
+ * @return FALSE if the message is filtered, collapsed or failed to render,
+ * caller should free it.
+ */
+static bool add_rendered_message(SrnChat *self, SrnMessage *msg){
+    SrnRenderFlags rflags;
+    SrnFilterFlags fflags;
+
+    rflags = msg->render_flags;
+    fflags = msg->filter_flags;
+
+    if (self->priority == SRN_CHAT_PRIORITY_LOG_ONLY
+            && !srn_chat_is_visible(self)){
+        /* Mention is still detected, the chat is promoted when we are
+         * mentioned so that the message is shown and notified */
+        if (rflags & SRN_RENDER_FLAG_MENTION
+                && render_remaining(msg, SRN_RENDER_FLAG_MENTION)
+                && msg->mentioned){
+            srn_message_reset_rendered(msg);
+            srn_chat_set_priority(self, SRN_CHAT_PRIORITY_NORMAL);
+        } else {
+            // Message is only passed to filters (including logging) and is
+            // not kept, caller frees it
+            srn_filter_message(msg, fflags);
+            return FALSE;
+        }
+    }
+
+    if (collapse_message(self, msg, fflags)){
+        return FALSE;
+    }
+
+    if (is_deferrable(self, msg)){
+        if (!render_remaining(msg, rflags & ~SRN_RENDER_FLAG_URL)){
+            return FALSE;
+        }
+        if (!srn_filter_message(msg, fflags)){
+            return FALSE;
+        }
+        srn_chat_save_snapshot_message(self, msg, rflags);
+
+        if (msg->mentioned){
+            /* Mentioned message should be notified, finish rendering it
+             * and the deferred messages before it, they are delivered
+             * before the messages still in queue */
+            srn_render_queue_push_head(self->render_queue, msg,
+                    rflags & ~msg->rendered_flags,
+                    on_mentioned_message_rendered, self);
+            srn_chat_flush_deferred_messages(self);
+            return TRUE;
+        }
+
+        self->deferred_msg_list = g_list_prepend(self->deferred_msg_list, msg);
+        self->msg_list = g_list_prepend(self->msg_list, msg);
+        self->last_msg = msg;
+
+        if (self->priority == SRN_CHAT_PRIORITY_LOW){
+            // No side bar update for low priority chat
+        } else if (msg->type == SRN_MESSAGE_TYPE_ACTION){
+            char *action;
+
+            action = g_strdup_printf("%1$s %2$s",
+                    msg->rendered_sender, msg->rendered_content);
+            sui_buffer_add_pending_message(self->ui, NULL, action);
+            g_free(action);
+        } else if (msg->type != SRN_MESSAGE_TYPE_MISC){
+            sui_buffer_add_pending_message(self->ui,
+                    msg->rendered_sender, msg->rendered_content);
+        }
+        return TRUE;
+    }
+
+    if (!render_remaining(msg, rflags)){
+        return FALSE;
+    }
+    if (!srn_filter_message(msg, fflags)){
+        return FALSE;
+    }
+    srn_chat_save_snapshot_message(self, msg, rflags);
+
+    msg->render_flags = 0;
+    srn_message_init_ui(msg);
+    append_message(self, msg);
+
+    return TRUE;
+}
+
+/**
+ * @brief render_remaining applies the renderers in flags which are not
+ * applied to message yet on main thread, it happens only when state of chat
+ * is changed after the message is queued, see add_message().
+ *
+ * @return FALSE if failed to render.
+ */
+static bool render_remaining(SrnMessage *msg, SrnRenderFlags flags){
+    SrnRenderFlags remaining;
+
+    remaining = flags & ~msg->rendered_flags;
+    if (!remaining){
+        return TRUE;
+    }
+    if (msg->rendered_flags && remaining & ~SRN_RENDER_FLAG_URL){
+        // Only URL renderer can be applied after other renderers
+        srn_message_reset_rendered(msg);
+        remaining = flags;
+    }
+
+    return srn_render_message(msg, remaining) == SRN_OK;
+}
+
+static void on_message_rendered(SrnMessage *msg, SrnRet ret,
+        void *user_data){
+    if (!RET_IS_OK(ret) || !add_rendered_message(user_data, msg)){
+        srn_message_free(msg);
+    }
+}
+
+static void on_deferred_message_rendered(SrnMessage *msg, SrnRet ret,
+        void *user_data){
+    SrnChat *self;
+
+    self = user_data;
+    msg->render_flags = 0;
+    if (!RET_IS_OK(ret)){
+        // Chat is being freed or the message failed to render, it is still
+        // kept in message list without UI
+        return;
+    }
+
+    srn_message_init_ui(msg);
+    // Side bar is already updated when the message is deferred
+    sui_buffer_insert_message(self->ui, msg->ui);
+}
+
+static void on_mentioned_message_rendered(SrnMessage *msg, SrnRet ret,
+        void *user_data){
+    msg->render_flags = 0;
+    if (!RET_IS_OK(ret)){
+        srn_message_free(msg);
+        return;
+    }
+
+    srn_message_init_ui(msg);
+    append_message(user_data, msg);
+}
+
+/**
+ * @brief collapse_message merges the message into the latest message of chat
+ * if they are the same message sent by the same user in a short time, only
+ * a counter is increased and no new SuiMessage is created.
+ *
+ * @return TRUE if the message is collapsed.
+ */
+static bool collapse_message(SrnChat *self, SrnMessage *msg,
+        SrnFilterFlags fflags){
+    SrnMessage *last;
+
+    last = self->last_msg;
+    if (!last){
+        return FALSE;
+    }
+
+    switch (msg->type) {
+        case SRN_MESSAGE_TYPE_RECV:
+        case SRN_MESSAGE_TYPE_ACTION:
+        case SRN_MESSAGE_TYPE_NOTICE:
+            break;
+        default:
+            return FALSE;
+    }
+    if (last->type != msg->type
+            || last->sender != msg->sender
+            || msg->time - last->repeat_time > SRN_CHAT_REPEAT_INTERVAL
+            || strcmp(last->content, msg->content) != 0){
+        return FALSE;
+    }
+
+    // Every line is still recorded, the previous one has passed other filters
+    srn_filter_message(msg, fflags & SRN_FILTER_FLAG_LOG);
+
+    /* NOTE: Repeated message is intentionally not notified again even if it
+     * mentions us: it has the same content as the last one, which has
+     * already been notified, and a flood of repeats would otherwise flood
+     * notifications too. Only the counter is updated. */
+    last->repeat_count++;
+    last->repeat_time = msg->time;
+    if (last->ui){
+        sui_update_message_content(last->ui);
+    }
+    // Deferred message shows the counter once it is rendered
+
+    return TRUE;
+}
+
+static bool is_deferrable(SrnChat *self, SrnMessage *msg){
+    if (srn_chat_is_visible(self)){
+        return FALSE;
+    }
+    // Messages of low priority chat are always deferred
+    if (self->type != SRN_CHAT_TYPE_CHANNEL
+            && self->priority != SRN_CHAT_PRIORITY_LOW){
+        return FALSE;
+    }
+
+    switch (msg->type) {
+        case SRN_MESSAGE_TYPE_RECV:
+        case SRN_MESSAGE_TYPE_ACTION:
+        case SRN_MESSAGE_TYPE_MISC:
+            return TRUE;
+        default:
+            // Notice and error message are always notified
+            return FALSE;
+    }
+}
+
+static void append_message(SrnChat *self, SrnMessage *msg){
+    self->msg_list = g_list_prepend(self->msg_list, msg);
     self->last_msg = msg;
 
     sui_buffer_add_message(self->ui, msg->ui);
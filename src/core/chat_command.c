@@ -54,6 +54,8 @@ typedef struct _SrnChatCommandContext {
 static SrnApplication* ctx_get_app(SrnChatCommandContext *cctx);
 static SrnServer* ctx_get_server(SrnChatCommandContext *cctx);
 static SrnChat* ctx_get_chat(SrnChatCommandContext *cctx);
+static void on_server_registered(SrnServer *srv, bool registered,
+        gpointer user_data);
 
 /*******************************************************************************
  * Exported functions
@@ -164,10 +166,7 @@ SrnRet on_command_server(SrnCommand *cmd, void *user_data){
             return ret;
         }
 
-        srn_server_wait_until_registered(srv); // FIXME: busy wait
-        if (!srn_server_is_registered(srv)){
-            return RET_ERR(_("Failed to register on server \"%1$s\""), name);
-        }
+        srn_server_run_when_registered(srv, on_server_registered, NULL, NULL);
 
         return SRN_OK;
     }
@@ -301,11 +300,7 @@ SrnRet on_command_connect(SrnCommand *cmd, void *user_data){
         goto FIN;
     }
 
-    srn_server_wait_until_registered(srv);
-    if (!srn_server_is_registered(srv)){
-        ret = RET_ERR(_("Failed to register on server \"%1$s\""), srv->name);
-        goto FIN;
-    }
+    srn_server_run_when_registered(srv, on_server_registered, NULL, NULL);
 
     ret = SRN_OK;
 FIN:
@@ -444,7 +439,9 @@ SrnRet on_command_unfilter(SrnCommand *cmd, void *user_data){
 
 SrnRet on_command_query(SrnCommand *cmd, void *user_data){
     const char *nick;
+    SrnRet ret;
     SrnServer *srv;
+    SrnChat *chat;
 
     srv = ctx_get_server(user_data);
     g_return_val_if_fail(srv, SRN_ERR);
@@ -452,7 +449,15 @@ SrnRet on_command_query(SrnCommand *cmd, void *user_data){
     nick = srn_command_get_arg(cmd, 0);
     g_return_val_if_fail(nick, SRN_ERR);
 
-    return srn_server_add_chat(srv, nick);
+    ret = srn_server_add_chat(srv, nick);
+    if (!RET_IS_OK(ret)){
+        return ret;
+    }
+    chat = srn_server_get_chat(srv, nick);
+    g_return_val_if_fail(chat, SRN_ERR);
+    sui_activate_buffer(chat->ui);
+
+    return ret;
 }
 
 SrnRet on_command_unquery(SrnCommand *cmd, void *user_data){
@@ -487,7 +492,7 @@ SrnRet on_command_join(SrnCommand *cmd, void *user_data){
 
     g_return_val_if_fail(chan, SRN_ERR);
 
-    return sirc_cmd_join(srv->irc, chan, passwd);
+    return srn_server_join_chat(srv, chan, passwd);
 }
 
 SrnRet on_command_part(SrnCommand *cmd, void *user_data){
@@ -925,3 +930,15 @@ static SrnChat* ctx_get_chat(SrnChatCommandContext *cctx){
 
     return cctx->chat;
 }
+
+/**
+ * @brief on_server_registered reports registration failure of server
+ * connected by command, the command itself has returned at this time.
+ */
+static void on_server_registered(SrnServer *srv, bool registered,
+        gpointer user_data){
+    if (!registered){
+        srn_chat_add_error_message_fmt(srv->chat,
+                _("Failed to register on server \"%1$s\""), srv->name);
+    }
+}
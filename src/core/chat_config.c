@@ -37,6 +37,9 @@ SrnRet srn_chat_config_check(SrnChatConfig *cfg){
     if (!cfg){
         return RET_ERR(_("Invalid chat config instance"));
     }
+    if (cfg->priority == SRN_CHAT_PRIORITY_UNKNOWN){
+        return RET_ERR(_("Unknown chat priority"));
+    }
     return sui_buffer_config_check(cfg->ui);
 }
 
@@ -45,6 +48,38 @@ void srn_chat_config_free(SrnChatConfig *cfg){
 
     str_assign(&cfg->password, NULL);
     g_list_free_full(cfg->auto_run_cmd_list, g_free);
+    g_list_free_full(cfg->highlight_list, g_free);
+    g_list_free_full(cfg->never_highlight_list, g_free);
     sui_buffer_config_free(cfg->ui);
     g_free(cfg);
 }
+
+const char* srn_chat_priority_to_string(SrnChatPriority priority){
+    switch (priority){
+        case SRN_CHAT_PRIORITY_NORMAL:
+            return "normal";
+        case SRN_CHAT_PRIORITY_LOW:
+            return "low";
+        case SRN_CHAT_PRIORITY_LOG_ONLY:
+            return "log-only";
+        default:
+            g_warn_if_reached();
+            return NULL;
+    }
+}
+
+SrnChatPriority srn_chat_priority_from_string(const char *str){
+    SrnChatPriority priority;
+
+    if (str == NULL || g_ascii_strcasecmp(str, "normal") == 0){
+        priority = SRN_CHAT_PRIORITY_NORMAL;
+    } else if (g_ascii_strcasecmp(str, "low") == 0){
+        priority = SRN_CHAT_PRIORITY_LOW;
+    } else if (g_ascii_strcasecmp(str, "log-only") == 0){
+        priority = SRN_CHAT_PRIORITY_LOG_ONLY;
+    } else {
+        priority = SRN_CHAT_PRIORITY_UNKNOWN;
+    }
+
+    return priority;
+}
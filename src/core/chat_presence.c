@@ -0,0 +1,130 @@
+/* Copyright (C) 2016-2021 Shengyu Zhang <i@silverrainz.me>
+ *
+ * This file is part of Srain.
+ *
+ * Srain is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file chat_presence.c
+ * @brief Activity-aware presence messages, JOINs, PARTs, QUITs and NICKs of
+ * users who have not spoken recently are counted into a periodic summary
+ * instead of being shown one by one.
+ * @author Shengyu Zhang <i@silverrainz.me>
+ * @version 1.2.0
+ * @date 2021-03-12
+ */
+
+#include <glib.h>
+
+#include "core/core.h"
+
+#include "log.h"
+#include "i18n.h"
+
+static gboolean summary_timeout(gpointer user_data);
+
+/**
+ * @brief srn_chat_hide_presence decides whether the message of a presence
+ * change should be hidden. The hidden changes are counted and a summary
+ * message is posted every SRN_CHAT_PRESENCE_SUMMARY_INTERVAL seconds.
+ *
+ * @param self
+ * @param user is the user whose presence changes.
+ * @param presence
+ *
+ * @return TRUE if caller should not add message for this change.
+ */
+bool srn_chat_hide_presence(SrnChat *self, SrnChatUser *user,
+        SrnChatPresence presence){
+    gint64 window;
+
+    g_return_val_if_fail(presence < SRN_CHAT_PRESENCE_MAX, FALSE);
+
+    if (self->type != SRN_CHAT_TYPE_CHANNEL
+            || self->cfg->presence_window <= 0
+            || user->srv_user->is_me){
+        return FALSE;
+    }
+
+    window = (gint64)self->cfg->presence_window * G_USEC_PER_SEC;
+    if (user->last_active && g_get_real_time() - user->last_active < window){
+        return FALSE;
+    }
+
+    self->hidden_presence[presence]++;
+    if (!self->presence_timer){
+        self->presence_timer = srn_timer_wheel_add(
+                srn_application_get_default()->timer_wheel, "presence summary",
+                SRN_CHAT_PRESENCE_SUMMARY_INTERVAL * 1000, summary_timeout, self);
+    }
+
+    return TRUE;
+}
+
+/**
+ * @brief srn_chat_clear_hidden_presence forgets the hidden presence changes
+ * without posting summary.
+ *
+ * @param self
+ */
+void srn_chat_clear_hidden_presence(SrnChat *self){
+    if (self->presence_timer){
+        srn_timer_wheel_remove(srn_application_get_default()->timer_wheel,
+                self->presence_timer);
+        self->presence_timer = 0;
+    }
+    for (int i = 0; i < SRN_CHAT_PRESENCE_MAX; i++){
+        self->hidden_presence[i] = 0;
+    }
+}
+
+static gboolean summary_timeout(gpointer user_data){
+    int *counts;
+    GString *summary;
+    SrnChat *self;
+
+    self = user_data;
+    self->presence_timer = 0;
+    counts = self->hidden_presence;
+
+    summary = g_string_new(NULL);
+    if (counts[SRN_CHAT_PRESENCE_JOIN]){
+        g_string_append_printf(summary, _("%1$d joined, "),
+                counts[SRN_CHAT_PRESENCE_JOIN]);
+    }
+    if (counts[SRN_CHAT_PRESENCE_PART]){
+        g_string_append_printf(summary, _("%1$d left, "),
+                counts[SRN_CHAT_PRESENCE_PART]);
+    }
+    if (counts[SRN_CHAT_PRESENCE_QUIT]){
+        g_string_append_printf(summary, _("%1$d quit, "),
+                counts[SRN_CHAT_PRESENCE_QUIT]);
+    }
+    if (counts[SRN_CHAT_PRESENCE_NICK]){
+        g_string_append_printf(summary, _("%1$d changed nickname, "),
+                counts[SRN_CHAT_PRESENCE_NICK]);
+    }
+    srn_chat_clear_hidden_presence(self);
+
+    if (summary->len){
+        g_string_truncate(summary, summary->len - 2); // Remove trailing ", "
+        DBG_FR("Chat %s: %s", self->name, summary->str);
+        srn_chat_add_misc_message_fmt(self,
+                _("Inactive users: %1$s"), summary->str);
+    }
+    g_string_free(summary, TRUE);
+
+    return G_SOURCE_REMOVE;
+}
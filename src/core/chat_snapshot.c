@@ -0,0 +1,589 @@
+/* Copyright (C) 2016-2021 Shengyu Zhang <i@silverrainz.me>
+ *
+ * This file is part of Srain.
+ *
+ * Srain is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file chat_snapshot.c
+ * @brief Scrollback snapshot of chat, recent messages of chat are appended to
+ * a compact binary file while running, and are loaded via mmap(2) when
+ * application restarts.
+ * @author Shengyu Zhang <i@silverrainz.me>
+ * @version 1.2.0
+ * @date 2021-03-10
+ *
+ * File layout: SNAPSHOT_MAGIC followed by records, a record is a
+ * SrnSnapshotRecord followed by sender nickname and raw message content,
+ * both are not NUL-terminated. A truncated or invalid record ends the file.
+ *
+ * Records are buffered in memory and written every SNAPSHOT_FLUSH_INTERVAL
+ * seconds, when the chat is freed or when application shuts down. All file
+ * operations run in a single IO thread, in the order they are issued.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "core/core.h"
+#include "render/render.h"
+
+#include "log.h"
+#include "path.h"
+
+#define SNAPSHOT_MAGIC      "SRNSNAP1"
+#define SNAPSHOT_MAGIC_LEN  (sizeof(SNAPSHOT_MAGIC) - 1)
+
+/* Interval of writing buffered records to file, in seconds */
+#define SNAPSHOT_FLUSH_INTERVAL 5
+
+typedef enum _SrnSnapshotFlags SrnSnapshotFlags;
+typedef struct _SrnSnapshotRecord SrnSnapshotRecord;
+typedef struct _SrnSnapshotJob SrnSnapshotJob;
+
+enum _SrnSnapshotFlags {
+    SNAPSHOT_FLAG_MENTIONED = 1 << 0,
+    SNAPSHOT_FLAG_SELF = 1 << 1, // Sent by SrnChat->user
+    SNAPSHOT_FLAG_SYSTEM = 1 << 2, // Sent by SrnChat->_user
+    SNAPSHOT_FLAG_ALL = (1 << 3) - 1,
+};
+
+struct _SrnSnapshotRecord {
+    guint32 len; // Length of whole record
+    guint8 type; // SrnMessageType
+    guint8 flags; // SrnSnapshotFlags
+    guint16 sender_len;
+    gint64 time;
+    guint32 render_flags; // SrnRenderFlags
+    guint32 content_len;
+};
+
+G_STATIC_ASSERT(sizeof(SrnSnapshotRecord) == 24);
+
+struct _SrnChatSnapshot {
+    char *path;
+    GMappedFile *history; // Snapshot of last run, NULL once rehydrated
+    GByteArray *records; // Records not yet written, NULL if there is none
+    int flush_timer;
+    bool reset; // File should be started over before next write
+    bool compact; // Old records should be dropped after next write
+    int appended; // Number of appended records since last compaction
+};
+
+/* A write request executed by IO thread */
+struct _SrnSnapshotJob {
+    char *path;
+    bool reset;
+    GByteArray *records; // Can be NULL
+    bool compact;
+};
+
+static GThreadPool *io_pool; // Single thread, jobs are run in order
+
+static bool is_snapshot_enabled(SrnChat *chat);
+static void on_history_message_rendered(SrnMessage *msg, SrnRet ret,
+        void *user_data);
+static gboolean flush_timeout(gpointer user_data);
+static void flush_snapshot(SrnChatSnapshot *self);
+static void push_job(SrnSnapshotJob *job);
+static void io_job_func(gpointer data, gpointer user_data);
+static gboolean report_io_error(gpointer user_data);
+static bool read_record(const char *data, gsize len, gsize offset,
+        SrnSnapshotRecord *rec);
+static int scan_records(const char *data, gsize len, gsize *end);
+static gsize skip_records(const char *data, gsize offset, int count);
+static bool write_records(const char *path, GByteArray *records,
+        GError **err);
+static bool compact_snapshot(const char *path, GError **err);
+
+/**
+ * @brief srn_chat_open_snapshot maps the scrollback snapshot of given chat,
+ * the snapshot is not parsed until srn_chat_rehydrate_snapshot() is called.
+ *
+ * @param chat
+ */
+void srn_chat_open_snapshot(SrnChat *chat){
+    char *fname;
+    char *path;
+    GError *err;
+    GMappedFile *mapped;
+    SrnChatSnapshot *self;
+
+    g_return_if_fail(!chat->snapshot);
+
+    if (!is_snapshot_enabled(chat)){
+        return;
+    }
+
+    fname = g_strdup_printf("%s.snapshot", chat->name);
+    path = srn_create_snapshot_file(chat->srv->name, fname);
+    g_free(fname);
+    if (!path){
+        return;
+    }
+
+    self = g_malloc0(sizeof(SrnChatSnapshot));
+    self->path = path;
+
+    err = NULL;
+    mapped = g_mapped_file_new(path, FALSE, &err);
+    if (err){
+        WARN_FR("Failed to map snapshot file '%s': %s", path, err->message);
+        g_error_free(err);
+    } else if (g_mapped_file_get_length(mapped) > SNAPSHOT_MAGIC_LEN
+            && memcmp(g_mapped_file_get_contents(mapped),
+                SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_LEN) == 0){
+        self->history = mapped;
+    } else {
+        // Empty or unknown file, start over when first message is written
+        g_mapped_file_unref(mapped);
+        self->reset = TRUE;
+    }
+
+    chat->snapshot = self;
+}
+
+void srn_chat_close_snapshot(SrnChat *chat){
+    SrnChatSnapshot *self;
+
+    self = chat->snapshot;
+    if (!self){
+        return;
+    }
+
+    flush_snapshot(self);
+    if (self->history){
+        g_mapped_file_unref(self->history);
+    }
+    g_free(self->path);
+    g_free(self);
+
+    chat->snapshot = NULL;
+}
+
+/**
+ * @brief srn_chat_flush_snapshot writes buffered messages to the snapshot of
+ * given chat in background, it should be called before application exits.
+ *
+ * @param chat
+ */
+void srn_chat_flush_snapshot(SrnChat *chat){
+    if (chat->snapshot){
+        flush_snapshot(chat->snapshot);
+    }
+}
+
+/**
+ * @brief srn_chat_snapshot_finalize waits for all pending writes of
+ * snapshots, subsequent writes are done synchronously.
+ */
+void srn_chat_snapshot_finalize(void){
+    if (io_pool){
+        g_thread_pool_free(io_pool, FALSE, TRUE);
+        io_pool = NULL;
+    }
+}
+
+/**
+ * @brief srn_chat_save_snapshot_message appends a message to the snapshot
+ * of given chat. Nothing is saved if log or snapshot is disabled in chat
+ * config.
+ *
+ * @param chat
+ * @param msg
+ * @param rflags is the SrnRenderFlags used to render this message.
+ */
+void srn_chat_save_snapshot_message(SrnChat *chat, SrnMessage *msg,
+        int rflags){
+    const char *nick;
+    SrnSnapshotRecord rec;
+    SrnChatSnapshot *self;
+
+    self = chat->snapshot;
+    if (!self || msg->type == SRN_MESSAGE_TYPE_UNKNOWN
+            || !is_snapshot_enabled(chat)){
+        return;
+    }
+
+    memset(&rec, 0, sizeof(rec));
+    if (msg->mentioned){
+        rec.flags |= SNAPSHOT_FLAG_MENTIONED;
+    }
+    if (msg->sender == chat->user){
+        rec.flags |= SNAPSHOT_FLAG_SELF;
+    } else if (msg->sender == chat->_user){
+        rec.flags |= SNAPSHOT_FLAG_SYSTEM;
+    }
+    nick = msg->sender->srv_user->nick;
+    rec.type = msg->type;
+    rec.time = msg->time;
+    rec.render_flags = rflags;
+    rec.sender_len = MIN(strlen(nick), G_MAXUINT16);
+    rec.content_len = strlen(msg->content);
+    rec.len = sizeof(rec) + rec.sender_len + rec.content_len;
+
+    if (!self->records){
+        self->records = g_byte_array_sized_new(rec.len);
+    }
+    g_byte_array_append(self->records, (guint8 *)&rec, sizeof(rec));
+    g_byte_array_append(self->records, (guint8 *)nick, rec.sender_len);
+    g_byte_array_append(self->records, (guint8 *)msg->content,
+            rec.content_len);
+
+    self->appended++;
+    if (self->appended >= SRN_CHAT_SNAPSHOT_SIZE){
+        self->appended = 0;
+        self->compact = TRUE;
+    }
+    if (!self->flush_timer){
+        self->flush_timer = g_timeout_add_seconds(SNAPSHOT_FLUSH_INTERVAL,
+                flush_timeout, self);
+    }
+}
+
+/**
+ * @brief srn_chat_rehydrate_snapshot loads messages from the snapshot of last
+ * run, they are older than any existing message of given chat.
+ * It should be called when the chat is first shown.
+ *
+ * @param chat
+ */
+void srn_chat_rehydrate_snapshot(SrnChat *chat){
+    int count;
+    gsize len;
+    gsize end;
+    gsize offset;
+    gint64 start;
+    const char *data;
+    GList *lst;
+    GList *history;
+    SrnChatSnapshot *self;
+
+    self = chat->snapshot;
+    if (!self || !self->history){
+        return;
+    }
+
+    start = g_get_monotonic_time();
+    data = g_mapped_file_get_contents(self->history);
+    len = g_mapped_file_get_length(self->history);
+    count = scan_records(data, len, &end);
+    offset = skip_records(data, SNAPSHOT_MAGIC_LEN,
+            MAX(count - SRN_CHAT_SNAPSHOT_SIZE, 0));
+
+    /* Build messages, latest message first */
+    history = NULL;
+    while (offset < end){
+        char *nick;
+        char *content;
+        SrnChatUser *user;
+        SrnMessage *msg;
+        SrnSnapshotRecord rec;
+
+        read_record(data, end, offset, &rec);
+        nick = NULL;
+        if (rec.flags & SNAPSHOT_FLAG_SELF){
+            user = chat->user;
+        } else if (rec.flags & SNAPSHOT_FLAG_SYSTEM){
+            user = chat->_user;
+        } else {
+            /* Users who have left are not brought back, their messages are
+             * attributed to chat->_user and only show their nicknames */
+            nick = g_strndup(data + offset + sizeof(rec), rec.sender_len);
+            user = srn_chat_get_user(chat, nick);
+            if (!user){
+                user = chat->_user;
+            }
+        }
+        content = g_strndup(data + offset + sizeof(rec) + rec.sender_len,
+                rec.content_len);
+        msg = srn_message_new(chat, user, content, rec.type);
+        g_free(content);
+        if (nick){
+            srn_message_set_rendered_sender(msg, nick);
+            g_free(nick);
+        }
+        msg->time = rec.time;
+        msg->mentioned = rec.flags & SNAPSHOT_FLAG_MENTIONED;
+        msg->render_flags = rec.render_flags & ~SRN_RENDER_FLAG_MENTION;
+        history = g_list_prepend(history, msg);
+
+        offset += rec.len;
+    }
+
+    /* Messages are rendered in background and prepended to UI from the
+     * latest one, so the latest one is pushed to head at last */
+    for (lst = g_list_last(history); lst; lst = g_list_previous(lst)){
+        SrnMessage *msg;
+
+        msg = lst->data;
+        srn_render_queue_push_head(chat->render_queue, msg, msg->render_flags,
+                on_history_message_rendered, chat);
+    }
+    if (!chat->last_msg && history){
+        chat->last_msg = history->data;
+    }
+    chat->msg_list = g_list_concat(chat->msg_list, history);
+
+    g_mapped_file_unref(self->history);
+    self->history = NULL;
+    if (count > SRN_CHAT_SNAPSHOT_SIZE){
+        self->compact = TRUE;
+        flush_snapshot(self);
+    }
+
+    DBG_FR("Rehydrated %d messages of chat %s in %" G_GINT64_FORMAT "us",
+            MIN(count, SRN_CHAT_SNAPSHOT_SIZE), chat->name,
+            g_get_monotonic_time() - start);
+}
+
+static bool is_snapshot_enabled(SrnChat *chat){
+    return chat->cfg->log && chat->cfg->snapshot;
+}
+
+static void on_history_message_rendered(SrnMessage *msg, SrnRet ret,
+        void *user_data){
+    SrnChat *chat;
+
+    chat = user_data;
+    msg->render_flags = 0;
+    if (!RET_IS_OK(ret)){
+        // Chat is being freed or the message failed to render, it is still
+        // kept in message list without UI
+        return;
+    }
+
+    srn_message_init_ui(msg);
+    sui_buffer_prepend_message(chat->ui, msg->ui);
+}
+
+static gboolean flush_timeout(gpointer user_data){
+    SrnChatSnapshot *self;
+
+    self = user_data;
+    self->flush_timer = 0;
+    flush_snapshot(self);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void flush_snapshot(SrnChatSnapshot *self){
+    SrnSnapshotJob *job;
+
+    if (self->flush_timer){
+        g_source_remove(self->flush_timer);
+        self->flush_timer = 0;
+    }
+    if (!self->records && !self->compact){
+        return;
+    }
+
+    job = g_malloc0(sizeof(SrnSnapshotJob));
+    job->path = g_strdup(self->path);
+    job->reset = self->reset;
+    job->records = self->records;
+    job->compact = self->compact;
+    push_job(job);
+
+    self->reset = FALSE;
+    self->records = NULL;
+    self->compact = FALSE;
+}
+
+static void push_job(SrnSnapshotJob *job){
+    GError *err;
+
+    if (!io_pool){
+        err = NULL;
+        io_pool = g_thread_pool_new(io_job_func, NULL, 1, FALSE, &err);
+        if (err){
+            WARN_FR("Failed to create snapshot IO thread: %s", err->message);
+            g_error_free(err);
+        }
+    }
+    if (io_pool){
+        g_thread_pool_push(io_pool, job, NULL);
+    } else {
+        io_job_func(job, NULL);
+    }
+}
+
+/**
+ * @brief io_job_func runs a SrnSnapshotJob in IO thread. Nothing is logged
+ * here, errors are reported in main thread by report_io_error().
+ */
+static void io_job_func(gpointer data, gpointer user_data){
+    GError *err;
+    SrnSnapshotJob *job;
+
+    job = data;
+    err = NULL;
+    if (job->reset){
+        g_file_set_contents(job->path, SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_LEN,
+                &err);
+    }
+    if (!err && job->records){
+        write_records(job->path, job->records, &err);
+    }
+    if (!err && job->compact){
+        compact_snapshot(job->path, &err);
+    }
+    if (err){
+        g_idle_add(report_io_error, g_strdup_printf(
+                    "Failed to write snapshot file '%s': %s",
+                    job->path, err->message));
+        g_error_free(err);
+    }
+
+    if (job->records){
+        g_byte_array_unref(job->records);
+    }
+    g_free(job->path);
+    g_free(job);
+}
+
+static gboolean report_io_error(gpointer user_data){
+    char *msg;
+
+    msg = user_data;
+    WARN_FR("%s", msg);
+    g_free(msg);
+
+    return G_SOURCE_REMOVE;
+}
+
+static bool read_record(const char *data, gsize len, gsize offset,
+        SrnSnapshotRecord *rec){
+    if (len - offset < sizeof(SrnSnapshotRecord)){
+        return FALSE;
+    }
+    memcpy(rec, data + offset, sizeof(SrnSnapshotRecord));
+    if (rec->len != sizeof(SrnSnapshotRecord)
+            + (gsize)rec->sender_len + rec->content_len){
+        return FALSE;
+    }
+    if (rec->type <= SRN_MESSAGE_TYPE_UNKNOWN
+            || rec->type > SRN_MESSAGE_TYPE_ERROR
+            || rec->flags & ~SNAPSHOT_FLAG_ALL){
+        return FALSE;
+    }
+    return len - offset >= rec->len;
+}
+
+/**
+ * @brief scan_records counts valid records.
+ *
+ * @param data
+ * @param len
+ * @param end returns the end offset of the last valid record.
+ *
+ * @return Number of valid records.
+ */
+static int scan_records(const char *data, gsize len, gsize *end){
+    int count;
+    gsize offset;
+    SrnSnapshotRecord rec;
+
+    count = 0;
+    offset = SNAPSHOT_MAGIC_LEN;
+    while (offset < len && read_record(data, len, offset, &rec)){
+        offset += rec.len;
+        count++;
+    }
+    *end = offset;
+
+    return count;
+}
+
+static gsize skip_records(const char *data, gsize offset, int count){
+    SrnSnapshotRecord rec;
+
+    // Records are already validated by scan_records()
+    while (count--){
+        memcpy(&rec, data + offset, sizeof(rec));
+        offset += rec.len;
+    }
+
+    return offset;
+}
+
+static bool write_records(const char *path, GByteArray *records,
+        GError **err){
+    bool ok;
+    FILE *fp;
+
+    fp = g_fopen(path, "ab");
+    if (!fp){
+        g_set_error_literal(err, G_FILE_ERROR, g_file_error_from_errno(errno),
+                g_strerror(errno));
+        return FALSE;
+    }
+    ok = fwrite(records->data, 1, records->len, fp) == records->len;
+    if (!ok){
+        g_set_error_literal(err, G_FILE_ERROR, g_file_error_from_errno(errno),
+                g_strerror(errno));
+    }
+    fclose(fp);
+
+    return ok;
+}
+
+/**
+ * @brief compact_snapshot drops old records, only the latest
+ * SRN_CHAT_SNAPSHOT_SIZE records are kept. It runs in IO thread.
+ */
+static bool compact_snapshot(const char *path, GError **err){
+    bool ok;
+    int count;
+    gsize len;
+    gsize end;
+    gsize offset;
+    const char *data;
+    char *buf;
+    GMappedFile *mapped;
+
+    mapped = g_mapped_file_new(path, FALSE, err);
+    if (!mapped){
+        return FALSE;
+    }
+
+    ok = TRUE;
+    data = g_mapped_file_get_contents(mapped);
+    len = g_mapped_file_get_length(mapped);
+    if (len < SNAPSHOT_MAGIC_LEN
+            || memcmp(data, SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_LEN) != 0){
+        goto FIN;
+    }
+    count = scan_records(data, len, &end);
+    if (count <= SRN_CHAT_SNAPSHOT_SIZE && end == len){
+        goto FIN;
+    }
+    offset = skip_records(data, SNAPSHOT_MAGIC_LEN,
+            MAX(count - SRN_CHAT_SNAPSHOT_SIZE, 0));
+
+    /* The file is replaced by rename(2), existing mapping is still valid */
+    buf = g_malloc(SNAPSHOT_MAGIC_LEN + end - offset);
+    memcpy(buf, SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_LEN);
+    memcpy(buf + SNAPSHOT_MAGIC_LEN, data + offset, end - offset);
+    ok = g_file_set_contents(path, buf, SNAPSHOT_MAGIC_LEN + end - offset, err);
+    g_free(buf);
+
+FIN:
+    g_mapped_file_unref(mapped);
+    return ok;
+}
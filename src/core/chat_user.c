@@ -66,6 +66,7 @@ void srn_chat_user_set_is_joined(SrnChatUser *self, bool joined){
         sui_add_user(self->chat->ui, self->ui);
     } else {
         sui_rm_user(self->chat->ui, self->ui);
+        srn_server_queue_user_gc(self->srv_user->srv, self->srv_user);
     }
 }
 
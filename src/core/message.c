@@ -16,15 +16,23 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <string.h>
 #include <glib.h>
 
 #include "core/core.h"
 
 #include "srain.h"
 #include "utils.h"
+#include "intern.h"
+#include "markup_escape.h"
+
+static const char* intern_markup(const char *str);
+static const char* get_cached_short_time(gint64 time);
 
 SrnMessage* srn_message_new(SrnChat *chat, SrnChatUser *user,
         const char *content, SrnMessageType type){
+    int len;
+    GString *arena;
     SrnMessage *self;
 
     g_return_val_if_fail(chat, NULL);
@@ -40,23 +48,43 @@ SrnMessage* srn_message_new(SrnChat *chat, SrnChatUser *user,
 
     self->type = type;
     self->sender = user;
+    user->msg_count++;
     self->chat = chat;
-    self->content = g_strdup(content);
-    self->time = g_date_time_new_now_local();
+    self->time = g_get_real_time();
+
+    /* Raw content and its inital rendered form share one memory block
+     * (message arena), renderers replace rendered_content with their own
+     * allocated string via srn_message_set_rendered_content() */
+    len = strlen(content);
+    arena = g_string_sized_new(len * 2 + 2);
+    g_string_append_len(arena, content, len + 1); // Including NUL
+    srn_markup_escape_append(arena, content, len);
+    self->content = g_string_free(arena, FALSE);
+    self->rendered_content = self->content + len + 1;
 
     // Inital render
-    self->rendered_sender = g_markup_escape_text(user->srv_user->nick, -1);
-    self->rendered_remark = g_markup_escape_text("", -1);
-    self->rendered_content = g_markup_escape_text(content, -1);
-    self->rendered_short_time = g_date_time_format(self->time, "%R");
-#ifdef G_OS_WIN32
-    // FIXME: g_date_time_format(xxx, "%c") does not work on MS Windows
-    self->rendered_full_time = g_date_time_format(self->time, "%F %R");
-#else
-    self->rendered_full_time = g_date_time_format(self->time, "%c");
-#endif
+    self->rendered_sender = intern_markup(user->srv_user->nick);
+    self->rendered_remark = srn_intern("");
+    self->rendered_time = NULL;
 
     self->mentioned = FALSE;
+    self->rendered_flags = 0;
+    self->render_flags = 0;
+    self->filter_flags = 0;
+    self->repeat_count = 1;
+    self->repeat_time = self->time;
+
+    return self;
+}
+
+/**
+ * @brief srn_message_init_ui creates the SuiMessage of message, it should be
+ * called after message is rendered.
+ *
+ * @param self
+ */
+void srn_message_init_ui(SrnMessage *self){
+    g_return_if_fail(!self->ui);
 
     switch (self->type){
         case SRN_MESSAGE_TYPE_SENT:
@@ -81,15 +109,37 @@ SrnMessage* srn_message_new(SrnChat *chat, SrnChatUser *user,
             self->ui = sui_new_misc_message(self, SUI_MISC_MESSAGE_STYLE_NORMAL);
             g_warn_if_reached();
     }
+}
 
-    return self;
+/**
+ * @brief srn_message_reset_rendered drops the result of previous rendering,
+ * so that the message can be rendered again from scratch.
+ *
+ * @param self
+ */
+void srn_message_reset_rendered(SrnMessage *self){
+    srn_message_set_rendered_content(self,
+            self->content + strlen(self->content) + 1);
+    srn_message_set_rendered_sender(self, self->sender->srv_user->nick);
+    srn_message_set_rendered_remark(self, "");
+    srn_message_set_rendered_time(self, NULL);
+    g_list_free_full(self->urls, g_free);
+    self->urls = NULL;
+    str_assign(&self->plain_content, NULL);
+    srn_message_set_rendered_spans(self, NULL);
+    self->rendered_flags = 0;
+    self->mentioned = FALSE;
 }
 
 char* srn_message_to_string(const SrnMessage *self){
     char *time_str;
     char *msg_str;
+    GDateTime *time;
 
-    time_str = g_date_time_format(self->time, "%T");
+    time = srn_message_get_date_time(self);
+    g_return_val_if_fail(time, NULL);
+    time_str = g_date_time_format(time, "%T");
+    g_date_time_unref(time);
     g_return_val_if_fail(time_str, NULL);
 
     switch (self->type){
@@ -127,15 +177,227 @@ char* srn_message_to_string(const SrnMessage *self){
 }
 
 void srn_message_free(SrnMessage *self){
-    str_assign(&self->content, NULL);
-    g_date_time_unref(self->time);
-
-    str_assign(&self->rendered_sender, NULL);
-    str_assign(&self->rendered_remark, NULL);
-    str_assign(&self->rendered_content, NULL);
-    str_assign(&self->rendered_short_time, NULL);
-    str_assign(&self->rendered_full_time, NULL);
+    srn_message_set_rendered_content(self, NULL);
+    srn_intern_unref(self->rendered_sender);
+    srn_intern_unref(self->rendered_remark);
+    str_assign(&self->rendered_time, NULL);
     g_list_free_full(self->urls, g_free);
+    str_assign(&self->plain_content, NULL);
+    srn_message_set_rendered_spans(self, NULL);
+    g_free(self->content); // Message arena
+
+    // Sender is no longer referred by this message, see get_user_gc_state()
+    if (--self->sender->msg_count == 0){
+        srn_server_queue_user_gc(self->sender->srv_user->srv,
+                self->sender->srv_user);
+    }
 
     g_free(self);
 }
+
+/**
+ * @brief srn_message_set_rendered_sender sets the sender of message.
+ *
+ * @param self
+ * @param sender is a plain text which will be escaped.
+ */
+void srn_message_set_rendered_sender(SrnMessage *self, const char *sender){
+    const char *old;
+
+    old = self->rendered_sender;
+    self->rendered_sender = intern_markup(sender);
+    srn_intern_unref(old);
+}
+
+/**
+ * @brief srn_message_set_rendered_remark sets the remark of message.
+ *
+ * @param self
+ * @param remark is a plain text which will be escaped.
+ */
+void srn_message_set_rendered_remark(SrnMessage *self, const char *remark){
+    const char *old;
+
+    old = self->rendered_remark;
+    self->rendered_remark = intern_markup(remark);
+    srn_intern_unref(old);
+}
+
+/**
+ * @brief srn_message_set_rendered_content replaces the rendered content of
+ * message.
+ *
+ * @param self
+ * @param content is a valid markup string, the ownership of it is transferred
+ * to message.
+ */
+void srn_message_set_rendered_content(SrnMessage *self, char *content){
+    char *arena_end;
+
+    /* The inital rendered content lives in message arena and is freed along
+     * with it */
+    arena_end = self->content + strlen(self->content) + 1;
+    if (self->rendered_content != arena_end) {
+        g_free(self->rendered_content);
+    }
+    self->rendered_content = content;
+}
+
+void srn_message_set_rendered_time(SrnMessage *self, const char *time){
+    g_free(self->rendered_time);
+    self->rendered_time = time ? srn_markup_escape(time, -1) : NULL;
+}
+
+/**
+ * @brief srn_message_set_plain_content records the plain text of rendered
+ * content, so that it needs not to be extracted from markup again.
+ *
+ * @param self
+ * @param content is a plain text, NULL if it is the same as raw content.
+ */
+void srn_message_set_plain_content(SrnMessage *self, const char *content){
+    str_assign(&self->plain_content, content);
+}
+
+/**
+ * @brief srn_message_get_plain_content returns the rendered content of
+ * message as plain text.
+ *
+ * @param self
+ *
+ * @return A string owned by message, never be NULL.
+ */
+const char* srn_message_get_plain_content(const SrnMessage *self){
+    return self->plain_content ? self->plain_content : self->content;
+}
+
+/**
+ * @brief srn_message_set_rendered_spans records the attributes of rendered
+ * content, so that UI can apply them to plain content directly instead of
+ * parsing markup again.
+ *
+ * @param self
+ * @param spans is a GArray of SrnRenderSpan, the ownership of it is
+ * transferred to message, can be NULL.
+ */
+void srn_message_set_rendered_spans(SrnMessage *self, GArray *spans){
+    if (self->rendered_spans){
+        g_array_unref(self->rendered_spans);
+    }
+    self->rendered_spans = spans;
+}
+
+/**
+ * @brief srn_message_get_short_time returns the short format message time
+ * in markup.
+ *
+ * @param self
+ *
+ * @return A string which is owned by message or internal time cache, never
+ * be NULL.
+ */
+const char* srn_message_get_short_time(const SrnMessage *self){
+    if (self->rendered_time) {
+        return self->rendered_time;
+    }
+    return get_cached_short_time(self->time);
+}
+
+/**
+ * @brief srn_message_get_full_time formats full message time on demand.
+ *
+ * @param self
+ *
+ * @return A string which should be freed by g_free().
+ */
+char* srn_message_get_full_time(const SrnMessage *self){
+    char *full_time;
+    GDateTime *time;
+
+    time = srn_message_get_date_time(self);
+    g_return_val_if_fail(time, NULL);
+#ifdef G_OS_WIN32
+    // FIXME: g_date_time_format(xxx, "%c") does not work on MS Windows
+    full_time = g_date_time_format(time, "%F %R");
+#else
+    full_time = g_date_time_format(time, "%c");
+#endif
+    g_date_time_unref(time);
+
+    return full_time;
+}
+
+/**
+ * @brief srn_message_get_date_time
+ *
+ * @param self
+ *
+ * @return A GDateTime in local time zone, should be freed by
+ * g_date_time_unref().
+ */
+GDateTime* srn_message_get_date_time(const SrnMessage *self){
+    GDateTime *utc;
+    GDateTime *local;
+
+    utc = g_date_time_new_from_unix_utc(self->time / G_USEC_PER_SEC);
+    g_return_val_if_fail(utc, NULL);
+    local = g_date_time_to_local(utc);
+    g_date_time_unref(utc);
+
+    return local;
+}
+
+/**
+ * @brief intern_markup escapes the given string and returns its canonical
+ * representation. Nicknames rarely contain special characters, so the
+ * escaping is skipped for them.
+ */
+static const char* intern_markup(const char *str){
+    char *escaped;
+    const char *interned;
+
+    if (!srn_markup_need_escape(str, -1)){
+        return srn_intern(str);
+    }
+
+    escaped = srn_markup_escape(str, -1);
+    interned = srn_intern(escaped);
+    g_free(escaped);
+
+    return interned;
+}
+
+/**
+ * @brief get_cached_short_time returns formatted time of the minute which
+ * the given time belongs to. Formatted times are cached by minute of day in
+ * local time, so the cache never grows beyond 1440 entries.
+ */
+static const char* get_cached_short_time(gint64 time){
+    int minute_of_day;
+    gint64 minute;
+    GDateTime *dt;
+    static gint64 last_minute = -1;
+    static const char *last_short_time = NULL;
+    static char short_times[24 * 60][sizeof("00:00")];
+
+    minute = time / G_USEC_PER_SEC / 60;
+    if (minute == last_minute && last_short_time) {
+        return last_short_time;
+    }
+
+    dt = g_date_time_new_from_unix_local(minute * 60);
+    g_return_val_if_fail(dt, "");
+    minute_of_day = g_date_time_get_hour(dt) * 60 + g_date_time_get_minute(dt);
+    g_date_time_unref(dt);
+
+    if (!short_times[minute_of_day][0]) {
+        // Same as g_date_time_format(dt, "%R")
+        g_snprintf(short_times[minute_of_day], sizeof(short_times[0]),
+                "%02d:%02d", minute_of_day / 60, minute_of_day % 60);
+    }
+
+    last_minute = minute;
+    last_short_time = short_times[minute_of_day];
+
+    return last_short_time;
+}
@@ -35,8 +35,28 @@
 #include "srain.h"
 #include "log.h"
 #include "utils.h"
+#include "intern.h"
 #include "i18n.h"
 
+typedef enum {
+    SRN_SERVER_USER_GC_STATE_FREE,   // Can be freed
+    SRN_SERVER_USER_GC_STATE_RECENT, // May be freed later
+    SRN_SERVER_USER_GC_STATE_IN_USE, // Being used
+} SrnServerUserGcState;
+
+typedef struct _SrnServerDeferredAction SrnServerDeferredAction;
+
+struct _SrnServerDeferredAction {
+    SrnServerRegisteredFunc func;
+    gpointer user_data;
+    GDestroyNotify destroy;
+};
+
+static void srn_server_deferred_action_free(SrnServerDeferredAction *action);
+static SrnServerUserGcState get_user_gc_state(SrnServer *srv,
+        SrnServerUser *user, gint64 now);
+static gboolean user_gc_timeout(gpointer user_data);
+
 SrnServer* srn_server_new(const char *name, SrnServerConfig *cfg){
     SrnServer *srv;
 
@@ -74,6 +94,11 @@ SrnServer* srn_server_new(const char *name, SrnServerConfig *cfg){
     srn_server_user_set_realname(srv->user, srv->cfg->user->realname);
     srn_server_user_set_is_me(srv->user, TRUE);
 
+    srv->user_gc_queue = g_queue_new();
+    srv->user_gc_timer = srn_timer_wheel_add(
+            srn_application_get_default()->timer_wheel, "user gc",
+            SRN_SERVER_USER_GC_INTERVAL * 1000, user_gc_timeout, srv);
+
     /* sirc */
     srv->irc = sirc_new_session(
             &srn_application_get_default()->irc_events,
@@ -94,10 +119,20 @@ void srn_server_free(SrnServer *srv){
 
     sirc_free_session(srv->irc);
 
+    srn_server_clear_netsplit(srv);
+    // Server is no longer valid, drop pending actions without running them
+    g_list_free_full(srv->deferred_action_list,
+            (GDestroyNotify)srn_server_deferred_action_free);
+    srn_server_clear_requested_chats(srv);
     g_list_free_full(srv->chat_list, (GDestroyNotify)srn_chat_free);
     // Server's chat should be freed after all chat in chat list are freed
     srn_chat_free(srv->chat);
 
+    srn_timer_wheel_remove(srn_application_get_default()->timer_wheel,
+            srv->user_gc_timer);
+    g_queue_free(srv->user_gc_queue);
+    srv->user_gc_queue = NULL;
+
     // srv->user and srv->_user are freed here as well
     g_hash_table_remove_all(srv->user_table);
 
@@ -211,14 +246,186 @@ bool srn_server_is_registered(SrnServer *srv){
     return srv->state == SRN_SERVER_STATE_CONNECTED && srv->registered == TRUE;
 }
 
-void srn_server_wait_until_registered(SrnServer *srv){
+/**
+ * @brief srn_server_run_when_registered runs the given function once the
+ * server is registered. If the server is already registered, the function is
+ * called immediately, otherwise it is queued and called from the RPL_WELCOME
+ * handler, or called with ``registered`` FALSE when the connection fails.
+ *
+ * @param srv
+ * @param func
+ * @param user_data
+ * @param destroy is called to free ``user_data`` after ``func`` returns,
+ *      can be NULL.
+ */
+void srn_server_run_when_registered(SrnServer *srv, SrnServerRegisteredFunc func,
+        gpointer user_data, GDestroyNotify destroy){
+    SrnServerDeferredAction *action;
+
+    g_return_if_fail(srn_server_is_valid(srv));
+    g_return_if_fail(func);
+
+    if (srn_server_is_registered(srv)){
+        func(srv, TRUE, user_data);
+        if (destroy){
+            destroy(user_data);
+        }
+        return;
+    }
+
+    action = g_malloc0(sizeof(SrnServerDeferredAction));
+    action->func = func;
+    action->user_data = user_data;
+    action->destroy = destroy;
+    srv->deferred_action_list = g_list_append(srv->deferred_action_list, action);
+}
+
+/**
+ * @brief srn_server_finish_deferred_actions runs all queued actions with
+ * current registration state of server. It should be called when server
+ * becomes registered or when the registration can no longer happen.
+ *
+ * An action may free the server (for example, by quitting it), the
+ * remaining actions are dropped without running in that case.
+ *
+ * @param srv
+ */
+void srn_server_finish_deferred_actions(SrnServer *srv){
+    bool registered;
+    GList *lst;
+    GList *actions;
+
+    if (!srv->deferred_action_list){
+        return;
+    }
+
+    // Actions may queue new actions, so take the whole list first
+    actions = srv->deferred_action_list;
+    srv->deferred_action_list = NULL;
+    registered = srn_server_is_registered(srv);
+    DBG_FR("Server %s: finishing %d deferred actions, registered: %d",
+            srv->name, g_list_length(actions), registered);
+
+    lst = actions;
+    while (lst){
+        SrnServerDeferredAction *action;
+
+        action = lst->data;
+        action->func(srv, registered, action->user_data);
+        if (!srn_server_is_valid(srv)){
+            break;
+        }
+        lst = g_list_next(lst);
+    }
+    g_list_free_full(actions, (GDestroyNotify)srn_server_deferred_action_free);
+}
+
+/**
+ * @brief srn_server_add_auto_join_chats creates chats in auto join list of
+ * server. It is called when the server first registered, so these chats are
+ * not built before they are useful.
+ *
+ * @param srv
+ */
+void srn_server_add_auto_join_chats(SrnServer *srv){
+    SrnRet ret;
+
     g_return_if_fail(srn_server_is_valid(srv));
 
-    /* Waiting for connection established */
-    while (srv->state == SRN_SERVER_STATE_CONNECTING) sui_proc_pending_event();
-    /* Waiting until server registered */
-    while (srv->state == SRN_SERVER_STATE_CONNECTED && srv->registered == FALSE)
-        sui_proc_pending_event();
+    if (srv->auto_joined){
+        return;
+    }
+    srv->auto_joined = TRUE;
+
+    for (GList *lst = srv->cfg->auto_join_chat_list;
+            lst;
+            lst = g_list_next(lst)){
+        const char *name;
+
+        name = lst->data;
+        if (srn_server_get_chat(srv, name)){
+            continue;
+        }
+        ret = srn_server_add_chat(srv, name);
+        // NOTE: The server may be invlid after running chat's auto run commands
+        if (!srn_server_is_valid(srv)){
+            return;
+        }
+        if (!RET_IS_OK(ret)){
+            srn_chat_add_error_message_fmt(srv->chat,
+                    _("Failed to add chat \"%1$s\": %2$s"),
+                    name, RET_MSG(ret));
+        }
+    }
+}
+
+/**
+ * @brief srn_server_join_chat joins channels on behalf of user. Unlike the
+ * channels joined by auto join or by bouncer, the buffers of these channels
+ * are activated once joined.
+ *
+ * @param srv
+ * @param chan is a comma-separated list of channels.
+ * @param passwd can be NULL.
+ *
+ * @return SRN_OK if JOIN message is sent.
+ */
+SrnRet srn_server_join_chat(SrnServer *srv, const char *chan, const char *passwd){
+    char **names;
+    SrnRet ret;
+
+    g_return_val_if_fail(srn_server_is_valid(srv), SRN_ERR);
+    g_return_val_if_fail(chan, SRN_ERR);
+
+    ret = sirc_cmd_join(srv->irc, chan, passwd);
+    if (!RET_IS_OK(ret)){
+        return ret;
+    }
+
+    names = g_strsplit(chan, ",", 0);
+    for (int i = 0; names[i]; i++){
+        if (strlen(names[i]) == 0){
+            continue;
+        }
+        srv->requested_chat_list = g_list_append(srv->requested_chat_list,
+                g_strdup(names[i]));
+    }
+    g_strfreev(names);
+
+    return ret;
+}
+
+/**
+ * @brief srn_server_pop_requested_chat checks whether the given channel is
+ * joined by srn_server_join_chat(), and forgets it.
+ *
+ * @param srv
+ * @param name
+ *
+ * @return TRUE if user has asked to join the channel.
+ */
+bool srn_server_pop_requested_chat(SrnServer *srv, const char *name){
+    for (GList *lst = srv->requested_chat_list; lst; lst = g_list_next(lst)){
+        if (g_ascii_strcasecmp(lst->data, name) == 0){
+            g_free(lst->data);
+            srv->requested_chat_list = g_list_delete_link(
+                    srv->requested_chat_list, lst);
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/**
+ * @brief srn_server_clear_requested_chats forgets all channels requested by
+ * srn_server_join_chat(), it should be called when the connection is lost.
+ *
+ * @param srv
+ */
+void srn_server_clear_requested_chats(SrnServer *srv){
+    g_list_free_full(srv->requested_chat_list, g_free);
+    srv->requested_chat_list = NULL;
 }
 
 SrnRet srn_server_add_chat(SrnServer *srv, const char *name){
@@ -315,15 +522,22 @@ SrnRet srn_server_rm_chat(SrnServer *srv, SrnChat *chat){
 }
 
 SrnChat* srn_server_get_chat(SrnServer *srv, const char *name) {
+    const char *fold;
     GList *lst;
     SrnChat *chat;
 
     g_return_val_if_fail(srn_server_is_valid(srv), NULL);
 
+    // Name of SrnChat is interned
+    fold = srn_intern_lookup_fold(name);
+    if (!fold){
+        return NULL;
+    }
+
     lst = srv->chat_list;
     while (lst) {
         chat = lst->data;
-        if (g_ascii_strcasecmp(chat->name, name) == 0){
+        if (srn_intern_get_fold(chat->name) == fold){
             return chat;
         }
         lst = g_list_next(lst);
@@ -366,8 +580,90 @@ SrnRet srn_server_add_user(SrnServer *srv, const char *nick){
         return SRN_ERR;
     }
     user = srn_server_user_new(srv, nick);
-    return g_hash_table_insert(srv->user_table, user->nick, user) ?
-        SRN_OK : SRN_ERR;
+    if (!g_hash_table_insert(srv->user_table, user->nick, user)) {
+        return SRN_ERR;
+    }
+    // User may never join any chat
+    srn_server_queue_user_gc(srv, user);
+
+    return SRN_OK;
+}
+
+/**
+ * @brief srn_server_queue_user_gc queues a user for the next garbage
+ * collection of server users. It should be called when the user may become
+ * useless, such as leaving a chat or quiting.
+ *
+ * @param srv
+ * @param user
+ */
+void srn_server_queue_user_gc(SrnServer *srv, SrnServerUser *user){
+    if (user->is_gc_queued || !srv->user_gc_queue) {
+        return;
+    }
+    user->is_gc_queued = TRUE;
+    g_queue_push_tail(srv->user_gc_queue, user);
+}
+
+/**
+ * @brief srn_server_collect_user frees server users which are queued by
+ * srn_server_queue_user_gc() and are not used by anyone. A user is freed if
+ * it has not joined any chat, it has no opened dialog, no message sent by it
+ * is kept and it has not sent any message recently.
+ *
+ * @param srv
+ * @param budget is the time limit of this collection, in microseconds. Users
+ * remaining in queue will be checked in the next collection.
+ */
+void srn_server_collect_user(SrnServer *srv, gint64 budget){
+    int n;
+    int evicted;
+    gint64 start;
+    gint64 now;
+
+    start = g_get_monotonic_time();
+    now = g_get_real_time();
+    evicted = 0;
+    n = g_queue_get_length(srv->user_gc_queue);
+
+    for (int i = 0; i < n; i++){
+        SrnServerUser *user;
+        SrnServerUserGcState state;
+
+        if (g_get_monotonic_time() - start > budget){
+            break;
+        }
+
+        user = g_queue_pop_head(srv->user_gc_queue);
+        user->is_gc_queued = FALSE;
+
+        state = get_user_gc_state(srv, user, now);
+        if (state == SRN_SERVER_USER_GC_STATE_IN_USE) {
+            // It will be queued again when it becomes useless
+            continue;
+        }
+        if (state == SRN_SERVER_USER_GC_STATE_RECENT) {
+            srn_server_queue_user_gc(srv, user);
+            continue;
+        }
+
+        while (user->chat_user_list){
+            SrnChatUser *chat_user;
+
+            chat_user = user->chat_user_list->data;
+            srn_chat_rm_user(chat_user->chat, chat_user);
+            // chat_user is detached from user here
+            srn_chat_user_free(chat_user);
+        }
+        srn_server_rm_user(srv, user);
+        evicted++;
+    }
+
+    DBG_FR("Server %s: %d users alive, %d users evicted, %d users queued, "
+            "took %" G_GINT64_FORMAT "us",
+            srv->name, g_hash_table_size(srv->user_table), evicted,
+            g_queue_get_length(srv->user_gc_queue),
+            g_get_monotonic_time() - start);
 }
 
 SrnServerUser* srn_server_get_user(SrnServer *srv, const char *nick){
@@ -380,6 +676,10 @@ SrnServerUser* srn_server_add_and_get_user(SrnServer *srv, const char *nick){
 }
 
 SrnRet srn_server_rm_user(SrnServer *srv, SrnServerUser *user){
+    if (user->is_gc_queued) {
+        g_queue_remove(srv->user_gc_queue, user);
+        user->is_gc_queued = FALSE;
+    }
     return g_hash_table_remove(srv->user_table, user->nick) ? SRN_OK : SRN_ERR;
 }
 
@@ -392,3 +692,55 @@ SrnRet srn_server_rename_user(SrnServer *srv, SrnServerUser *user,
     return g_hash_table_insert(srv->user_table, user->nick, user) ?
         SRN_OK : SRN_ERR;
 }
+
+static SrnServerUserGcState get_user_gc_state(SrnServer *srv,
+        SrnServerUser *user, gint64 now){
+    GList *lst;
+
+    if (user->is_me || user == srv->user || user == srv->_user) {
+        return SRN_SERVER_USER_GC_STATE_IN_USE;
+    }
+
+    lst = user->chat_user_list;
+    while (lst){
+        SrnChatUser *chat_user;
+
+        chat_user = lst->data;
+        if (chat_user->is_joined) {
+            return SRN_SERVER_USER_GC_STATE_IN_USE;
+        }
+        if (chat_user->chat->type == SRN_CHAT_TYPE_DIALOG) {
+            // Dialog may be closed later
+            return SRN_SERVER_USER_GC_STATE_RECENT;
+        }
+        /* Messages refer to their sender until they are freed, including
+         * the ones being rendered, deferred or shown. It is queued again
+         * when its last message is freed, see srn_message_free() */
+        if (chat_user->msg_count > 0) {
+            return SRN_SERVER_USER_GC_STATE_IN_USE;
+        }
+        lst = g_list_next(lst);
+    }
+
+    if (now - user->last_active < SRN_SERVER_USER_GC_IDLE * G_USEC_PER_SEC) {
+        return SRN_SERVER_USER_GC_STATE_RECENT;
+    }
+
+    return SRN_SERVER_USER_GC_STATE_FREE;
+}
+
+static gboolean user_gc_timeout(gpointer user_data){
+    SrnServer *srv;
+
+    srv = user_data;
+    srn_server_collect_user(srv, SRN_SERVER_USER_GC_BUDGET);
+
+    return G_SOURCE_CONTINUE;
+}
+
+static void srn_server_deferred_action_free(SrnServerDeferredAction *action){
+    if (action->destroy){
+        action->destroy(action->user_data);
+    }
+    g_free(action);
+}
@@ -0,0 +1,425 @@
+/* Copyright (C) 2016-2021 Shengyu Zhang <i@silverrainz.me>
+ *
+ * This file is part of Srain.
+ *
+ * Srain is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file server_netsplit.c
+ * @brief Netsplit and netjoin detection, QUITs and JOINs caused by the same
+ * netsplit are coalesced into one summary message per chat.
+ * @author Shengyu Zhang <i@silverrainz.me>
+ * @version 1.2.0
+ * @date 2021-03-01
+ */
+
+#include <string.h>
+#include <glib.h>
+
+#include "core/core.h"
+
+#include "log.h"
+#include "i18n.h"
+#include "utils.h"
+#include "intern.h"
+
+/* Max number of nicknames listed in summary message */
+#define MAX_SUMMARY_NICKS   20
+
+typedef struct _SrnNetsplitBatch SrnNetsplitBatch;
+typedef struct _SrnNetsplitQuit SrnNetsplitQuit;
+
+struct _SrnNetsplit {
+    SrnServer *srv;
+    char *servers; // "server1 server2", reason of QUIT message
+    GHashTable *quit_table; // Set of SrnNetsplitQuit, users and the chats
+                            // they quit from because of this netsplit
+
+    GHashTable *quit_batch_table; // SrnChat -> SrnNetsplitBatch
+    GHashTable *join_batch_table; // SrnChat -> SrnNetsplitBatch
+    int batch_timer;
+    int expire_timer;
+};
+
+struct _SrnNetsplitBatch {
+    SrnServer *srv;
+    SrnChat *chat;
+    int count;
+    GString *nicks;
+};
+
+/* A user has quit from a chat, it is forgotten once the user joins the chat
+ * again. Chat is identified by name as it may be freed during netsplit */
+struct _SrnNetsplitQuit {
+    const char *nick; // Interned
+    const char *chat; // Interned
+};
+
+static bool is_netsplit_reason(const char *reason);
+static bool is_server_name(const char *name, int len);
+static SrnNetsplit* srn_netsplit_new(SrnServer *srv, const char *servers);
+static void srn_netsplit_free(SrnNetsplit *self);
+static void srn_netsplit_add_to_batch(SrnNetsplit *self, GHashTable *table,
+        SrnChat *chat, const char *nick);
+static void srn_netsplit_flush(SrnNetsplit *self);
+static void srn_netsplit_batch_free(SrnNetsplitBatch *batch);
+static SrnNetsplitQuit* srn_netsplit_quit_new(const char *nick,
+        const char *chat);
+static void srn_netsplit_quit_free(SrnNetsplitQuit *quit);
+static guint srn_netsplit_quit_hash(gconstpointer key);
+static gboolean srn_netsplit_quit_equal(gconstpointer a, gconstpointer b);
+static gboolean batch_timeout(gpointer user_data);
+static gboolean expire_timeout(gpointer user_data);
+
+/**
+ * @brief srn_server_netsplit_quit handles the QUIT of given user if it is
+ * caused by a netsplit.
+ *
+ * @param srv
+ * @param user is the user who quits.
+ * @param reason is the reason of QUIT message.
+ *
+ * @return FALSE if the QUIT is not caused by netsplit, caller should handle
+ * it as an ordinary QUIT.
+ */
+bool srn_server_netsplit_quit(SrnServer *srv, SrnServerUser *user,
+        const char *reason){
+    GList *lst;
+    SrnNetsplit *split;
+
+    if (!is_netsplit_reason(reason)){
+        return FALSE;
+    }
+
+    split = NULL;
+    lst = srv->netsplit_list;
+    while (lst){
+        SrnNetsplit *tmp;
+
+        tmp = lst->data;
+        if (g_strcmp0(tmp->servers, reason) == 0){
+            split = tmp;
+            break;
+        }
+        lst = g_list_next(lst);
+    }
+    if (!split){
+        LOG_FR("Netsplit detected: %s", reason);
+        split = srn_netsplit_new(srv, reason);
+        srv->netsplit_list = g_list_prepend(srv->netsplit_list, split);
+    }
+
+    lst = user->chat_user_list;
+    while (lst){
+        SrnNetsplitQuit key;
+        SrnChatUser *chat_user;
+
+        chat_user = lst->data;
+        key.nick = user->nick;
+        key.chat = chat_user->chat->name;
+        if (!g_hash_table_contains(split->quit_table, &key)){
+            g_hash_table_add(split->quit_table,
+                    srn_netsplit_quit_new(key.nick, key.chat));
+        }
+        srn_netsplit_add_to_batch(split, split->quit_batch_table,
+                chat_user->chat, user->nick);
+        lst = g_list_next(lst);
+    }
+
+    /* User list of all related chat are frozen now */
+    srn_server_user_set_is_online(user, FALSE);
+
+    return TRUE;
+}
+
+/**
+ * @brief srn_server_netsplit_join handles the JOIN of given user if it is
+ * caused by a netjoin (the end of a netsplit), that is, the user has quit
+ * from the same chat because of a netsplit and not joined it since then.
+ *
+ * @param srv
+ * @param user is the user who joins.
+ * @param chat is the chat which user joins.
+ *
+ * @return FALSE if the JOIN is not caused by netjoin, caller should handle
+ * it as an ordinary JOIN.
+ */
+bool srn_server_netsplit_join(SrnServer *srv, SrnServerUser *user,
+        SrnChat *chat){
+    GList *lst;
+    SrnChatUser *chat_user;
+    SrnNetsplitQuit key;
+
+    key.nick = user->nick;
+    key.chat = chat->name;
+    lst = srv->netsplit_list;
+    while (lst){
+        SrnNetsplit *split;
+
+        split = lst->data;
+        // Later JOINs of the user to this chat are ordinary ones
+        if (g_hash_table_remove(split->quit_table, &key)){
+            srn_netsplit_add_to_batch(split, split->join_batch_table,
+                    chat, user->nick);
+
+            chat_user = srn_chat_add_and_get_user(chat, user);
+            // User may be already joined, for example, when user list of
+            // chat is refreshed by NAMES during the netsplit
+            if (!chat_user->is_joined){
+                srn_chat_user_set_is_joined(chat_user, TRUE);
+            }
+            return TRUE;
+        }
+        lst = g_list_next(lst);
+    }
+
+    return FALSE;
+}
+
+/**
+ * @brief srn_server_clear_netsplit flushes pending summary messages and
+ * forgets all netsplits of given server.
+ *
+ * @param srv
+ */
+void srn_server_clear_netsplit(SrnServer *srv){
+    g_list_free_full(srv->netsplit_list, (GDestroyNotify)srn_netsplit_free);
+    srv->netsplit_list = NULL;
+}
+
+/**
+ * @brief is_netsplit_reason checks whether the QUIT reason looks like
+ * "irc.example.org hub.example.net".
+ */
+static bool is_netsplit_reason(const char *reason){
+    const char *space;
+
+    if (!reason){
+        return FALSE;
+    }
+
+    space = strchr(reason, ' ');
+    if (!space || strchr(space + 1, ' ')){
+        return FALSE;
+    }
+    if (!is_server_name(reason, space - reason)
+            || !is_server_name(space + 1, strlen(space + 1))){
+        return FALSE;
+    }
+    // Two server names must be different
+    if (space - reason == strlen(space + 1)
+            && strncmp(reason, space + 1, space - reason) == 0){
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static bool is_server_name(const char *name, int len){
+    bool has_dot;
+
+    if (len <= 0 || name[0] == '.' || name[len - 1] == '.'){
+        return FALSE;
+    }
+
+    has_dot = FALSE;
+    for (int i = 0; i < len; i++){
+        if (name[i] == '.'){
+            if (name[i + 1] == '.'){
+                return FALSE;
+            }
+            has_dot = TRUE;
+        } else if (!g_ascii_isalnum(name[i])
+                && name[i] != '-' && name[i] != '*' && name[i] != '_'){
+            return FALSE;
+        }
+    }
+
+    return has_dot;
+}
+
+static SrnNetsplit* srn_netsplit_new(SrnServer *srv, const char *servers){
+    SrnNetsplit *self;
+
+    self = g_malloc0(sizeof(SrnNetsplit));
+    self->srv = srv;
+    str_assign(&self->servers, servers);
+    self->quit_table = g_hash_table_new_full(srn_netsplit_quit_hash,
+            srn_netsplit_quit_equal, (GDestroyNotify)srn_netsplit_quit_free,
+            NULL);
+    self->quit_batch_table = g_hash_table_new_full(g_direct_hash,
+            g_direct_equal, NULL, (GDestroyNotify)srn_netsplit_batch_free);
+    self->join_batch_table = g_hash_table_new_full(g_direct_hash,
+            g_direct_equal, NULL, (GDestroyNotify)srn_netsplit_batch_free);
+    self->expire_timer = srn_timer_wheel_add(
+            srn_application_get_default()->timer_wheel, "netsplit expire",
+            SRN_SERVER_NETSPLIT_TIMEOUT, expire_timeout, self);
+
+    return self;
+}
+
+static void srn_netsplit_free(SrnNetsplit *self){
+    srn_netsplit_flush(self);
+
+    if (self->expire_timer){
+        srn_timer_wheel_remove(srn_application_get_default()->timer_wheel,
+                self->expire_timer);
+        self->expire_timer = 0;
+    }
+
+    str_assign(&self->servers, NULL);
+    g_hash_table_destroy(self->quit_table);
+    g_hash_table_destroy(self->quit_batch_table);
+    g_hash_table_destroy(self->join_batch_table);
+
+    g_free(self);
+}
+
+static void srn_netsplit_add_to_batch(SrnNetsplit *self, GHashTable *table,
+        SrnChat *chat, const char *nick){
+    SrnNetsplitBatch *batch;
+
+    batch = g_hash_table_lookup(table, chat);
+    if (!batch){
+        batch = g_malloc0(sizeof(SrnNetsplitBatch));
+        batch->srv = self->srv;
+        batch->chat = chat;
+        batch->nicks = g_string_new(NULL);
+        g_hash_table_insert(table, chat, batch);
+
+        if (chat->type != SRN_CHAT_TYPE_SERVER){
+            sui_freeze_users(chat->ui);
+        }
+    }
+
+    if (batch->count < MAX_SUMMARY_NICKS){
+        if (batch->count){
+            g_string_append(batch->nicks, ", ");
+        }
+        g_string_append(batch->nicks, nick);
+    } else if (batch->count == MAX_SUMMARY_NICKS){
+        g_string_append(batch->nicks, ", ...");
+    }
+    batch->count++;
+
+    if (!self->batch_timer){
+        self->batch_timer = g_timeout_add(SRN_SERVER_NETSPLIT_BATCH_INTERVAL,
+                batch_timeout, self);
+    }
+}
+
+/**
+ * @brief srn_netsplit_flush posts summary messages of pending QUITs and JOINs
+ * and thaws the user lists.
+ */
+static void srn_netsplit_flush(SrnNetsplit *self){
+    GHashTableIter iter;
+    SrnNetsplitBatch *batch;
+
+    if (self->batch_timer){
+        g_source_remove(self->batch_timer);
+        self->batch_timer = 0;
+    }
+
+    g_hash_table_iter_init(&iter, self->quit_batch_table);
+    while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&batch)){
+        if (!srn_server_is_chat_valid(self->srv, batch->chat)){
+            continue;
+        }
+        srn_chat_add_misc_message_with_user_fmt(batch->chat, batch->chat->_user,
+                _("Netsplit %1$s, %2$d users have quit: %3$s"),
+                self->servers, batch->count, batch->nicks->str);
+    }
+
+    g_hash_table_iter_init(&iter, self->join_batch_table);
+    while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&batch)){
+        if (!srn_server_is_chat_valid(self->srv, batch->chat)){
+            continue;
+        }
+        srn_chat_add_misc_message_with_user_fmt(batch->chat, batch->chat->_user,
+                _("Netsplit %1$s is over, %2$d users have joined: %3$s"),
+                self->servers, batch->count, batch->nicks->str);
+    }
+
+    /* User lists are thawed when batches are freed */
+    g_hash_table_remove_all(self->quit_batch_table);
+    g_hash_table_remove_all(self->join_batch_table);
+}
+
+static void srn_netsplit_batch_free(SrnNetsplitBatch *batch){
+    // Chat may have been freed
+    if (srn_server_is_chat_valid(batch->srv, batch->chat)
+            && batch->chat->type != SRN_CHAT_TYPE_SERVER){
+        sui_thaw_users(batch->chat->ui);
+    }
+    g_string_free(batch->nicks, TRUE);
+    g_free(batch);
+}
+
+static SrnNetsplitQuit* srn_netsplit_quit_new(const char *nick,
+        const char *chat){
+    SrnNetsplitQuit *self;
+
+    self = g_malloc0(sizeof(SrnNetsplitQuit));
+    self->nick = srn_intern(nick);
+    self->chat = srn_intern(chat);
+
+    return self;
+}
+
+static void srn_netsplit_quit_free(SrnNetsplitQuit *quit){
+    srn_intern_unref(quit->nick);
+    srn_intern_unref(quit->chat);
+    g_free(quit);
+}
+
+static guint srn_netsplit_quit_hash(gconstpointer key){
+    const SrnNetsplitQuit *quit = key;
+
+    return g_str_hash(quit->nick) * 31 + g_str_hash(quit->chat);
+}
+
+static gboolean srn_netsplit_quit_equal(gconstpointer a, gconstpointer b){
+    const SrnNetsplitQuit *quit1 = a;
+    const SrnNetsplitQuit *quit2 = b;
+
+    return g_str_equal(quit1->nick, quit2->nick)
+        && g_str_equal(quit1->chat, quit2->chat);
+}
+
+static gboolean batch_timeout(gpointer user_data){
+    SrnNetsplit *self;
+
+    self = user_data;
+    self->batch_timer = 0;
+    srn_netsplit_flush(self);
+
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean expire_timeout(gpointer user_data){
+    SrnNetsplit *self;
+    SrnServer *srv;
+
+    self = user_data;
+    srv = self->srv;
+    self->expire_timer = 0;
+
+    DBG_FR("Netsplit %s expired", self->servers);
+    srv->netsplit_list = g_list_remove(srv->netsplit_list, self);
+    srn_netsplit_free(self);
+
+    return G_SOURCE_REMOVE;
+}
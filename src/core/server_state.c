@@ -37,6 +37,7 @@
 
 static const char *srn_server_state_to_string(SrnServerState state);
 static const char *srn_server_action_to_string(SrnServerAction action);
+static int add_reconnect_timer(SrnServer *srv);
 static gboolean srn_server_reconnect_timeout(gpointer user_data);
 static gboolean idle_to_rm_server(gpointer user_data);
 
@@ -93,8 +94,7 @@ SrnRet srn_server_state_transfrom(SrnServer *srv, SrnServerAction action){
                     ret = RET_ERR(unallowed, _("Hold on, srain is connecting to the server, please do not repeat the action"));
                     break;
                 case SRN_SERVER_ACTION_CONNECT_FAIL:
-                    srv->reconn_timer = g_timeout_add(srv->reconn_interval,
-                            srn_server_reconnect_timeout, srv);
+                    srv->reconn_timer = add_reconnect_timer(srv);
                     next_state = SRN_SERVER_STATE_RECONNECTING;
                     break;
                 case SRN_SERVER_ACTION_CONNECT_FINISH:
@@ -134,8 +134,7 @@ SrnRet srn_server_state_transfrom(SrnServer *srv, SrnServerAction action){
                     next_state = SRN_SERVER_STATE_QUITING;
                     break;
                 case SRN_SERVER_ACTION_DISCONNECT_FINISH:
-                    srv->reconn_timer = g_timeout_add(srv->reconn_interval,
-                            srn_server_reconnect_timeout, srv);
+                    srv->reconn_timer = add_reconnect_timer(srv);
                     next_state = SRN_SERVER_STATE_RECONNECTING;
                     break;
                 default:
@@ -200,12 +199,16 @@ SrnRet srn_server_state_transfrom(SrnServer *srv, SrnServerAction action){
                     next_state = SRN_SERVER_STATE_CONNECTING;
                     break;
                 case SRN_SERVER_ACTION_DISCONNECT:
-                    g_source_remove(srv->reconn_timer);
+                    srn_timer_wheel_remove(
+                            srn_application_get_default()->timer_wheel,
+                            srv->reconn_timer);
                     srv->reconn_timer = 0;
                     next_state = SRN_SERVER_STATE_DISCONNECTED;
                     break;
                 case SRN_SERVER_ACTION_QUIT:
-                    g_source_remove(srv->reconn_timer);
+                    srn_timer_wheel_remove(
+                            srn_application_get_default()->timer_wheel,
+                            srv->reconn_timer);
                     srv->reconn_timer = 0;
                     free = TRUE;
                     next_state = SRN_SERVER_STATE_DISCONNECTED;
@@ -229,6 +232,13 @@ SrnRet srn_server_state_transfrom(SrnServer *srv, SrnServerAction action){
                 srn_server_state_to_string(next_state));
         srv->state = next_state;
         srv->last_action = action;
+
+        // Registration can not happen before next connection, fail all
+        // actions that wait for it
+        if (next_state != SRN_SERVER_STATE_CONNECTING
+                && next_state != SRN_SERVER_STATE_CONNECTED){
+            srn_server_finish_deferred_actions(srv);
+        }
     } else {
         WARN_FR("Server %s: %s + %s -> error: %s",
                 srv->name,
@@ -291,10 +301,17 @@ static const char *srn_server_action_to_string(SrnServerAction action){
     }
 }
 
+static int add_reconnect_timer(SrnServer *srv){
+    return srn_timer_wheel_add(srn_application_get_default()->timer_wheel,
+            "reconnect", srv->reconn_interval,
+            srn_server_reconnect_timeout, srv);
+}
+
 static gboolean srn_server_reconnect_timeout(gpointer user_data){
     SrnServer *srv;
 
     srv = user_data;
+    srv->reconn_timer = 0;
     srv->reconn_interval += SRN_SERVER_RECONN_STEP;
     srn_server_state_transfrom(srv, SRN_SERVER_ACTION_CONNECT);
 
@@ -21,6 +21,7 @@
 
 #include "log.h"
 #include "utils.h"
+#include "intern.h"
 
 static void srn_server_user_update_chat_user(SrnServerUser *self);
 
@@ -32,7 +33,7 @@ SrnServerUser *srn_server_user_new(SrnServer *srv, const char *nick){
     self = g_malloc0(sizeof(SrnServerUser));
     self->srv = srv;
     self->is_ignored = FALSE;
-    str_assign(&self->nick, nick);
+    srn_intern_assign(&self->nick, nick);
     self->extra_data = srn_extra_data_new();
 
     return self;
@@ -41,9 +42,9 @@ SrnServerUser *srn_server_user_new(SrnServer *srv, const char *nick){
 void srn_server_user_free(SrnServerUser *self){
     g_return_if_fail(g_list_length(self->chat_user_list) == 0);
 
-    str_assign(&self->nick, NULL);
-    str_assign(&self->username, NULL);
-    str_assign(&self->hostname, NULL);
+    srn_intern_assign(&self->nick, NULL);
+    srn_intern_assign(&self->username, NULL);
+    srn_intern_assign(&self->hostname, NULL);
     str_assign(&self->realname, NULL);
     srn_extra_data_free(self->extra_data);
     g_free(self);
@@ -80,17 +81,17 @@ SrnRet srn_server_user_detach_chat_user(SrnServerUser *self, SrnChatUser *chat_u
 }
 
 void srn_server_user_set_nick(SrnServerUser *self, const char *nick){
-    str_assign(&self->nick, nick);
+    srn_intern_assign(&self->nick, nick);
     srn_server_user_update_chat_user(self);
 }
 
 void srn_server_user_set_username(SrnServerUser *self, const char *username){
-    str_assign(&self->username, username);
+    srn_intern_assign(&self->username, username);
     srn_server_user_update_chat_user(self);
 }
 
 void srn_server_user_set_hostname(SrnServerUser *self, const char *hostname){
-    str_assign(&self->hostname, hostname);
+    srn_intern_assign(&self->hostname, hostname);
     srn_server_user_update_chat_user(self);
 }
 
@@ -112,6 +113,8 @@ void srn_server_user_set_is_online(SrnServerUser *self, bool online){
     if (!self->is_online){
         GList *lst;
 
+        srn_server_queue_user_gc(self->srv, self);
+
         lst = self->chat_user_list;
         while (lst) {
             SrnChatUser *chat_user;
@@ -55,6 +55,7 @@ int main(int argc, char *argv[]){
     app = srn_application_new();
     srn_application_run(app, argc, argv);
 
+    srn_chat_snapshot_finalize();
     srn_render_finalize();
     srn_filter_finalize();
     srn_logger_free(logger);
@@ -52,12 +52,17 @@ bool filter(const SrnMessage *msg) {
     FILE *fp;
     char *file;
     GString *basename;
+    GDateTime *time;
 
-    date_str = g_date_time_format(msg->time, "%F");
+    time = srn_message_get_date_time(msg);
+    g_return_val_if_fail(time, TRUE);
+    date_str = g_date_time_format(time, "%F");
+    g_date_time_unref(time);
     g_return_val_if_fail(date_str, TRUE);
 
     basename = g_string_new("");
     g_string_append_printf(basename, "%s.%s.log", date_str, msg->chat->name);
+    g_free(date_str);
     file = srn_create_log_file(msg->chat->srv->name, basename->str);
 
     if (!file){
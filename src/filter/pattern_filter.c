@@ -17,7 +17,6 @@
  */
 
 #include "core/core.h"
-#include "markup_renderer.h"
 #include "pattern_set.h"
 
 #include "./filter2.h"
@@ -27,13 +26,11 @@
 static void init(void);
 static void finalize(void);
 static bool filter(const SrnMessage *msg);
-static GList** alloc_patterns();
-static void free_patterns(GList **patterns);
-static GList* get_patterns(const SrnMessage *msg);
-static void text(GMarkupParseContext *context, const gchar *text,
-        gsize text_len, gpointer user_data, GError **error);
+static void free_patterns(SrnPatternList *patterns);
 
-static SrnMarkupRenderer *markup_renderer;
+/* Number of patterns attached to all extra datas, message is not touched
+ * when it is 0 */
+static int npattern;
 
 /**
  * @brief pattern_filter is a filter module for filtering message which matches
@@ -47,58 +44,49 @@ SrnMessageFilter pattern_filter = {
 };
 
 void init(void) {
-    GMarkupParser *parser;
-
-    markup_renderer = srn_markup_renderer_new();
-    parser = srn_markup_renderer_get_markup_parser(markup_renderer);
-    parser->start_element = NULL;
-    parser->end_element = NULL;
-    parser->text = text;
 }
 
 void finalize(void) {
-    srn_markup_renderer_free(markup_renderer);
 }
 
 static bool filter(const SrnMessage *msg) {
-    bool drop;
-    char *raw_content;
-    GList *patterns;
-    GList *lst;
-    SrnRet ret;
-    SrnPatternSet *pattern_set;
+    const char *content;
+    SrnExtraData *datas[4];
 
-    pattern_set = srn_application_get_default()->pattern_set;
-    g_return_val_if_fail(pattern_set, TRUE);
-
-    raw_content = NULL;
-    ret = srn_markup_renderer_render(markup_renderer,
-            msg->rendered_content, &raw_content, NULL);
-    if (!RET_IS_OK(ret)){
-        ERR_FR("Failed to render markup text: %1$s", RET_MSG(ret));
+    if (npattern == 0) {
         return TRUE;
     }
 
-    drop = FALSE;
-    patterns = get_patterns(msg);
-    lst = patterns;
-    while (lst) {
-        const char *pattern;
-        const GRegex *regex;
-
-        pattern = lst->data;
-        regex = srn_pattern_set_get(pattern_set, pattern);
-        if (regex && g_regex_match(regex, raw_content, 0, NULL)) {
-            drop = TRUE;
-            break;
+    datas[0] = msg->sender->extra_data;
+    datas[1] = msg->sender->srv_user->extra_data;
+    datas[2] = msg->chat->extra_data;
+    // Patterns of server chat are not applied twice
+    datas[3] = msg->chat != msg->chat->srv->chat
+        ? msg->chat->srv->chat->extra_data : NULL;
+
+    // Plain text is extracted by renderer, no need to parse markup
+    content = srn_message_get_plain_content(msg);
+    for (int i = 0; i < G_N_ELEMENTS(datas); i++) {
+        GPtrArray *regexes;
+        SrnPatternList *patterns;
+
+        if (!datas[i]) {
+            continue;
+        }
+        patterns = srn_extra_data_get(datas[i], PATTERNS_KEY);
+        if (!patterns) {
+            continue;
         }
-        lst = g_list_next(lst);
-    }
 
-    g_list_free(patterns);
-    g_free(raw_content);
+        regexes = srn_pattern_list_get_regexes(patterns);
+        for (int j = 0; j < regexes->len; j++) {
+            if (g_regex_match(g_ptr_array_index(regexes, j), content, 0, NULL)) {
+                return FALSE;
+            }
+        }
+    }
 
-    return !drop;
+    return TRUE;
 }
 
 /**
@@ -112,27 +100,23 @@ static bool filter(const SrnMessage *msg) {
  * @return
  */
 SrnRet srn_filter_attach_pattern(SrnExtraData *extra_data, const char *pattern){
-    GList **patterns;
-    GList *lst;
+    SrnRet ret;
+    SrnPatternList *patterns;
 
     patterns = srn_extra_data_get(extra_data, PATTERNS_KEY);
     if (!patterns) {
-        patterns = alloc_patterns();
+        patterns = srn_pattern_list_new(
+                srn_application_get_default()->pattern_set);
         srn_extra_data_set(extra_data, PATTERNS_KEY, patterns,
                 (GDestroyNotify)free_patterns);
     }
 
-    lst = *patterns;
-    while (lst) {
-        if (g_strcasecmp(lst->data, pattern) == 0) {
-            return SRN_ERR;
-        }
-        lst = g_list_next(lst);
+    ret = srn_pattern_list_add(patterns, pattern);
+    if (RET_IS_OK(ret)) {
+        npattern++;
     }
 
-    *patterns = g_list_append(*patterns, g_strdup(pattern));
-
-    return SRN_OK;
+    return ret;
 }
 
 /**
@@ -144,78 +128,21 @@ SrnRet srn_filter_attach_pattern(SrnExtraData *extra_data, const char *pattern){
  * @return
  */
 SrnRet srn_filter_detach_pattern(SrnExtraData *extra_data, const char *pattern){
-    GList **patterns;
-    GList *lst;
+    SrnRet ret;
+    SrnPatternList *patterns;
 
     patterns = srn_extra_data_get(extra_data, PATTERNS_KEY);
     g_return_val_if_fail(patterns, SRN_OK);
 
-    lst = *patterns;
-    while (lst) {
-        if (g_strcasecmp(lst->data, pattern) == 0) {
-            break;
-        }
-        lst = g_list_next(lst);
+    ret = srn_pattern_list_rm(patterns, pattern);
+    if (RET_IS_OK(ret)) {
+        npattern--;
     }
-    if (!lst) {
-        return SRN_ERR;
-    }
-
-    g_free(lst->data);
-    *patterns = g_list_delete_link(*patterns, lst);
-
-    return SRN_OK;
-}
-
-static GList** alloc_patterns()  {
-    return g_malloc0(sizeof(GList **));
-}
-
-static void free_patterns(GList **patterns){
-    if (patterns) {
-        if (*patterns) {
-            g_list_free_full(*patterns, g_free);
-        }
-        g_free(patterns);
-    }
-}
-
-/**
- * @brief get_patterns
- *
- * @return a list which contains const string, should be freed by g_list_free();
- */
-static GList* get_patterns(const SrnMessage *msg) {
-    GList *iter;
-    GList *datas; // List of SrnExtraData
-    GList *patterns;
-
-    datas = NULL;
-    datas = g_list_append(datas, msg->sender->extra_data);
-    datas = g_list_append(datas, msg->sender->srv_user->extra_data);
-    datas = g_list_append(datas, msg->chat->extra_data);
-    datas = g_list_append(datas, msg->chat->srv->chat->extra_data);
-
-    patterns = NULL;
-    iter = datas;
-    while (iter) {
-        SrnExtraData *data;
-        GList **lp;
-
-        data = iter->data;
-        lp = srn_extra_data_get(data, PATTERNS_KEY);
-        if (lp && *lp) {
-            patterns = g_list_concat(patterns, g_list_copy(*lp));
-        }
-        iter = g_list_next(iter);
-    }
-
-    g_list_free(g_list_first(datas));
 
-    return patterns;
+    return ret;
 }
 
-static void text(GMarkupParseContext *context, const gchar *text,
-        gsize text_len, gpointer user_data, GError **error){
-    g_string_append_len(srn_markup_renderer_get_markup(user_data), text, text_len);
+static void free_patterns(SrnPatternList *patterns){
+    npattern -= srn_pattern_list_get_length(patterns);
+    srn_pattern_list_free(patterns);
 }
@@ -26,11 +26,18 @@
 #include "version.h"
 
 typedef struct _SrnConfigManager SrnConfigManager;
+typedef struct _SrnConfigIndex SrnConfigIndex;
 
 struct _SrnConfigManager {
     SrnVersion *ver; // Compatible version
     config_t user_cfg;
     config_t system_cfg;
+    SrnConfigIndex *user_index;
+    SrnConfigIndex *system_index;
+
+    GHashTable *secret_cache; // Cached passwords, NULL value for no password
+    GHashTable *secret_pending_table; // Keys of on-going asynchronous lookups
+    GCancellable *secret_cancellable;
     SecretSchema *srv_secret_schema;
     SecretSchema *chan_secret_schema;
     SecretSchema *user_secret_schema;
@@ -24,7 +24,7 @@
 #include "core/core.h"
 #include "config.h"
 
-/* Synchronous password management functions */
+/* Synchronous password management functions, looked up passwords are cached */
 
 SrnRet srn_config_manager_lookup_server_password(SrnConfigManager *mgr, char **passwd, const char *srv_name);
 SrnRet srn_config_manager_store_server_password(SrnConfigManager *mgr, const char *passwd, const char *srv_name);
@@ -36,7 +36,13 @@ SrnRet srn_config_manager_lookup_user_password(SrnConfigManager *mgr, char **pas
 SrnRet srn_config_manager_store_user_password(SrnConfigManager *mgr, const char *passwd, const char *srv_name, const char *user_name);
 SrnRet srn_config_manager_clear_user_password(SrnConfigManager *mgr, const char *srv_name, const char *user_name);
 
-/* For asynchronous password management, please use libsecret interfaces with
+/* Asynchronous and cached password lookup */
+
+typedef void (*SrnConfigPasswordCallback) (SrnConfigManager *mgr, const char *passwd, gpointer user_data);
+
+bool srn_config_manager_lookup_channel_password_async(SrnConfigManager *mgr, char **passwd, const char *srv_name, const char *chan_name, SrnConfigPasswordCallback callback, gpointer user_data, GDestroyNotify destroy);
+
+/* For other asynchronous password management, please use libsecret interfaces with
  * the following secret schemas and attributes */
 
 #define SRN_CONFIG_SECRET_SCHEMA_ATTR_SERVER    "server"
@@ -27,6 +27,7 @@
 #include "version.h"
 #include "log.h"
 #include "pattern_set.h"
+#include "timer_wheel.h"
 #include "command.h"
 
 #ifndef __IN_CORE_H
@@ -58,7 +59,13 @@ struct _SrnApplication {
     GList *srv_list;
 
     SrnPatternSet *pattern_set;
+    SrnTimerWheel *timer_wheel; // Coarse timers of all servers and chats
     SrnCommandContext *cmd_ctx;
+
+    /* Startup */
+    gint64 startup_time;        // Monotonic time when application starts, in us
+    GList *auto_connect_list;   // Names of servers waiting for auto connect
+    int auto_connect_idle;
 };
 
 struct _SrnApplicationConfig {
@@ -78,6 +85,7 @@ SrnRet srn_application_open_url(SrnApplication *app, const char *url);
 void srn_application_set_config(SrnApplication *app, SrnApplicationConfig *cfg);
 SrnRet srn_application_reload_config(SrnApplication *app);
 void srn_application_auto_connect_server(SrnApplication *app);
+void srn_application_log_startup_phase(SrnApplication *app, const char *phase);
 
 // Server
 SrnRet srn_application_add_server(SrnApplication *app, const char *name);
@@ -30,8 +30,21 @@
 	#error This file should not be included directly, include just core.h
 #endif
 
+/* Max number of messages kept in scrollback snapshot of chat */
+#define SRN_CHAT_SNAPSHOT_SIZE  500
+
+/* Identical messages sent by the same user in this interval (in
+ * microseconds) are collapsed into one */
+#define SRN_CHAT_REPEAT_INTERVAL    (60 * G_USEC_PER_SEC)
+
+/* Interval of summary of hidden presence changes, in seconds */
+#define SRN_CHAT_PRESENCE_SUMMARY_INTERVAL  60
+
 typedef struct _SrnChat SrnChat;
+typedef struct _SrnChatSnapshot SrnChatSnapshot;
 typedef enum   _SrnChatType SrnChatType;
+typedef enum   _SrnChatPriority SrnChatPriority;
+typedef enum   _SrnChatPresence SrnChatPresence;
 typedef struct _SrnChatConfig SrnChatConfig;
 typedef struct _SrnChatUser SrnChatUser;
 typedef enum   _SrnChatUserType SrnChatUserType;
@@ -45,18 +58,41 @@ enum _SrnChatType {
     SRN_CHAT_TYPE_DIALOG,
 };
 
+enum _SrnChatPriority {
+    SRN_CHAT_PRIORITY_NORMAL,
+    SRN_CHAT_PRIORITY_LOW,      // Messages are rendered lazily, no unread count
+    SRN_CHAT_PRIORITY_LOG_ONLY, // Messages are only written to log
+    SRN_CHAT_PRIORITY_UNKNOWN,
+};
+
+/* Membership changes of chat user, see chat_presence.c */
+enum _SrnChatPresence {
+    SRN_CHAT_PRESENCE_JOIN,
+    SRN_CHAT_PRESENCE_PART,
+    SRN_CHAT_PRESENCE_QUIT,
+    SRN_CHAT_PRESENCE_NICK,
+    SRN_CHAT_PRESENCE_MAX,
+};
+
 /* Represent a channel or dialog or a server session */
 struct _SrnChat {
     char *name;
     SrnChatType type;
+    SrnChatPriority priority; // Promoted to normal once chat is shown
     bool is_joined;
 
     SrnChatUser *user;  // Yourself
     SrnChatUser *_user; // Hold all messages that do not belong other any user
     GList *user_list;  // List of SrnChatUser
 
-    GList *msg_list;
-    SrnMessage *last_msg;
+    GList *msg_list; // List of SrnMessage, latest message first
+    GList *deferred_msg_list; // Messages not yet rendered, latest message first
+    SrnMessage *last_msg; // Latest message, NULL if its sender is freed
+    SrnChatSnapshot *snapshot; // Scrollback snapshot, NULL for server chat
+
+    /* Presence changes of inactive users, see chat_presence.c */
+    int hidden_presence[SRN_CHAT_PRESENCE_MAX];
+    int presence_timer;
 
     /* Used by Filters & Decorators */
     GList *ignore_regex_list;
@@ -67,13 +103,19 @@ struct _SrnChat {
     SrnChatConfig *cfg;
 
     SrnExtraData *extra_data;
+    struct _SrnRenderQueue *render_queue; // Messages being rendered
 };
 
 struct _SrnChatConfig {
     bool log; // TODO
+    bool snapshot; // Keep recent messages across restarts, requires log
     bool render_mirc_color;
+    SrnChatPriority priority;
+    int presence_window; // In seconds, 0 for showing all presence changes
     char *password;
     GList *auto_run_cmd_list;
+    GList *highlight_list; // Words highlighted like our nick
+    GList *never_highlight_list; // Words never highlighted
 
     SuiBufferConfig *ui;
 };
@@ -98,6 +140,8 @@ struct _SrnChatUser{
     SrnChatUserType type;
     SrnServerUser *srv_user;
     GList *msg_list;    // TODO: List of SrnMessage
+    gint64 last_active; // Time of last message sent in this chat, in us
+    int msg_count;      // Number of messages whose sender is this user
 
     SuiUser *ui;
 
@@ -127,10 +171,25 @@ void srn_chat_add_error_message_with_user(SrnChat *chat, SrnChatUser *user, cons
 void srn_chat_add_error_message_with_user_fmt(SrnChat *chat, SrnChatUser *user, const char *fmt, ...);
 void srn_chat_set_topic(SrnChat *chat, SrnChatUser *user, const char *topic);
 void srn_chat_set_topic_setter(SrnChat *chat, const char *setter);
+bool srn_chat_is_visible(SrnChat *chat);
+void srn_chat_set_priority(SrnChat *chat, SrnChatPriority priority);
+void srn_chat_flush_deferred_messages(SrnChat *chat);
+
+void srn_chat_open_snapshot(SrnChat *chat);
+void srn_chat_close_snapshot(SrnChat *chat);
+void srn_chat_flush_snapshot(SrnChat *chat);
+void srn_chat_snapshot_finalize(void);
+void srn_chat_save_snapshot_message(SrnChat *chat, SrnMessage *msg, int rflags);
+void srn_chat_rehydrate_snapshot(SrnChat *chat);
+
+bool srn_chat_hide_presence(SrnChat *chat, SrnChatUser *user, SrnChatPresence presence);
+void srn_chat_clear_hidden_presence(SrnChat *chat);
 
 SrnChatConfig *srn_chat_config_new();
 void srn_chat_config_free(SrnChatConfig *cfg);
 SrnRet srn_chat_config_check(SrnChatConfig *cfg);
+const char* srn_chat_priority_to_string(SrnChatPriority priority);
+SrnChatPriority srn_chat_priority_from_string(const char *str);
 
 SrnChatUser *srn_chat_user_new(SrnChat *chat, SrnServerUser *srv_user);
 void srn_chat_user_free(SrnChatUser *self);
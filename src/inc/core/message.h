@@ -29,6 +29,7 @@ typedef enum _SrnMessageType SrnMessageType;
 typedef struct _SrnMessage SrnMessage;
 
 #include "./chat.h"
+#include "render/render_span.h"
 
 enum _SrnMessageType {
     SRN_MESSAGE_TYPE_UNKNOWN,
@@ -44,26 +45,48 @@ struct _SrnMessage {
     SrnChat *chat;
     SrnChatUser *sender; // Sender of this message
     SrnMessageType type;
+    bool mentioned; // Whether this message should be mentioned
 
     /* Raw message */
-    char *content;  // Raw message content
-    GDateTime *time; // Local time when creating message
+    char *content;  // Raw message content, head of the message arena
+    gint64 time; // Wall-clock time when creating message, in microseconds
 
-    /* NOTE: All rendered_xxx fields MUST be valid XML and never be NULL */
-    char *rendered_sender; // Sender name
-    char *rendered_remark; // Message remark
-    char *rendered_content; // Rendered message content in
-    char *rendered_short_time; // Short format message time
-    char *rendered_full_time;  // Full format messsage time
+    /* NOTE: All rendered_xxx fields MUST be valid XML and never be NULL,
+     * except rendered_time, which is NULL unless some renderer overrides the
+     * message time. Use srn_message_set_rendered_xxx() to modify them. */
+    const char *rendered_sender; // Sender name, see intern.h
+    const char *rendered_remark; // Message remark, see intern.h
+    char *rendered_content; // Rendered message content, may lives in arena
+    char *rendered_time; // Overridden short format message time
     GList *urls; // URLs in message, like "http://xxx", "irc://xxx"
+    char *plain_content; // Plain text of rendered_content, NULL if it is the
+                         // same as raw content
+    GArray *rendered_spans; // Array of SrnRenderSpan over plain content,
+                            // NULL if message is not rendered
+    int rendered_flags; // SrnRenderFlags already applied to rendered_xxx
+    int render_flags; // SrnRenderFlags requested, the ones not in
+                      // rendered_flags are still to be applied
+    int filter_flags; // SrnFilterFlags applied once the message is rendered
+    int repeat_count; // Number of identical messages collapsed into this one
+    gint64 repeat_time; // Time of the latest collapsed message
 
-    bool mentioned; // Whether this message should be mentioned
-
-    SuiMessage *ui;
+    SuiMessage *ui; // NULL until srn_message_init_ui() is called
 };
 
 SrnMessage* srn_message_new(SrnChat *chat, SrnChatUser *user, const char *content, SrnMessageType type);
 void srn_message_free(SrnMessage *msg);
+void srn_message_init_ui(SrnMessage *self);
+void srn_message_reset_rendered(SrnMessage *self);
 char* srn_message_to_string(const SrnMessage *self);
+void srn_message_set_rendered_sender(SrnMessage *self, const char *sender);
+void srn_message_set_rendered_remark(SrnMessage *self, const char *remark);
+void srn_message_set_rendered_content(SrnMessage *self, char *content);
+void srn_message_set_rendered_time(SrnMessage *self, const char *time);
+void srn_message_set_plain_content(SrnMessage *self, const char *content);
+const char* srn_message_get_plain_content(const SrnMessage *self);
+void srn_message_set_rendered_spans(SrnMessage *self, GArray *spans);
+const char* srn_message_get_short_time(const SrnMessage *self);
+char* srn_message_get_full_time(const SrnMessage *self);
+GDateTime* srn_message_get_date_time(const SrnMessage *self);
 
 #endif /* __MESSAGE_H */
@@ -35,6 +35,15 @@
 #define SRN_SERVER_PING_TIMEOUT     (SRN_SERVER_PING_INTERVAL * 2)
 #define SRN_SERVER_RECONN_INTERVAL  (5 * 1000)
 #define SRN_SERVER_RECONN_STEP      SRN_SERVER_RECONN_INTERVAL
+#define SRN_SERVER_NETSPLIT_BATCH_INTERVAL  (1 * 1000)
+#define SRN_SERVER_NETSPLIT_TIMEOUT         (15 * 60 * 1000)
+
+/* In seconds */
+#define SRN_SERVER_USER_GC_INTERVAL 60
+#define SRN_SERVER_USER_GC_IDLE     (10 * 60)   // Users sent message in this
+                                                // period are not collected
+/* In microseconds */
+#define SRN_SERVER_USER_GC_BUDGET   (2 * 1000)
 
 typedef struct _SrnServerUser SrnServerUser;
 typedef struct _SrnServerAddr SrnServerAddr;
@@ -47,6 +56,9 @@ typedef struct _SrnUserConfig SrnUserConfig;
 typedef struct _SrnServerConfig SrnServerConfig;
 typedef struct _EnabledCap EnabledCap;
 typedef struct _SrnServerCap SrnServerCap;
+typedef struct _SrnNetsplit SrnNetsplit;
+typedef void (*SrnServerRegisteredFunc) (SrnServer *srv, bool registered,
+        gpointer user_data);
 
 #include "chat.h"
 
@@ -68,6 +80,8 @@ struct _SrnServerUser {
     bool is_secure;
 
     GList *chat_user_list;  // List of SrnChatUser
+    gint64 last_active;     // Time of last message sent by user, in us
+    bool is_gc_queued;      // Whether in SrnServer->user_gc_queue
 
     SrnExtraData *extra_data;
 };
@@ -103,6 +117,7 @@ struct _SrnServer {
     bool negotiated;    // Client capability negotiation has finished
     bool registered;    // User has a nickname
     bool loggedin;      // User has identified as a certain account
+    bool auto_joined;   // Chats in auto join list have been created
 
     /* Keep alive */
     unsigned long last_pong;        // Last pong time, in ms
@@ -118,7 +133,13 @@ struct _SrnServer {
     SrnChat *chat;          // Hold all messages that do not belong to any other SrnChat
     SrnChat *cur_chat;
     GList *chat_list;      // List of SrnChat
+    GList *requested_chat_list; // Names of channels that user asks to join,
+                                // their buffers are activated once joined
     GHashTable *user_table; // Hash table of SrnServerUser
+    GQueue *user_gc_queue;  // Queue of SrnServerUser which may be useless
+    int user_gc_timer;
+    GList *netsplit_list;   // List of SrnNetsplit
+    GList *deferred_action_list;    // Actions waiting for registration
 
     SircSession *irc; // IRC session
 };
@@ -210,8 +231,13 @@ SrnRet srn_server_disconnect(SrnServer *srv);
 SrnRet srn_server_reconnect(SrnServer *srv);
 SrnRet srn_server_state_transfrom(SrnServer *srv, SrnServerAction act);
 bool srn_server_is_registered(SrnServer *srv);
-void srn_server_wait_until_registered(SrnServer *srv);
+void srn_server_run_when_registered(SrnServer *srv, SrnServerRegisteredFunc func, gpointer user_data, GDestroyNotify destroy);
+void srn_server_finish_deferred_actions(SrnServer *srv);
 int srn_server_add_chat(SrnServer *srv, const char *name);
+void srn_server_add_auto_join_chats(SrnServer *srv);
+SrnRet srn_server_join_chat(SrnServer *srv, const char *chan, const char *passwd);
+bool srn_server_pop_requested_chat(SrnServer *srv, const char *name);
+void srn_server_clear_requested_chats(SrnServer *srv);
 SrnRet srn_server_rm_chat(SrnServer *srv, SrnChat *chat);
 SrnChat* srn_server_get_chat(SrnServer *srv, const char *name);
 SrnChat* srn_server_get_chat_fallback(SrnServer *srv, const char *name);
@@ -221,6 +247,11 @@ SrnRet srn_server_rm_user(SrnServer *srv, SrnServerUser *user);
 SrnServerUser* srn_server_get_user(SrnServer *srv, const char *nick);
 SrnServerUser* srn_server_add_and_get_user(SrnServer *srv, const char *nick);
 SrnRet srn_server_rename_user(SrnServer *srv, SrnServerUser *user, const char *nick);
+void srn_server_queue_user_gc(SrnServer *srv, SrnServerUser *user);
+void srn_server_collect_user(SrnServer *srv, gint64 budget);
+bool srn_server_netsplit_quit(SrnServer *srv, SrnServerUser *user, const char *reason);
+bool srn_server_netsplit_join(SrnServer *srv, SrnServerUser *user, SrnChat *chat);
+void srn_server_clear_netsplit(SrnServer *srv);
 
 SrnServerUser *srn_server_user_new(SrnServer *srv, const char *nick);
 SrnServerUser *srn_server_user_ref(SrnServerUser *user);
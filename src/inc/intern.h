@@ -0,0 +1,40 @@
+/* Copyright (C) 2016-2021 Shengyu Zhang <i@silverrainz.me>
+ *
+ * This file is part of Srain.
+ *
+ * Srain is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/**
+ * @file intern.h
+ * @brief Process-wide refcounted string pool.
+ * @author Shengyu Zhang <i@silverrainz.me>
+ * @version 1.2.0
+ * @date 2021-03-02
+ */
+
+#ifndef __INTERN_H
+#define __INTERN_H
+
+#include <glib.h>
+#include "srain.h"
+
+const char* srn_intern(const char *str);
+void srn_intern_unref(const char *istr);
+void srn_intern_assign(char **left, const char *right);
+const char* srn_intern_lookup(const char *str);
+const char* srn_intern_lookup_fold(const char *str);
+const char* srn_intern_get_fold(const char *istr);
+bool srn_intern_equal(const char *istr1, const char *istr2);
+
+#endif /* __INTERN_H */
@@ -0,0 +1,56 @@
+/* Copyright (C) 2016-2021 Shengyu Zhang <i@silverrainz.me>
+ *
+ * This file is part of Srain.
+ *
+ * Srain is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file keyword_matcher.h
+ * @brief Match a set of keywords as whole words in one pass.
+ * @author Shengyu Zhang <i@silverrainz.me>
+ * @version 1.2.0
+ * @date 2021-03-15
+ */
+
+#ifndef __KEYWORD_MATCHER_H
+#define __KEYWORD_MATCHER_H
+
+#include <glib.h>
+#include "srain.h"
+
+typedef struct _SrnKeywordMatcher SrnKeywordMatcher;
+
+/**
+ * @brief SrnKeywordMatchFunc is called for every keyword found in text.
+ *
+ * @param start is the byte offset where keyword starts, inclusive.
+ * @param end is the byte offset where keyword ends, exclusive.
+ * @param tag is the tag given when adding keyword.
+ * @param user_data
+ */
+typedef void (*SrnKeywordMatchFunc) (int start, int end, int tag,
+        gpointer user_data);
+
+SrnKeywordMatcher* srn_keyword_matcher_new(void);
+void srn_keyword_matcher_free(SrnKeywordMatcher *self);
+
+void srn_keyword_matcher_add(SrnKeywordMatcher *self, const char *keyword,
+        int tag);
+bool srn_keyword_matcher_is_empty(SrnKeywordMatcher *self);
+void srn_keyword_matcher_compile(SrnKeywordMatcher *self);
+int srn_keyword_matcher_match(SrnKeywordMatcher *self, const char *text,
+        int len, SrnKeywordMatchFunc func, gpointer user_data);
+
+#endif /* __KEYWORD_MATCHER_H */
@@ -0,0 +1,37 @@
+/* Copyright (C) 2016-2021 Shengyu Zhang <i@silverrainz.me>
+ *
+ * This file is part of Srain.
+ *
+ * Srain is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file markup_escape.h
+ * @brief Fast markup escaping for hot render paths.
+ * @author Shengyu Zhang <i@silverrainz.me>
+ * @version 1.2.0
+ * @date 2021-03-17
+ */
+
+#ifndef __MARKUP_ESCAPE_H
+#define __MARKUP_ESCAPE_H
+
+#include <glib.h>
+#include "srain.h"
+
+void srn_markup_escape_append(GString *str, const char *text, int len);
+char* srn_markup_escape(const char *text, int len);
+bool srn_markup_need_escape(const char *text, int len);
+
+#endif /* __MARKUP_ESCAPE_H */
@@ -30,6 +30,7 @@
 #include "ret.h"
 
 typedef struct _SrnPatternSet SrnPatternSet;
+typedef struct _SrnPatternList SrnPatternList;
 
 SrnPatternSet* srn_pattern_set_new(void);
 void srn_pattern_set_free(SrnPatternSet *self);
@@ -39,4 +40,11 @@ SrnRet srn_pattern_set_rm(SrnPatternSet *self, const char *name);
 GRegex* srn_pattern_set_get(SrnPatternSet *self, const char *name);
 GList* srn_pattern_set_list(SrnPatternSet *self);
 
+SrnPatternList* srn_pattern_list_new(SrnPatternSet *set);
+void srn_pattern_list_free(SrnPatternList *self);
+SrnRet srn_pattern_list_add(SrnPatternList *self, const char *name);
+SrnRet srn_pattern_list_rm(SrnPatternList *self, const char *name);
+int srn_pattern_list_get_length(SrnPatternList *self);
+GPtrArray* srn_pattern_list_get_regexes(SrnPatternList *self);
+
 #endif /* __PATTERN_SET_H */
@@ -45,6 +45,11 @@ void srn_render_finalize(void);
  * @brief srn_render_message renders a SrnMessage according to the given flags.
  * Fields of SrnMessage may be changed after rendering.
  *
+ * A message can be rendered in several passes, each pass continues from the
+ * result of previous ones, so every renderer is applied at most once. The
+ * pattern and mIRC renderers must be applied in the first pass. Call
+ * srn_message_reset_rendered() to render a message again from scratch.
+ *
  * @param msg is a SrnMessage instance.
  * @param flags indicates which render moduele to use.
  *
@@ -52,6 +57,32 @@ void srn_render_finalize(void);
  */
 SrnRet srn_render_message(SrnMessage *msg, SrnRenderFlags flags);
 
+/**
+ * @brief SrnRenderQueue renders messages on worker threads, and passes them
+ * back to main thread in the order they are pushed.
+ */
+typedef struct _SrnRenderQueue SrnRenderQueue;
+
+/**
+ * @brief SrnRenderFunc is called on main thread when a message pushed to
+ * SrnRenderQueue is rendered, or fails to render.
+ *
+ * @param msg
+ * @param ret is SRN_OK if render success.
+ * @param user_data
+ */
+typedef void (*SrnRenderFunc) (SrnMessage *msg, SrnRet ret, void *user_data);
+
+SrnRenderQueue* srn_render_queue_new(void);
+void srn_render_queue_free(SrnRenderQueue *self);
+void srn_render_queue_push(SrnRenderQueue *self, SrnMessage *msg,
+        SrnRenderFlags flags, SrnRenderFunc func, void *user_data);
+void srn_render_queue_push_head(SrnRenderQueue *self, SrnMessage *msg,
+        SrnRenderFlags flags, SrnRenderFunc func, void *user_data);
+bool srn_render_queue_is_empty(SrnRenderQueue *self);
+
+void srn_render_invalidate(SrnExtraData *extra_data);
+
 SrnRet srn_render_attach_pattern(SrnExtraData *extra_data, const char *pattern);
 SrnRet srn_render_detach_pattern(SrnExtraData *extra_data, const char *pattern);
 
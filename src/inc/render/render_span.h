@@ -0,0 +1,59 @@
+/* Copyright (C) 2016-2021 Shengyu Zhang <i@silverrainz.me>
+ *
+ * This file is part of Srain.
+ *
+ * Srain is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file render_span.h
+ * @brief Attributes of rendered message, applied to ranges of its plain
+ * content.
+ * @author Shengyu Zhang <i@silverrainz.me>
+ * @version 1.2.0
+ * @date 2021-03-19
+ */
+
+#ifndef __RENDER_SPAN_H
+#define __RENDER_SPAN_H
+
+// TODO: Make this color configurable
+#define SRN_RENDER_MENTION_COLOR    "#549ee7"
+
+typedef enum _SrnRenderSpanType SrnRenderSpanType;
+typedef struct _SrnRenderSpan SrnRenderSpan;
+
+enum _SrnRenderSpanType {
+    SRN_RENDER_SPAN_BOLD,
+    SRN_RENDER_SPAN_ITALICS,
+    SRN_RENDER_SPAN_UNDERLINE,
+    SRN_RENDER_SPAN_STRIKETHROUGH,
+    SRN_RENDER_SPAN_MONOSPACE,
+    SRN_RENDER_SPAN_FOREGROUND, // value is a color like "#FFFFFF"
+    SRN_RENDER_SPAN_BACKGROUND, // value is a color like "#FFFFFF"
+    SRN_RENDER_SPAN_LINK,       // value is the link target
+    SRN_RENDER_SPAN_MENTION,
+};
+
+/**
+ * @brief SrnRenderSpan is an attribute applied to a range of plain text.
+ */
+struct _SrnRenderSpan {
+    SrnRenderSpanType type;
+    int start;      // Byte offset in plain text, inclusive
+    int end;        // Byte offset in plain text, exclusive
+    char *value;    // Can be NULL
+};
+
+#endif /* __RENDER_SPAN_H */
@@ -68,13 +68,17 @@ void sui_activate_buffer(SuiBuffer *buf);
 void* sui_buffer_get_ctx(SuiBuffer *buf);
 void sui_buffer_set_config(SuiBuffer *buf, SuiBufferConfig *cfg);
 void sui_buffer_add_message(SuiBuffer *buf, SuiMessage *msg);
+void sui_buffer_insert_message(SuiBuffer *buf, SuiMessage *msg);
+void sui_buffer_prepend_message(SuiBuffer *buf, SuiMessage *msg);
+void sui_buffer_add_pending_message(SuiBuffer *buf, const char *nick,
+        const char *content);
 
 /* SuiMessage */
 SuiMessage *sui_new_misc_message(void *ctx, SuiMiscMessageStyle style);
 SuiMessage *sui_new_send_message(void *ctx);
 SuiMessage *sui_new_recv_message(void *ctx);
 
-void sui_update_message(SuiMessage *msg);
+void sui_update_message_content(SuiMessage *msg);
 void sui_notify_message(SuiMessage *msg);
 
 /* User */
@@ -83,6 +87,8 @@ void sui_free_user(SuiUser *user);
 void sui_add_user(SuiBuffer *buf, SuiUser *user);
 void sui_rm_user(SuiBuffer *buf, SuiUser *user);
 void sui_update_user(SuiBuffer *buf, SuiUser *user);
+void sui_freeze_users(SuiBuffer *buf);
+void sui_thaw_users(SuiBuffer *buf);
 
 /* Misc */
 void sui_set_topic(SuiBuffer *sui, const char *topic);
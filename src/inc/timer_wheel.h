@@ -0,0 +1,42 @@
+/* Copyright (C) 2016-2021 Shengyu Zhang <i@silverrainz.me>
+ *
+ * This file is part of Srain.
+ *
+ * Srain is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file timer_wheel.h
+ * @brief Coarse timers of second granularity sharing one GLib source.
+ * @author Shengyu Zhang <i@silverrainz.me>
+ * @version 1.2.0
+ * @date 2021-03-13
+ */
+
+#ifndef __TIMER_WHEEL_H
+#define __TIMER_WHEEL_H
+
+#include <glib.h>
+#include "srain.h"
+
+typedef struct _SrnTimerWheel SrnTimerWheel;
+
+SrnTimerWheel* srn_timer_wheel_new(void);
+void srn_timer_wheel_free(SrnTimerWheel *self);
+
+unsigned srn_timer_wheel_add(SrnTimerWheel *self, const char *name,
+        unsigned interval, GSourceFunc func, gpointer user_data);
+bool srn_timer_wheel_remove(SrnTimerWheel *self, unsigned id);
+
+#endif /* __TIMER_WHEEL_H */
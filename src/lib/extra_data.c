@@ -25,46 +25,70 @@
  * @date 2019-05-25
  */
 
+#include <string.h>
 #include <glib.h>
 
 #include "extra_data.h"
 
-struct _SrnExtraData {
-    GHashTable *data_table;
-    GHashTable *destory_func_table;
+/* Max number of entries stored in inline array, a hash table is used when
+ * there are more entries */
+#define MAX_INLINE_ENTRIES  8
+
+typedef struct _SrnExtraDataEntry SrnExtraDataEntry;
+
+struct _SrnExtraDataEntry {
+    const char *key;
+    void *val;
+    GDestroyNotify destory_func;
 };
 
-SrnExtraData* srn_extra_data_new(void) {
-    SrnExtraData *self;
+/* Most objects never store any extra data, so a SrnExtraData is just a few
+ * pointers until the first key is set */
+struct _SrnExtraData {
+    int len;    // Number of entries in inline array
+    SrnExtraDataEntry *entries; // Inline array, NULL until first set
+    GHashTable *table; // Key -> SrnExtraDataEntry, only exists when the
+                       // inline array is full
+};
 
-    self = g_malloc0(sizeof(SrnExtraData));
-    self->data_table = g_hash_table_new(g_str_hash, g_str_equal);
-    self->destory_func_table = g_hash_table_new(g_str_hash, g_str_equal);
+static SrnExtraDataEntry* lookup_entry(SrnExtraData *self, const char *key);
+static void free_entry(SrnExtraDataEntry *entry);
 
-    return self;
+SrnExtraData* srn_extra_data_new(void) {
+    return g_malloc0(sizeof(SrnExtraData));
 }
 
 void srn_extra_data_free(SrnExtraData *self) {
-    gpointer key, val;
-    GHashTableIter iter;
-
     // Free all extra data via destory func
-    g_hash_table_iter_init(&iter, self->data_table);
-    while (g_hash_table_iter_next(&iter, &key, &val)){
-        GDestroyNotify func;
+    for (int i = 0; i < self->len; i++){
+        if (self->entries[i].destory_func) {
+            self->entries[i].destory_func(self->entries[i].val);
+        }
+    }
+    g_free(self->entries);
 
-        func = g_hash_table_lookup(self->destory_func_table, key);
-        if (func) {
-            func(val);
+    if (self->table) {
+        SrnExtraDataEntry *entry;
+        GHashTableIter iter;
+
+        g_hash_table_iter_init(&iter, self->table);
+        while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&entry)){
+            if (entry->destory_func) {
+                entry->destory_func(entry->val);
+            }
         }
+        g_hash_table_destroy(self->table);
     }
 
-    g_hash_table_destroy(self->data_table);
-    g_hash_table_destroy(self->destory_func_table);
+    g_free(self);
 }
 
 void* srn_extra_data_get(SrnExtraData *self, const char *key) {
-    return g_hash_table_lookup(self->data_table, key);
+    SrnExtraDataEntry *entry;
+
+    entry = lookup_entry(self, key);
+
+    return entry ? entry->val : NULL;
 }
 
 void srn_extra_data_set(SrnExtraData *self, const char *key, void *val,
@@ -72,25 +96,73 @@ void srn_extra_data_set(SrnExtraData *self, const char *key, void *val,
     g_return_if_fail(key);
 
     if (val) { // Add a key, NOTE: Update a exsting key is not allowed for now
-        g_return_if_fail(!g_hash_table_contains(self->data_table, key));
-        g_return_if_fail(!g_hash_table_contains(self->destory_func_table, key));
+        SrnExtraDataEntry *entry;
+
+        g_return_if_fail(!lookup_entry(self, key));
+
+        if (!self->table && self->len < MAX_INLINE_ENTRIES) {
+            self->entries = g_renew(SrnExtraDataEntry, self->entries,
+                    self->len + 1);
+            entry = &self->entries[self->len++];
+        } else {
+            if (!self->table) {
+                // Move all inline entries to hash table
+                self->table = g_hash_table_new_full(g_str_hash, g_str_equal,
+                        NULL, (GDestroyNotify)free_entry);
+                for (int i = 0; i < self->len; i++){
+                    entry = g_malloc(sizeof(SrnExtraDataEntry));
+                    *entry = self->entries[i];
+                    g_hash_table_insert(self->table, (gpointer)entry->key, entry);
+                }
+                g_free(self->entries);
+                self->entries = NULL;
+                self->len = 0;
+            }
+            entry = g_malloc0(sizeof(SrnExtraDataEntry));
+            g_hash_table_insert(self->table, (gpointer)key, entry);
+        }
 
-        g_hash_table_insert(self->data_table, (gpointer)key, val);
-        g_hash_table_insert(self->destory_func_table, (gpointer)key,
-                val_destory_func);
+        entry->key = key;
+        entry->val = val;
+        entry->destory_func = val_destory_func;
     } else { // Remove a key
-        void *oldval;
-        GDestroyNotify func;
+        SrnExtraDataEntry *entry;
+
+        entry = lookup_entry(self, key);
+        g_return_if_fail(entry);
+
+        if (entry->destory_func) {
+            entry->destory_func(entry->val);
+        }
+
+        if (self->table) {
+            g_hash_table_remove(self->table, key);
+        } else {
+            // Keep inline array compact
+            *entry = self->entries[--self->len];
+            if (self->len == 0) {
+                g_free(self->entries);
+                self->entries = NULL;
+            }
+        }
+    }
+}
 
-        g_return_if_fail(g_hash_table_contains(self->data_table, key));
-        g_return_if_fail(g_hash_table_contains(self->destory_func_table, key));
+static SrnExtraDataEntry* lookup_entry(SrnExtraData *self, const char *key) {
+    if (self->table) {
+        return g_hash_table_lookup(self->table, key);
+    }
 
-        oldval = g_hash_table_lookup(self->data_table, key);
-        func = g_hash_table_lookup(self->destory_func_table, key);
-        if (func) {
-            func(oldval);
+    for (int i = 0; i < self->len; i++){
+        if (strcmp(self->entries[i].key, key) == 0) {
+            return &self->entries[i];
         }
-        g_hash_table_remove(self->data_table, key);
-        g_hash_table_remove(self->destory_func_table, key);
     }
+
+    return NULL;
+}
+
+/* Destory func of value is called by caller */
+static void free_entry(SrnExtraDataEntry *entry) {
+    g_free(entry);
 }
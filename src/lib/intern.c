@@ -0,0 +1,236 @@
+/* Copyright (C) 2016-2021 Shengyu Zhang <i@silverrainz.me>
+ *
+ * This file is part of Srain.
+ *
+ * Srain is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file intern.c
+ * @brief This file provides a process-wide refcounted string pool for
+ * nicknames, usernames, hostnames and channel names. Every distinct string is
+ * stored only once, and all case variants of a string share one case-folded
+ * string, so case-insensitive comparison of interned strings is a pointer
+ * comparison.
+ *
+ * The pool is protected by a lock so that it can be used by worker threads.
+ * Strings returned by srn_intern_lookup() and srn_intern_lookup_fold() are
+ * not referenced, they are only valid while another reference is held.
+ * @author Shengyu Zhang <i@silverrainz.me>
+ * @version 1.2.0
+ * @date 2021-03-02
+ */
+
+#include <string.h>
+#include <glib.h>
+
+#include "intern.h"
+
+typedef struct _SrnInternEntry SrnInternEntry;
+
+struct _SrnInternEntry {
+    int refcount;
+    SrnInternEntry *fold; // Entry of case-folded string, may be itself
+    char str[]; // Original form
+};
+
+#define ENTRY_OF(istr) \
+    ((SrnInternEntry *)((char *)(istr) - G_STRUCT_OFFSET(SrnInternEntry, str)))
+
+static GHashTable *intern_table; // String -> SrnInternEntry
+G_LOCK_DEFINE_STATIC(intern_table);
+
+static SrnInternEntry* ref_entry(const char *str);
+static void unref_entry(SrnInternEntry *entry);
+
+/**
+ * @brief srn_intern returns the interned copy of given string, the
+ * reference count of it is increased.
+ *
+ * @param str
+ *
+ * @return An interned string which should be released by srn_intern_unref(),
+ * NULL if str is NULL. It MUST not be modified.
+ */
+const char* srn_intern(const char *str){
+    SrnInternEntry *entry;
+
+    if (!str) {
+        return NULL;
+    }
+
+    G_LOCK(intern_table);
+    entry = ref_entry(str);
+    G_UNLOCK(intern_table);
+
+    return entry->str;
+}
+
+void srn_intern_unref(const char *istr){
+    if (!istr) {
+        return;
+    }
+
+    G_LOCK(intern_table);
+    unref_entry(ENTRY_OF(istr));
+    G_UNLOCK(intern_table);
+}
+
+/**
+ * @brief srn_intern_assign is the interned version of str_assign().
+ *
+ * @param left is pointer to a interned string or NULL.
+ * @param right
+ */
+void srn_intern_assign(char **left, const char *right){
+    const char *old;
+
+    old = *left;
+    *left = (char *)srn_intern(right);
+    srn_intern_unref(old);
+}
+
+/**
+ * @brief srn_intern_lookup looks up the interned copy of given string
+ * without increasing reference count.
+ *
+ * @param str
+ *
+ * @return NULL if the string is not interned.
+ */
+const char* srn_intern_lookup(const char *str){
+    SrnInternEntry *entry;
+
+    if (!str) {
+        return NULL;
+    }
+
+    G_LOCK(intern_table);
+    entry = intern_table ? g_hash_table_lookup(intern_table, str) : NULL;
+    G_UNLOCK(intern_table);
+
+    return entry ? entry->str : NULL;
+}
+
+/**
+ * @brief srn_intern_lookup_fold looks up the case-folded form of given
+ * string in pool without increasing reference count.
+ *
+ * @param str
+ *
+ * @return An interned string, NULL if neither the string nor any of its case
+ * variants is interned.
+ */
+const char* srn_intern_lookup_fold(const char *str){
+    char *fold;
+    SrnInternEntry *entry;
+
+    if (!str) {
+        return NULL;
+    }
+
+    G_LOCK(intern_table);
+    entry = intern_table ? g_hash_table_lookup(intern_table, str) : NULL;
+    G_UNLOCK(intern_table);
+    if (entry) {
+        return entry->fold->str;
+    }
+
+    fold = g_ascii_strdown(str, -1);
+    G_LOCK(intern_table);
+    entry = intern_table ? g_hash_table_lookup(intern_table, fold) : NULL;
+    G_UNLOCK(intern_table);
+    g_free(fold);
+
+    // The fold of an interned string is always interned
+    return entry ? entry->fold->str : NULL;
+}
+
+/**
+ * @brief srn_intern_get_fold returns the case-folded form of an interned
+ * string.
+ *
+ * @param istr must be a interned string.
+ *
+ * @return A interned string.
+ */
+const char* srn_intern_get_fold(const char *istr){
+    g_return_val_if_fail(istr, NULL);
+
+    return ENTRY_OF(istr)->fold->str;
+}
+
+/**
+ * @brief srn_intern_equal compares two interned string case-insensitively.
+ */
+bool srn_intern_equal(const char *istr1, const char *istr2){
+    if (istr1 == istr2) {
+        return TRUE;
+    }
+    if (!istr1 || !istr2) {
+        return FALSE;
+    }
+
+    return ENTRY_OF(istr1)->fold == ENTRY_OF(istr2)->fold;
+}
+
+/* Following functions must be called with intern_table locked */
+
+static SrnInternEntry* ref_entry(const char *str){
+    int len;
+    char *fold;
+    SrnInternEntry *entry;
+
+    if (!intern_table) {
+        intern_table = g_hash_table_new(g_str_hash, g_str_equal);
+    }
+
+    entry = g_hash_table_lookup(intern_table, str);
+    if (entry) {
+        entry->refcount++;
+        return entry;
+    }
+
+    len = strlen(str);
+    entry = g_malloc(sizeof(SrnInternEntry) + len + 1);
+    entry->refcount = 1;
+    memcpy(entry->str, str, len + 1);
+
+    // IRC casemapping, same as sirc_target_equal()
+    fold = g_ascii_strdown(str, len);
+    if (strcmp(fold, str) == 0) {
+        entry->fold = entry;
+    } else {
+        entry->fold = ref_entry(fold);
+    }
+    g_free(fold);
+
+    g_hash_table_insert(intern_table, entry->str, entry);
+
+    return entry;
+}
+
+static void unref_entry(SrnInternEntry *entry){
+    g_return_if_fail(entry->refcount > 0);
+
+    if (--entry->refcount > 0) {
+        return;
+    }
+
+    g_hash_table_remove(intern_table, entry->str);
+    if (entry->fold != entry) {
+        unref_entry(entry->fold);
+    }
+    g_free(entry);
+}
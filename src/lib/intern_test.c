@@ -0,0 +1,347 @@
+/* Copyright (C) 2016-2021 Shengyu Zhang <i@silverrainz.me>
+ *
+ * This file is part of Srain.
+ *
+ * Srain is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file intern_test.c
+ * @brief Test case for intern.c
+ * @author Shengyu Zhang <i@silverrainz.me>
+ * @version 1.2.0
+ * @date 2021-03-20
+ *
+ * Run "intern_test -m perf" for peak RSS of replaying a busy session with
+ * and without the string pool. The session is read from bench/session.log
+ * under G_TEST_SRCDIR, or from the file given by SRN_BENCH_SESSION, it is
+ * IRC messages received by client, one per line.
+ */
+
+#include <string.h>
+#include <glib.h>
+
+#ifdef G_OS_UNIX
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#endif
+
+#include "intern.h"
+
+#define NTHREAD 4
+#define NROUND  100000
+
+#define SESSION_ROUND   20 // Session is replayed as if it lasts longer
+
+typedef enum {
+    STORE_NONE, // Messages are only parsed
+    STORE_DUP, // Strings are duplicated for every message, like before
+    STORE_INTERN, // Strings are shared via string pool
+} StoreMode;
+
+/* Strings kept for a message, its sender is kept by chat and UI */
+typedef struct {
+    const char *nick;
+    const char *ident;
+    const char *host;
+    const char *chan;
+    char *content;
+} Record;
+
+static void test_ref_unref(void);
+static void test_lookup_fold(void);
+static void test_assign(void);
+static void test_threads(void);
+static gpointer thread_func(gpointer data);
+static void test_perf(void);
+#ifdef G_OS_UNIX
+static GPtrArray* replay_session(char **lines, StoreMode mode);
+static long measure_peak_rss(char **lines, StoreMode mode);
+static const char* store(const char *str, int len, StoreMode mode);
+#endif
+
+int main(int argc, char *argv[]){
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/intern/ref_unref", test_ref_unref);
+    g_test_add_func("/intern/lookup_fold", test_lookup_fold);
+    g_test_add_func("/intern/assign", test_assign);
+    g_test_add_func("/intern/threads", test_threads);
+    if (g_test_perf()){
+        g_test_add_func("/intern/perf", test_perf);
+    }
+
+    return g_test_run();
+}
+
+static void test_ref_unref(void){
+    char buf[] = "Alice";
+    const char *istr1;
+    const char *istr2;
+
+    g_assert_null(srn_intern(NULL));
+    g_assert_null(srn_intern_lookup("Alice"));
+
+    istr1 = srn_intern(buf);
+    g_assert_cmpstr(istr1, ==, "Alice");
+    g_assert_true(istr1 != buf);
+
+    // Same string is stored only once
+    istr2 = srn_intern("Alice");
+    g_assert_true(istr1 == istr2);
+    g_assert_true(srn_intern_lookup("Alice") == istr1);
+
+    srn_intern_unref(istr2);
+    g_assert_true(srn_intern_lookup("Alice") == istr1);
+
+    srn_intern_unref(istr1);
+    g_assert_null(srn_intern_lookup("Alice"));
+    // Fold is released along with the last case variant
+    g_assert_null(srn_intern_lookup("alice"));
+
+    srn_intern_unref(NULL);
+}
+
+static void test_lookup_fold(void){
+    const char *upper;
+    const char *mixed;
+    const char *fold;
+
+    g_assert_null(srn_intern_lookup_fold("bob"));
+
+    upper = srn_intern("BOB");
+    mixed = srn_intern("Bob");
+    fold = srn_intern_get_fold(upper);
+
+    g_assert_cmpstr(fold, ==, "bob");
+    g_assert_true(srn_intern_get_fold(mixed) == fold);
+    g_assert_true(srn_intern_get_fold(fold) == fold);
+    g_assert_true(srn_intern_lookup("bob") == fold);
+
+    // Case variant which is not interned is found by its fold
+    g_assert_null(srn_intern_lookup("bOB"));
+    g_assert_true(srn_intern_lookup_fold("bOB") == fold);
+    g_assert_true(srn_intern_lookup_fold("Bob") == fold);
+    g_assert_null(srn_intern_lookup_fold("carol"));
+
+    g_assert_true(srn_intern_equal(upper, mixed));
+    g_assert_false(srn_intern_equal(upper, NULL));
+    g_assert_true(srn_intern_equal(NULL, NULL));
+
+    srn_intern_unref(upper);
+    g_assert_true(srn_intern_lookup_fold("BOB") == fold);
+    srn_intern_unref(mixed);
+    g_assert_null(srn_intern_lookup_fold("BOB"));
+}
+
+static void test_assign(void){
+    char *istr;
+
+    istr = NULL;
+    srn_intern_assign(&istr, "#Srain");
+    g_assert_cmpstr(istr, ==, "#Srain");
+    g_assert_true(srn_intern_lookup("#Srain") == istr);
+
+    // Assign to itself keeps the string alive
+    srn_intern_assign(&istr, istr);
+    g_assert_true(srn_intern_lookup("#Srain") == istr);
+
+    srn_intern_assign(&istr, NULL);
+    g_assert_null(istr);
+    g_assert_null(srn_intern_lookup("#Srain"));
+}
+
+static void test_threads(void){
+    const char *held;
+    GThread *threads[NTHREAD];
+
+    held = srn_intern("Dave");
+    for (int i = 0; i < NTHREAD; i++){
+        threads[i] = g_thread_new("intern-test", thread_func, NULL);
+    }
+    for (int i = 0; i < NTHREAD; i++){
+        g_thread_join(threads[i]);
+    }
+
+    // References taken by threads are all released
+    g_assert_true(srn_intern_lookup("Dave") == held);
+    g_assert_null(srn_intern_lookup("DAVE"));
+    srn_intern_unref(held);
+    g_assert_null(srn_intern_lookup("Dave"));
+    g_assert_null(srn_intern_lookup("dave"));
+}
+
+static gpointer thread_func(gpointer data){
+    for (int i = 0; i < NROUND; i++){
+        const char *istr1;
+        const char *istr2;
+
+        istr1 = srn_intern("Dave");
+        istr2 = srn_intern("DAVE");
+        g_assert_true(srn_intern_equal(istr1, istr2));
+        srn_intern_unref(istr2);
+        srn_intern_unref(istr1);
+    }
+
+    return NULL;
+}
+
+static void test_perf(void){
+#ifdef G_OS_UNIX
+    long none;
+    long dup;
+    long intern;
+    char *path;
+    char *data;
+    char **lines;
+    GError *err;
+
+    if (g_getenv("SRN_BENCH_SESSION")){
+        path = g_strdup(g_getenv("SRN_BENCH_SESSION"));
+    } else {
+        path = g_test_build_filename(G_TEST_DIST, "bench", "session.log",
+                NULL);
+    }
+    err = NULL;
+    if (!g_file_get_contents(path, &data, NULL, &err)){
+        g_test_skip(err->message);
+        g_error_free(err);
+        g_free(path);
+        return;
+    }
+    lines = g_strsplit(data, "\n", -1);
+    g_free(data);
+
+    // Every mode is replayed in a new process, so that peak RSS of them
+    // do not affect each other
+    none = measure_peak_rss(lines, STORE_NONE);
+    dup = measure_peak_rss(lines, STORE_DUP);
+    intern = measure_peak_rss(lines, STORE_INTERN);
+
+    g_test_minimized_result(intern,
+            "Peak RSS of replaying %u lines of %s %d times: "
+            "%ld KiB with g_strdup(), %ld KiB with srn_intern(), "
+            "%ld KiB for parsing only",
+            g_strv_length(lines), path, SESSION_ROUND, dup, intern, none);
+    g_assert_cmpint(intern, <=, dup);
+
+    g_strfreev(lines);
+    g_free(path);
+#else
+    g_test_skip("Peak RSS is only measured on Unix");
+#endif
+}
+
+#ifdef G_OS_UNIX
+/**
+ * @brief replay_session parses the IRC messages in lines and keeps strings
+ * of them in the given mode.
+ *
+ * @return Array of Record, it is never freed as the process exits.
+ */
+static GPtrArray* replay_session(char **lines, StoreMode mode){
+    GPtrArray *records;
+
+    records = g_ptr_array_new();
+    for (int round = 0; round < SESSION_ROUND; round++){
+        for (int i = 0; lines[i]; i++){
+            const char *ptr;
+            const char *nick_end;
+            const char *ident_end;
+            const char *prefix_end;
+            const char *cmd_end;
+            const char *target_end;
+            Record *rec;
+
+            // ":nick!ident@host COMMAND [target] [:content]"
+            ptr = lines[i];
+            prefix_end = strchr(ptr, ' ');
+            nick_end = strchr(ptr, '!');
+            ident_end = strchr(ptr, '@');
+            if (ptr[0] != ':' || !prefix_end || !nick_end || !ident_end
+                    || nick_end > ident_end || ident_end > prefix_end){
+                continue;
+            }
+            cmd_end = strchr(prefix_end + 1, ' ');
+            if (!cmd_end){
+                continue;
+            }
+            if (mode == STORE_NONE){
+                continue;
+            }
+
+            rec = g_malloc0(sizeof(Record));
+            rec->nick = store(ptr + 1, nick_end - ptr - 1, mode);
+            rec->ident = store(nick_end + 1, ident_end - nick_end - 1, mode);
+            rec->host = store(ident_end + 1, prefix_end - ident_end - 1,
+                    mode);
+            if (cmd_end[1] != ':'){
+                target_end = strchr(cmd_end + 1, ' ');
+                if (!target_end){
+                    target_end = cmd_end + strlen(cmd_end);
+                }
+                rec->chan = store(cmd_end + 1, target_end - cmd_end - 1,
+                        mode);
+                ptr = target_end;
+            } else {
+                ptr = cmd_end;
+            }
+            ptr = strstr(ptr, " :");
+            rec->content = g_strdup(ptr ? ptr + 2 : "");
+            g_ptr_array_add(records, rec);
+        }
+    }
+
+    return records;
+}
+
+/**
+ * @brief measure_peak_rss replays session in a child process.
+ *
+ * @return Peak RSS of child process, in KiB on Linux.
+ */
+static long measure_peak_rss(char **lines, StoreMode mode){
+    int status;
+    pid_t pid;
+    struct rusage usage;
+
+    pid = fork();
+    g_assert_cmpint(pid, >=, 0);
+    if (pid == 0){
+        replay_session(lines, mode);
+        _exit(0);
+    }
+
+    g_assert_cmpint(wait4(pid, &status, 0, &usage), ==, pid);
+    g_assert_true(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    return usage.ru_maxrss;
+}
+
+static const char* store(const char *str, int len, StoreMode mode){
+    char *dup;
+    const char *istr;
+
+    dup = g_strndup(str, len);
+    if (mode == STORE_DUP){
+        return dup;
+    }
+
+    istr = srn_intern(dup);
+    g_free(dup);
+
+    return istr;
+}
+#endif
@@ -0,0 +1,339 @@
+/* Copyright (C) 2016-2021 Shengyu Zhang <i@silverrainz.me>
+ *
+ * This file is part of Srain.
+ *
+ * Srain is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file keyword_matcher.c
+ * @brief An Aho-Corasick automaton matches all keywords in one linear scan.
+ * Keywords are matched ASCII case-insensitively and only as whole words.
+ * @author Shengyu Zhang <i@silverrainz.me>
+ * @version 1.2.0
+ * @date 2021-03-15
+ */
+
+#include <string.h>
+#include <glib.h>
+
+#include "srain.h"
+#include "log.h"
+#include "keyword_matcher.h"
+
+#define ROOT_STATE  0
+
+typedef struct _SrnKeyword SrnKeyword;
+
+struct _SrnKeyword {
+    char *str;
+    int len;
+    int tag;
+};
+
+struct _SrnKeywordMatcher {
+    GPtrArray *keywords;    // Array of SrnKeyword
+    bool compiled;
+
+    /* The automaton, built lazily on first match */
+    guint8 classes[256];    // Byte -> class, bytes do not appear in any
+                            // keyword are all in class 0
+    int nclass;
+    int nstate;
+    int *delta;     // Transitions of states, nstate * nclass
+    int *output;    // State -> index of keyword ends at state, -1 if none
+    int *dict;      // State -> nearest state has output on failure chain,
+                    // -1 if none
+};
+
+static void free_keyword(SrnKeyword *keyword);
+static void clear_automaton(SrnKeywordMatcher *self);
+static bool is_word_char(const char *ptr, int max_len);
+static bool is_word_char_before(const char *text, int offset);
+
+SrnKeywordMatcher* srn_keyword_matcher_new(void){
+    SrnKeywordMatcher *self;
+
+    self = g_malloc0(sizeof(SrnKeywordMatcher));
+    self->keywords = g_ptr_array_new_with_free_func(
+            (GDestroyNotify)free_keyword);
+
+    return self;
+}
+
+void srn_keyword_matcher_free(SrnKeywordMatcher *self){
+    clear_automaton(self);
+    g_ptr_array_free(self->keywords, TRUE);
+    g_free(self);
+}
+
+/**
+ * @brief srn_keyword_matcher_add adds a keyword to matcher. If the same
+ * keyword is added more than once, the first one wins.
+ *
+ * @param self
+ * @param keyword is copied, empty keyword is ignored.
+ * @param tag is passed to SrnKeywordMatchFunc when keyword is found.
+ */
+void srn_keyword_matcher_add(SrnKeywordMatcher *self, const char *keyword,
+        int tag){
+    SrnKeyword *kw;
+
+    g_return_if_fail(keyword);
+
+    if (*keyword == '\0'){
+        return;
+    }
+
+    kw = g_malloc0(sizeof(SrnKeyword));
+    kw->str = g_strdup(keyword);
+    kw->len = strlen(keyword);
+    kw->tag = tag;
+    g_ptr_array_add(self->keywords, kw);
+
+    // Automaton is rebuilt on next match
+    clear_automaton(self);
+}
+
+bool srn_keyword_matcher_is_empty(SrnKeywordMatcher *self){
+    return self->keywords->len == 0;
+}
+
+/**
+ * @brief srn_keyword_matcher_match finds all keywords in text, a keyword is
+ * found only when it is not adjacent to any word character, see
+ * is_word_char(). Found keywords may overlap with each other.
+ *
+ * @param self
+ * @param text
+ * @param len is length of text in bytes, -1 if text is NUL-terminated.
+ * @param func is called for every found keyword in order of their ends,
+ *      can be NULL.
+ * @param user_data
+ *
+ * @return Number of found keywords.
+ */
+int srn_keyword_matcher_match(SrnKeywordMatcher *self, const char *text,
+        int len, SrnKeywordMatchFunc func, gpointer user_data){
+    int count;
+    int state;
+    const guint8 *str;
+
+    g_return_val_if_fail(text, 0);
+
+    if (srn_keyword_matcher_is_empty(self)){
+        return 0;
+    }
+    if (!self->compiled){
+        srn_keyword_matcher_compile(self);
+    }
+    if (len < 0){
+        len = strlen(text);
+    }
+
+    count = 0;
+    state = ROOT_STATE;
+    str = (const guint8 *)text;
+    for (int i = 0; i < len; i++){
+        int out;
+
+        state = self->delta[state * self->nclass + self->classes[str[i]]];
+
+        out = self->output[state] >= 0 ? state : self->dict[state];
+        for (; out >= 0; out = self->dict[out]){
+            int start;
+            int end;
+            SrnKeyword *kw;
+
+            kw = g_ptr_array_index(self->keywords, self->output[out]);
+            start = i + 1 - kw->len;
+            end = i + 1;
+            if ((start > 0 && is_word_char_before(text, start))
+                    || (end < len && is_word_char(text + end, len - end))){
+                continue;
+            }
+
+            count++;
+            if (func){
+                func(start, end, kw->tag, user_data);
+            }
+        }
+    }
+
+    return count;
+}
+
+/**
+ * @brief srn_keyword_matcher_compile builds the automaton now instead of on
+ * first match. Matching a compiled matcher does not modify it, so it can be
+ * shared by threads.
+ *
+ * @param self
+ */
+void srn_keyword_matcher_compile(SrnKeywordMatcher *self){
+    int max_state;
+    int head;
+    int tail;
+    int *fail;
+    int *queue;
+
+    clear_automaton(self);
+
+    /* Bytes never appear in keywords share one class, it keeps transition
+     * table small */
+    self->nclass = 1;
+    max_state = 1;
+    for (int i = 0; i < self->keywords->len; i++){
+        SrnKeyword *kw;
+
+        kw = g_ptr_array_index(self->keywords, i);
+        for (int j = 0; j < kw->len; j++){
+            guint8 c;
+
+            c = g_ascii_tolower(kw->str[j]);
+            if (self->classes[c] == 0){
+                g_warn_if_fail(self->nclass < 256);
+                self->classes[c] = self->nclass;
+                self->classes[(guint8)g_ascii_toupper(c)] = self->nclass;
+                self->nclass++;
+            }
+        }
+        max_state += kw->len;
+    }
+
+    self->delta = g_malloc0_n(max_state * self->nclass, sizeof(int));
+    self->output = g_malloc_n(max_state, sizeof(int));
+    self->dict = g_malloc_n(max_state, sizeof(int));
+    for (int i = 0; i < max_state; i++){
+        self->output[i] = -1;
+        self->dict[i] = -1;
+    }
+
+    /* Build trie, 0 means no transition here because no state can go back
+     * to root */
+    self->nstate = 1;
+    for (int i = 0; i < self->keywords->len; i++){
+        int state;
+        SrnKeyword *kw;
+
+        kw = g_ptr_array_index(self->keywords, i);
+        state = ROOT_STATE;
+        for (int j = 0; j < kw->len; j++){
+            int *next;
+
+            next = &self->delta[state * self->nclass
+                + self->classes[(guint8)kw->str[j]]];
+            if (*next == 0){
+                *next = self->nstate++;
+            }
+            state = *next;
+        }
+        if (self->output[state] < 0){
+            self->output[state] = i;
+        }
+    }
+
+    /* Fill failure transitions in breadth-first order, so the transitions
+     * of failure state are always complete */
+    fail = g_malloc0_n(self->nstate, sizeof(int));
+    queue = g_malloc_n(self->nstate, sizeof(int));
+    head = tail = 0;
+    for (int c = 0; c < self->nclass; c++){
+        int next;
+
+        next = self->delta[ROOT_STATE * self->nclass + c];
+        if (next != 0){
+            fail[next] = ROOT_STATE;
+            queue[tail++] = next;
+        }
+    }
+    while (head < tail){
+        int state;
+
+        state = queue[head++];
+        for (int c = 0; c < self->nclass; c++){
+            int *next;
+            int fail_next;
+
+            next = &self->delta[state * self->nclass + c];
+            fail_next = self->delta[fail[state] * self->nclass + c];
+            if (*next == 0){
+                *next = fail_next;
+                continue;
+            }
+
+            fail[*next] = fail_next;
+            self->dict[*next] = self->output[fail_next] >= 0
+                ? fail_next : self->dict[fail_next];
+            queue[tail++] = *next;
+        }
+    }
+
+    g_free(queue);
+    g_free(fail);
+
+    self->compiled = TRUE;
+    DBG_FR("Keyword matcher %p compiled: %d keywords, %d states, %d classes",
+            self, self->keywords->len, self->nstate, self->nclass);
+}
+
+static void free_keyword(SrnKeyword *keyword){
+    g_free(keyword->str);
+    g_free(keyword);
+}
+
+static void clear_automaton(SrnKeywordMatcher *self){
+    g_free(self->delta);
+    g_free(self->output);
+    g_free(self->dict);
+    self->delta = NULL;
+    self->output = NULL;
+    self->dict = NULL;
+    memset(self->classes, 0, sizeof(self->classes));
+    self->nclass = 0;
+    self->nstate = 0;
+    self->compiled = FALSE;
+}
+
+/**
+ * @brief is_word_char returns whether the UTF-8 character at ptr is a word
+ * character: letters, digits and '_'. Wide characters (CJK ideographs, kana,
+ * fullwidth forms...) are not, because such text is written without spaces.
+ * Invalid UTF-8 sequence is treated as a word character.
+ */
+static bool is_word_char(const char *ptr, int max_len){
+    gunichar c;
+
+    if ((guint8)*ptr < 0x80){
+        return g_ascii_isalnum(*ptr) || *ptr == '_';
+    }
+
+    c = g_utf8_get_char_validated(ptr, max_len);
+    if (c == (gunichar)-1 || c == (gunichar)-2){
+        return TRUE;
+    }
+
+    return g_unichar_isalnum(c) && !g_unichar_iswide(c);
+}
+
+static bool is_word_char_before(const char *text, int offset){
+    const char *prev;
+
+    prev = g_utf8_find_prev_char(text, text + offset);
+    if (!prev){
+        return FALSE;
+    }
+
+    return is_word_char(prev, text + offset - prev);
+}
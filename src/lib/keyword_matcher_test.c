@@ -0,0 +1,200 @@
+/* Copyright (C) 2016-2021 Shengyu Zhang <i@silverrainz.me>
+ *
+ * This file is part of Srain.
+ *
+ * Srain is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file keyword_matcher_test.c
+ * @brief Test case for keyword_matcher.c
+ * @author Shengyu Zhang <i@silverrainz.me>
+ * @version 1.2.0
+ * @date 2021-03-20
+ */
+
+#include <glib.h>
+
+#include "keyword_matcher.h"
+#include "log.h"
+
+typedef struct {
+    int start;
+    int end;
+    int tag;
+} Match;
+
+static void test_whole_word(void);
+static void test_utf8_boundary(void);
+static void test_utf8_keyword(void);
+static void test_tags(void);
+static GArray* match(SrnKeywordMatcher *matcher, const char *text, int len);
+static void on_match(int start, int end, int tag, gpointer user_data);
+
+int main(int argc, char *argv[]){
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/keyword_matcher/whole_word", test_whole_word);
+    g_test_add_func("/keyword_matcher/utf8_boundary", test_utf8_boundary);
+    g_test_add_func("/keyword_matcher/utf8_keyword", test_utf8_keyword);
+    g_test_add_func("/keyword_matcher/tags", test_tags);
+
+    return g_test_run();
+}
+
+/* keyword_matcher.c only logs debug messages, drop them */
+SrnLogger *srn_logger_get_default(void){
+    return NULL;
+}
+
+void srn_logger_log(SrnLogger *logger, SrnLogLevel lv, bool print_prompt,
+        bool new_line, const char *file, const char *func, int line,
+        const char *fmt, ...){
+}
+
+static void test_whole_word(void){
+    GArray *matches;
+    SrnKeywordMatcher *matcher;
+
+    matcher = srn_keyword_matcher_new();
+    g_assert_true(srn_keyword_matcher_is_empty(matcher));
+    g_assert_cmpint(srn_keyword_matcher_match(matcher, "nick", -1, NULL, NULL),
+            ==, 0);
+
+    srn_keyword_matcher_add(matcher, "", 0);
+    g_assert_true(srn_keyword_matcher_is_empty(matcher));
+    srn_keyword_matcher_add(matcher, "Nick", 0);
+
+    matches = match(matcher, "hello nick, hi NICK: nick", -1);
+    g_assert_cmpuint(matches->len, ==, 3);
+    g_assert_cmpint(g_array_index(matches, Match, 0).start, ==, 6);
+    g_assert_cmpint(g_array_index(matches, Match, 0).end, ==, 10);
+    g_assert_cmpint(g_array_index(matches, Match, 1).start, ==, 15);
+    g_assert_cmpint(g_array_index(matches, Match, 2).start, ==, 21);
+    g_array_free(matches, TRUE);
+
+    g_assert_cmpint(srn_keyword_matcher_match(matcher,
+                "nickname _nick nick_ nick2 2nick", -1, NULL, NULL), ==, 0);
+    g_assert_cmpint(srn_keyword_matcher_match(matcher,
+                "-nick- (nick) @nick", -1, NULL, NULL), ==, 3);
+
+    // Only the first len bytes are matched, the byte after is not checked
+    g_assert_cmpint(srn_keyword_matcher_match(matcher, "nickname", 4,
+                NULL, NULL), ==, 1);
+    g_assert_cmpint(srn_keyword_matcher_match(matcher, "nickname", 3,
+                NULL, NULL), ==, 0);
+
+    srn_keyword_matcher_free(matcher);
+}
+
+static void test_utf8_boundary(void){
+    SrnKeywordMatcher *matcher;
+
+    matcher = srn_keyword_matcher_new();
+    srn_keyword_matcher_add(matcher, "nick", 0);
+
+    // Non-ASCII punctuation and spaces
+    g_assert_cmpint(srn_keyword_matcher_match(matcher,
+                "nick：你好", -1, NULL, NULL), ==, 1);
+    g_assert_cmpint(srn_keyword_matcher_match(matcher,
+                "«nick» “nick”", -1, NULL, NULL), ==, 2);
+    g_assert_cmpint(srn_keyword_matcher_match(matcher,
+                "\xe3\x80\x80nick\xc2\xa0", -1, NULL, NULL), ==, 1);
+    // CJK text is written without spaces
+    g_assert_cmpint(srn_keyword_matcher_match(matcher,
+                "你好nick你好", -1, NULL, NULL), ==, 1);
+    g_assert_cmpint(srn_keyword_matcher_match(matcher,
+                "こんにちはnickさん", -1, NULL, NULL), ==, 1);
+    // Non-ASCII letters and digits
+    g_assert_cmpint(srn_keyword_matcher_match(matcher,
+                "nické énick ßnick nickж", -1, NULL, NULL), ==, 0);
+    g_assert_cmpint(srn_keyword_matcher_match(matcher,
+                "nick\xd9\xa3", -1, NULL, NULL), ==, 0);
+    // Invalid or truncated UTF-8 sequence
+    g_assert_cmpint(srn_keyword_matcher_match(matcher,
+                "\xffnick", -1, NULL, NULL), ==, 0);
+    g_assert_cmpint(srn_keyword_matcher_match(matcher,
+                "nick\xe4\xbd", -1, NULL, NULL), ==, 0);
+    g_assert_cmpint(srn_keyword_matcher_match(matcher,
+                "nick\xe4\xbd\xa0", 5, NULL, NULL), ==, 0);
+
+    srn_keyword_matcher_free(matcher);
+}
+
+static void test_utf8_keyword(void){
+    SrnKeywordMatcher *matcher;
+
+    matcher = srn_keyword_matcher_new();
+    srn_keyword_matcher_add(matcher, "张三", 0);
+    srn_keyword_matcher_add(matcher, "Zoë", 0);
+
+    g_assert_cmpint(srn_keyword_matcher_match(matcher,
+                "你好张三，zoë!", -1, NULL, NULL), ==, 2);
+    g_assert_cmpint(srn_keyword_matcher_match(matcher,
+                "张三abc Zoëy", -1, NULL, NULL), ==, 0);
+
+    srn_keyword_matcher_free(matcher);
+}
+
+static void test_tags(void){
+    GArray *matches;
+    SrnKeywordMatcher *matcher;
+
+    matcher = srn_keyword_matcher_new();
+    srn_keyword_matcher_add(matcher, "foo bar", 1);
+    srn_keyword_matcher_add(matcher, "bar", 2);
+    srn_keyword_matcher_add(matcher, "BAR", 3); // Duplicated, ignored
+    srn_keyword_matcher_compile(matcher);
+
+    // Overlapped keywords are all found, in order of their ends
+    matches = match(matcher, "foo bar baz bar", -1);
+    g_assert_cmpuint(matches->len, ==, 3);
+    g_assert_cmpint(g_array_index(matches, Match, 0).tag, ==, 1);
+    g_assert_cmpint(g_array_index(matches, Match, 0).start, ==, 0);
+    g_assert_cmpint(g_array_index(matches, Match, 1).tag, ==, 2);
+    g_assert_cmpint(g_array_index(matches, Match, 1).start, ==, 4);
+    g_assert_cmpint(g_array_index(matches, Match, 2).tag, ==, 2);
+    g_assert_cmpint(g_array_index(matches, Match, 2).start, ==, 12);
+    g_array_free(matches, TRUE);
+
+    // Adding keyword after compiling rebuilds the automaton
+    srn_keyword_matcher_add(matcher, "baz", 4);
+    matches = match(matcher, "foo bar baz bar", -1);
+    g_assert_cmpuint(matches->len, ==, 4);
+    g_assert_cmpint(g_array_index(matches, Match, 2).tag, ==, 4);
+    g_array_free(matches, TRUE);
+
+    srn_keyword_matcher_free(matcher);
+}
+
+static GArray* match(SrnKeywordMatcher *matcher, const char *text, int len){
+    GArray *matches;
+
+    matches = g_array_new(FALSE, FALSE, sizeof(Match));
+    g_assert_cmpint(srn_keyword_matcher_match(matcher, text, len,
+                on_match, matches), ==, matches->len);
+
+    return matches;
+}
+
+static void on_match(int start, int end, int tag, gpointer user_data){
+    Match m;
+    GArray *matches;
+
+    matches = user_data;
+    m.start = start;
+    m.end = end;
+    m.tag = tag;
+    g_array_append_val(matches, m);
+}
@@ -32,7 +32,12 @@
 #include "config/config.h"
 #include "log.h"
 
+/**
+ * @brief SrnLogger can be used from any thread, mutex protects the config
+ * from being replaced while a message is being printed.
+ */
 struct _SrnLogger {
+    GMutex mutex;
     SrnLoggerConfig *cfg;
 };
 
@@ -73,12 +78,14 @@ SrnLogger* srn_logger_new(SrnLoggerConfig *cfg){
     SrnLogger *logger;
 
     logger = g_malloc0(sizeof(SrnLogger));
+    g_mutex_init(&logger->mutex);
     logger->cfg = cfg;
 
     return logger;
 }
 
 void srn_logger_free(SrnLogger *logger){
+    g_mutex_clear(&logger->mutex);
     g_free(logger);
 }
 
@@ -91,7 +98,10 @@ SrnLogger* srn_logger_get_default(void) {
 }
 
 void srn_logger_set_config(SrnLogger *logger, SrnLoggerConfig *cfg) {
+    // Old config can be freed once this function returns
+    g_mutex_lock(&logger->mutex);
     logger->cfg = cfg;
+    g_mutex_unlock(&logger->mutex);
 }
 
 SrnLoggerConfig *srn_logger_get_config(SrnLogger *logger) {
@@ -105,7 +115,13 @@ void srn_logger_log(SrnLogger *logger, SrnLogLevel lv, bool print_prompt,
     GString *prompt;
     GString *output;
 
-    if (!file || !is_enabled(logger->cfg, lv, file)) {
+    if (!file) {
+        return;
+    }
+
+    g_mutex_lock(&logger->mutex);
+    if (!is_enabled(logger->cfg, lv, file)) {
+        g_mutex_unlock(&logger->mutex);
         return;
     }
 
@@ -151,6 +167,8 @@ void srn_logger_log(SrnLogger *logger, SrnLogLevel lv, bool print_prompt,
         g_fprintf(stdout, "%s", output->str);
     }
 
+    g_mutex_unlock(&logger->mutex);
+
     g_string_free(output, TRUE);
 }
 
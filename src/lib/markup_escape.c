@@ -0,0 +1,270 @@
+/* Copyright (C) 2016-2021 Shengyu Zhang <i@silverrainz.me>
+ *
+ * This file is part of Srain.
+ *
+ * Srain is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file markup_escape.c
+ * @brief Markup escaping compatible with g_markup_escape_text(), but appends
+ * to caller supplied GString and copies clean runs in bulk. Candidate bytes
+ * are located 16 bytes at a time with SSE2 or NEON when available.
+ * @author Shengyu Zhang <i@silverrainz.me>
+ * @version 1.2.0
+ * @date 2021-03-17
+ */
+
+#include <string.h>
+#include <glib.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "srain.h"
+#include "markup_escape.h"
+
+static const char* find_candidate(const char *ptr, const char *end);
+static const char* find_special(const char *ptr, const char *end, int *size);
+static bool is_candidate(guchar c);
+
+/**
+ * @brief srn_markup_escape_append escapes text and appends it to str, the
+ * result is the same as g_markup_escape_text().
+ *
+ * @param str
+ * @param text is a valid UTF-8 string.
+ * @param len is length of text in bytes, -1 if text is NUL-terminated.
+ */
+void srn_markup_escape_append(GString *str, const char *text, int len){
+    const char *ptr;
+    const char *end;
+
+    g_return_if_fail(text);
+
+    if (len < 0){
+        len = strlen(text);
+    }
+
+    ptr = text;
+    end = text + len;
+    while (ptr < end){
+        int size;
+        guint32 c;
+        const char *special;
+
+        special = find_special(ptr, end, &size);
+        g_string_append_len(str, ptr, special - ptr);
+        if (special == end){
+            break;
+        }
+
+        switch (*special){
+            case '&':
+                g_string_append(str, "&amp;");
+                break;
+            case '<':
+                g_string_append(str, "&lt;");
+                break;
+            case '>':
+                g_string_append(str, "&gt;");
+                break;
+            case '\'':
+                g_string_append(str, "&#39;");
+                break;
+            case '"':
+                g_string_append(str, "&quot;");
+                break;
+            default:
+                // Control characters, including C1 ones encoded in 2 bytes
+                c = size == 1
+                    ? (guchar)special[0]
+                    : (guchar)special[1];
+                g_string_append_printf(str, "&#x%x;", c);
+        }
+        ptr = special + size;
+    }
+}
+
+/**
+ * @brief srn_markup_escape is a drop-in replacement of
+ * g_markup_escape_text().
+ *
+ * @param text
+ * @param len
+ *
+ * @return A newly allocated string.
+ */
+char* srn_markup_escape(const char *text, int len){
+    GString *str;
+
+    g_return_val_if_fail(text, NULL);
+
+    if (len < 0){
+        len = strlen(text);
+    }
+    str = g_string_sized_new(len + 16);
+    srn_markup_escape_append(str, text, len);
+
+    return g_string_free(str, FALSE);
+}
+
+/**
+ * @brief srn_markup_need_escape returns whether the text would be changed
+ * by escaping.
+ *
+ * @param text
+ * @param len
+ *
+ * @return
+ */
+bool srn_markup_need_escape(const char *text, int len){
+    int size;
+
+    g_return_val_if_fail(text, FALSE);
+
+    if (len < 0){
+        len = strlen(text);
+    }
+
+    return find_special(text, text + len, &size) != text + len;
+}
+
+/**
+ * @brief find_special finds the first character should be escaped.
+ *
+ * @param ptr
+ * @param end
+ * @param size returns size of the character in bytes.
+ *
+ * @return Pointer to the character, end if none.
+ */
+static const char* find_special(const char *ptr, const char *end, int *size){
+    for (ptr = find_candidate(ptr, end); ptr < end;
+            ptr = find_candidate(ptr, end)){
+        guchar c;
+
+        c = ptr[0];
+        *size = 1;
+        switch (c){
+            case '\t':
+            case '\n':
+            case '\r':
+                break;
+            case 0xc2:
+                // U+0080 ~ U+009F except U+0085 (NEL)
+                if (ptr + 1 < end
+                        && (guchar)ptr[1] >= 0x80 && (guchar)ptr[1] <= 0x9f
+                        && (guchar)ptr[1] != 0x85){
+                    *size = 2;
+                    return ptr;
+                }
+                break;
+            default:
+                // Other candidates are always escaped, except NUL which
+                // is not valid in markup at all
+                if (c != '\0'){
+                    return ptr;
+                }
+        }
+        ptr++;
+    }
+
+    return end;
+}
+
+/**
+ * @brief find_candidate finds the first byte might need escaping: "&<>'\"",
+ * ASCII control characters, DEL and the lead byte of C1 control characters.
+ */
+static const char* find_candidate(const char *ptr, const char *end){
+#if defined(__SSE2__)
+    const __m128i amp = _mm_set1_epi8('&');
+    const __m128i lt = _mm_set1_epi8('<');
+    const __m128i gt = _mm_set1_epi8('>');
+    const __m128i apos = _mm_set1_epi8('\'');
+    const __m128i quot = _mm_set1_epi8('"');
+    const __m128i del = _mm_set1_epi8(0x7f);
+    const __m128i c1 = _mm_set1_epi8((char)0xc2);
+    const __m128i ctrl = _mm_set1_epi8(0x1f);
+
+    for (; end - ptr >= 16; ptr += 16){
+        int mask;
+        __m128i v;
+        __m128i hit;
+
+        v = _mm_loadu_si128((const __m128i *)ptr);
+        hit = _mm_or_si128(_mm_cmpeq_epi8(v, amp), _mm_cmpeq_epi8(v, lt));
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, gt));
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, apos));
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, quot));
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, del));
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, c1));
+        // Unsigned v <= 0x1f
+        hit = _mm_or_si128(hit,
+                _mm_cmpeq_epi8(_mm_min_epu8(v, ctrl), v));
+
+        mask = _mm_movemask_epi8(hit);
+        if (mask){
+            return ptr + __builtin_ctz(mask);
+        }
+    }
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+    for (; end - ptr >= 16; ptr += 16){
+        uint8x16_t v;
+        uint8x16_t hit;
+
+        v = vld1q_u8((const uint8_t *)ptr);
+        hit = vorrq_u8(vceqq_u8(v, vdupq_n_u8('&')),
+                vceqq_u8(v, vdupq_n_u8('<')));
+        hit = vorrq_u8(hit, vceqq_u8(v, vdupq_n_u8('>')));
+        hit = vorrq_u8(hit, vceqq_u8(v, vdupq_n_u8('\'')));
+        hit = vorrq_u8(hit, vceqq_u8(v, vdupq_n_u8('"')));
+        hit = vorrq_u8(hit, vceqq_u8(v, vdupq_n_u8(0x7f)));
+        hit = vorrq_u8(hit, vceqq_u8(v, vdupq_n_u8(0xc2)));
+        hit = vorrq_u8(hit, vcleq_u8(v, vdupq_n_u8(0x1f)));
+
+        if (vmaxvq_u8(hit)){
+            // Locate the byte in scalar loop below
+            break;
+        }
+    }
+#endif
+
+    for (; ptr < end; ptr++){
+        if (is_candidate(*ptr)){
+            return ptr;
+        }
+    }
+
+    return end;
+}
+
+static bool is_candidate(guchar c){
+    switch (c){
+        case '&':
+        case '<':
+        case '>':
+        case '\'':
+        case '"':
+        case 0x7f:
+        case 0xc2:
+            return TRUE;
+        default:
+            return c <= 0x1f;
+    }
+}
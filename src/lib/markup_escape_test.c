@@ -0,0 +1,245 @@
+/* Copyright (C) 2016-2021 Shengyu Zhang <i@silverrainz.me>
+ *
+ * This file is part of Srain.
+ *
+ * Srain is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file markup_escape_test.c
+ * @brief Test case for markup_escape.c, the result should be the same as
+ * g_markup_escape_text().
+ * @author Shengyu Zhang <i@silverrainz.me>
+ * @version 1.2.0
+ * @date 2021-03-20
+ *
+ * Run "markup_escape_test -m perf" for a comparison of their throughput on
+ * a large buffer. The buffer is made of bench/session.log under
+ * G_TEST_SRCDIR, or of the file given by SRN_BENCH_SESSION.
+ */
+
+#include <string.h>
+#include <glib.h>
+
+#include "srain.h"
+#include "markup_escape.h"
+
+/* Longer than two SIMD blocks so that both block and tail paths are hit */
+#define MAX_OFFSET  40
+
+#define PERF_SIZE   (16 * 1024 * 1024) // Size of buffer to escape
+#define PERF_ROUND  10
+
+static const char *specials[] = {
+    "&", "<", ">", "'", "\"",
+    "\x01", "\x08", "\t", "\n", "\x0b", "\x0c", "\r", "\x1b", "\x1f",
+    "\x7f",
+    "\xc2\x80", "\xc2\x84", "\xc2\x85", "\xc2\x9f", "\xc2\xa0", "\xc2\xbf",
+    "\xc3\xa9", "\xe4\xbd\xa0", "\xf0\x9f\x98\x80",
+};
+
+static const char *samples[] = {
+    "",
+    "plain text",
+    "<b>bold</b> & 'single' \"double\"",
+    "&amp; is already escaped",
+    "tab\tnew line\ncarriage return\r",
+    "\x02" "bold" "\x02 \x03" "4red\x0f \x1d" "italic\x1d",
+    "你好，世界！<>&'\"",
+    "\xc2\x80\xc2\x85\xc2\x9f\xc2\xa0\xc3\x80\xc3\x9f",
+    "0123456789abcde&0123456789abcdef<0123456789abcdef>",
+};
+
+static void test_samples(void);
+static void test_offsets(void);
+static void test_nul(void);
+static void test_append(void);
+static void test_perf(void);
+static void assert_escape(const char *text, int len);
+
+int main(int argc, char *argv[]){
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/markup_escape/samples", test_samples);
+    g_test_add_func("/markup_escape/offsets", test_offsets);
+    g_test_add_func("/markup_escape/nul", test_nul);
+    g_test_add_func("/markup_escape/append", test_append);
+    if (g_test_perf()){
+        g_test_add_func("/markup_escape/perf", test_perf);
+    }
+
+    return g_test_run();
+}
+
+static void test_samples(void){
+    for (int i = 0; i < G_N_ELEMENTS(samples); i++){
+        assert_escape(samples[i], -1);
+    }
+}
+
+/* Every special character at every offset around the 16 bytes blocks */
+static void test_offsets(void){
+    GString *str;
+
+    str = g_string_new(NULL);
+    for (int i = 0; i < G_N_ELEMENTS(specials); i++){
+        for (int offset = 0; offset <= MAX_OFFSET; offset++){
+            for (int tail = 0; tail <= 17; tail++){
+                g_string_truncate(str, 0);
+                for (int j = 0; j < offset; j++){
+                    g_string_append_c(str, 'a' + j % 26);
+                }
+                g_string_append(str, specials[i]);
+                for (int j = 0; j < tail; j++){
+                    g_string_append_c(str, 'z' - j % 26);
+                }
+                assert_escape(str->str, str->len);
+            }
+        }
+    }
+    g_string_free(str, TRUE);
+}
+
+/* NUL is copied as is, like g_markup_escape_text() */
+static void test_nul(void){
+    const char text[] = "<a>\0&b\0\0'c\"";
+    GString *str;
+    GString *expected;
+
+    str = g_string_new(NULL);
+    srn_markup_escape_append(str, text, sizeof(text) - 1);
+
+    expected = g_string_new(NULL);
+    for (const char *ptr = text; ptr < text + sizeof(text) - 1;
+            ptr += strlen(ptr) + 1){
+        char *escaped;
+
+        assert_escape(ptr, -1);
+        escaped = srn_markup_escape(ptr, -1);
+        g_string_append(expected, escaped);
+        g_string_append_c(expected, '\0');
+        g_free(escaped);
+    }
+    // The last segment is not followed by NUL
+    g_string_truncate(expected, expected->len - 1);
+
+    g_assert_cmpmem(str->str, str->len, expected->str, expected->len);
+    g_assert_true(srn_markup_need_escape(text, 3));
+    g_assert_false(srn_markup_need_escape(text + 3, 1));
+
+    g_string_free(expected, TRUE);
+    g_string_free(str, TRUE);
+}
+
+static void test_append(void){
+    char *escaped;
+    GString *str;
+
+    str = g_string_new("<prefix>");
+    srn_markup_escape_append(str, "<b>&</b>", 3);
+    g_assert_cmpstr(str->str, ==, "<prefix>&lt;b&gt;");
+    g_string_free(str, TRUE);
+
+    // The lead byte of C1 control at the end is not read beyond len
+    escaped = srn_markup_escape("a\xc2\x80", 2);
+    g_assert_cmpmem(escaped, strlen(escaped), "a\xc2", 2);
+    g_free(escaped);
+}
+
+static void test_perf(void){
+    double srn;
+    double glib;
+    char *path;
+    char *data;
+    gsize len;
+    GError *err;
+    GString *buf;
+    GTimer *timer;
+
+    if (g_getenv("SRN_BENCH_SESSION")){
+        path = g_strdup(g_getenv("SRN_BENCH_SESSION"));
+    } else {
+        path = g_test_build_filename(G_TEST_DIST, "bench", "session.log",
+                NULL);
+    }
+    err = NULL;
+    if (!g_file_get_contents(path, &data, &len, &err)){
+        g_test_skip(err->message);
+        g_error_free(err);
+        g_free(path);
+        return;
+    }
+    g_assert_cmpuint(len, >, 0);
+
+    buf = g_string_sized_new(PERF_SIZE + len);
+    while (buf->len < PERF_SIZE){
+        g_string_append_len(buf, data, len);
+    }
+    g_free(data);
+
+    timer = g_timer_new();
+    for (int i = 0; i < PERF_ROUND; i++){
+        g_free(g_markup_escape_text(buf->str, buf->len));
+    }
+    glib = buf->len * PERF_ROUND / g_timer_elapsed(timer, NULL) / 1e6;
+
+    g_timer_start(timer);
+    for (int i = 0; i < PERF_ROUND; i++){
+        g_free(srn_markup_escape(buf->str, buf->len));
+    }
+    srn = buf->len * PERF_ROUND / g_timer_elapsed(timer, NULL) / 1e6;
+
+    g_test_maximized_result(srn,
+            "Escaping %zu bytes of %s: %.1f MB/s with srn_markup_escape(), "
+            "%.1f MB/s with g_markup_escape_text()",
+            buf->len, path, srn, glib);
+
+    g_timer_destroy(timer);
+    g_string_free(buf, TRUE);
+    g_free(path);
+}
+
+/**
+ * @brief assert_escape asserts that srn_markup_escape() and
+ * srn_markup_need_escape() agree with g_markup_escape_text().
+ *
+ * @param text must not contain NUL in the first len bytes.
+ * @param len
+ */
+static void assert_escape(const char *text, int len){
+    char *actual;
+    char *expected;
+    char **parts;
+
+    if (len < 0){
+        len = strlen(text);
+    }
+
+    actual = srn_markup_escape(text, len);
+    expected = g_markup_escape_text(text, len);
+
+    // GLib escapes "'" as "&apos;" or "&#39;" depending on its version
+    parts = g_strsplit(expected, "&apos;", -1);
+    g_free(expected);
+    expected = g_strjoinv("&#39;", parts);
+    g_strfreev(parts);
+
+    g_assert_cmpstr(actual, ==, expected);
+
+    g_assert_true(srn_markup_need_escape(text, len)
+            == (strlen(actual) != len || memcmp(actual, text, len) != 0));
+
+    g_free(actual);
+    g_free(expected);
+}
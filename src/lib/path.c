@@ -239,6 +239,38 @@ char *srn_create_log_file(const char *srv_name, const char *fname){
     return path;
 }
 
+/**
+ * @brief srn_create_snapshot_file creates scrollback snapshot file of
+ * specified chat if not exist.
+ *
+ * @param srv_name
+ * @param fname
+ *
+ * @return NULL or path to the snapshot file:
+ * $XDG_CACHE_HOME/srain/snapshots/<srv_name>/<fname>, must be freed by
+ * g_free.
+ */
+char *srn_create_snapshot_file(const char *srv_name, const char *fname){
+    char *path;
+    SrnRet ret;
+
+    path = g_build_filename(g_get_user_cache_dir(), PACKAGE, "snapshots",
+            srv_name, fname, NULL);
+    if (!path){
+        return NULL;
+    }
+
+    ret = create_file_if_not_exist(path);
+    if (!RET_IS_OK(ret)){
+        WARN_FR("Failed to create snapshot file: %1$s", RET_MSG(ret));
+
+        g_free(path);
+        return NULL;
+    }
+
+    return path;
+}
+
 /**
  * @brief srn_create_user_files creates users files which required for
  *  running of Srain
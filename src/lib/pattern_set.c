@@ -34,6 +34,19 @@
 
 struct _SrnPatternSet {
     GHashTable *table;
+    unsigned serial; // Increased when any pattern is added or removed
+};
+
+/**
+ * @brief SrnPatternList is an ordered list of pattern names, the named
+ * regexes are looked up from pattern set only when the list or the set is
+ * changed.
+ */
+struct _SrnPatternList {
+    SrnPatternSet *set;
+    GList *names;
+    GPtrArray *regexes; // Referenced GRegex, NULL if outdated
+    unsigned serial;    // Serial of pattern set when regexes are looked up
 };
 
 SrnPatternSet* srn_pattern_set_new(void) {
@@ -69,6 +82,7 @@ SrnRet srn_pattern_set_add(SrnPatternSet *self, const char *name,
         return ret;
     }
     g_hash_table_insert(self->table, g_strdup(name), regex);
+    self->serial++;
 
     return SRN_OK;
 }
@@ -78,7 +92,12 @@ GRegex *srn_pattern_set_get(SrnPatternSet *self, const char *name) {
 }
 
 SrnRet srn_pattern_set_rm(SrnPatternSet *self, const char *name) {
-    return g_hash_table_remove(self->table, name) ? SRN_OK : SRN_ERR;
+    if (!g_hash_table_remove(self->table, name)) {
+        return SRN_ERR;
+    }
+    self->serial++;
+
+    return SRN_OK;
 }
 
 /**
@@ -103,3 +122,94 @@ GList* srn_pattern_set_list(SrnPatternSet *self) {
 
     return lst;
 }
+
+SrnPatternList* srn_pattern_list_new(SrnPatternSet *set) {
+    SrnPatternList *self;
+
+    self = g_malloc0(sizeof(SrnPatternList));
+    self->set = set;
+
+    return self;
+}
+
+void srn_pattern_list_free(SrnPatternList *self) {
+    g_list_free_full(self->names, g_free);
+    if (self->regexes) {
+        g_ptr_array_free(self->regexes, TRUE);
+    }
+    g_free(self);
+}
+
+SrnRet srn_pattern_list_add(SrnPatternList *self, const char *name) {
+    for (GList *lst = self->names; lst; lst = g_list_next(lst)) {
+        if (g_ascii_strcasecmp(lst->data, name) == 0) {
+            return SRN_ERR;
+        }
+    }
+
+    self->names = g_list_append(self->names, g_strdup(name));
+    if (self->regexes) {
+        g_ptr_array_free(self->regexes, TRUE);
+        self->regexes = NULL;
+    }
+
+    return SRN_OK;
+}
+
+SrnRet srn_pattern_list_rm(SrnPatternList *self, const char *name) {
+    GList *lst;
+
+    for (lst = self->names; lst; lst = g_list_next(lst)) {
+        if (g_ascii_strcasecmp(lst->data, name) == 0) {
+            break;
+        }
+    }
+    if (!lst) {
+        return SRN_ERR;
+    }
+
+    g_free(lst->data);
+    self->names = g_list_delete_link(self->names, lst);
+    if (self->regexes) {
+        g_ptr_array_free(self->regexes, TRUE);
+        self->regexes = NULL;
+    }
+
+    return SRN_OK;
+}
+
+int srn_pattern_list_get_length(SrnPatternList *self) {
+    return g_list_length(self->names);
+}
+
+/**
+ * @brief srn_pattern_list_get_regexes returns regexes of all patterns in
+ * list which exist in pattern set, in order of the list.
+ *
+ * @param self
+ *
+ * @return A GPtrArray which contains GRegex, it is owned by the list and
+ * is valid until the list or its pattern set is changed.
+ */
+GPtrArray* srn_pattern_list_get_regexes(SrnPatternList *self) {
+    if (self->regexes && self->serial == self->set->serial) {
+        return self->regexes;
+    }
+
+    if (self->regexes) {
+        g_ptr_array_free(self->regexes, TRUE);
+    }
+    self->regexes = g_ptr_array_new_with_free_func(
+            (GDestroyNotify)g_regex_unref);
+    self->serial = self->set->serial;
+    for (GList *lst = self->names; lst; lst = g_list_next(lst)) {
+        GRegex *regex;
+
+        regex = srn_pattern_set_get(self->set, lst->data);
+        if (regex) {
+            g_ptr_array_add(self->regexes, g_regex_ref(regex));
+        }
+    }
+
+    return self->regexes;
+}
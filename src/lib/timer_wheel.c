@@ -0,0 +1,217 @@
+/* Copyright (C) 2016-2021 Shengyu Zhang <i@silverrainz.me>
+ *
+ * This file is part of Srain.
+ *
+ * Srain is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file timer_wheel.c
+ * @brief A hashed timer wheel, timers are put into slots by their deadlines
+ * and all of them are driven by one g_timeout_add_seconds() source, which
+ * only exists when there is any timer.
+ * @author Shengyu Zhang <i@silverrainz.me>
+ * @version 1.2.0
+ * @date 2021-03-13
+ */
+
+#include <glib.h>
+
+#include "srain.h"
+#include "log.h"
+#include "timer_wheel.h"
+
+/* Number of slots, timers whose deadlines are more than SLOT_COUNT ticks
+ * later share slot with nearer timers and are skipped until expired */
+#define SLOT_COUNT  64
+
+typedef struct _SrnTimer SrnTimer;
+
+struct _SrnTimer {
+    unsigned id;
+    const char *name;   // For debugging, must be a static string
+    unsigned ticks;     // Interval, in seconds
+    guint64 deadline;   // Tick when timer expires
+    GSourceFunc func;
+    gpointer user_data;
+    bool cancelled;     // Removed while being dispatched
+};
+
+struct _SrnTimerWheel {
+    GList *slots[SLOT_COUNT];   // List of SrnTimer
+    GHashTable *timer_table;    // ID -> SrnTimer
+    guint64 tick;
+    unsigned last_id;
+    int source;
+};
+
+static void schedule_timer(SrnTimerWheel *self, SrnTimer *timer);
+static gboolean tick_timeout(gpointer user_data);
+
+SrnTimerWheel* srn_timer_wheel_new(void){
+    SrnTimerWheel *self;
+
+    self = g_malloc0(sizeof(SrnTimerWheel));
+    self->timer_table = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+    return self;
+}
+
+void srn_timer_wheel_free(SrnTimerWheel *self){
+    if (self->source){
+        g_source_remove(self->source);
+        self->source = 0;
+    }
+    for (int i = 0; i < SLOT_COUNT; i++){
+        g_list_free_full(self->slots[i], g_free);
+    }
+    g_hash_table_destroy(self->timer_table);
+    g_free(self);
+}
+
+/**
+ * @brief srn_timer_wheel_add adds a timer to wheel, its callback is called
+ * repeatedly until it returns G_SOURCE_REMOVE or the timer is removed.
+ *
+ * @param self
+ * @param name is used for debugging, must be a static string.
+ * @param interval is the time between calls, in milliseconds, it is rounded
+ *      up to whole seconds.
+ * @param func
+ * @param user_data
+ *
+ * @return ID of timer, always greater than 0.
+ */
+unsigned srn_timer_wheel_add(SrnTimerWheel *self, const char *name,
+        unsigned interval, GSourceFunc func, gpointer user_data){
+    SrnTimer *timer;
+
+    g_return_val_if_fail(func, 0);
+
+    timer = g_malloc0(sizeof(SrnTimer));
+    timer->id = ++self->last_id;
+    timer->name = name;
+    timer->ticks = MAX((interval + 999) / 1000, 1);
+    timer->func = func;
+    timer->user_data = user_data;
+
+    g_hash_table_insert(self->timer_table, GUINT_TO_POINTER(timer->id), timer);
+    schedule_timer(self, timer);
+
+    if (!self->source){
+        self->source = g_timeout_add_seconds(1, tick_timeout, self);
+    }
+
+    return timer->id;
+}
+
+/**
+ * @brief srn_timer_wheel_remove removes a timer from wheel.
+ *
+ * @param self
+ * @param id
+ *
+ * @return FALSE if no such timer.
+ */
+bool srn_timer_wheel_remove(SrnTimerWheel *self, unsigned id){
+    GList *lst;
+    GList **slot;
+    SrnTimer *timer;
+
+    timer = g_hash_table_lookup(self->timer_table, GUINT_TO_POINTER(id));
+    if (!timer){
+        return FALSE;
+    }
+    g_hash_table_remove(self->timer_table, GUINT_TO_POINTER(id));
+
+    slot = &self->slots[timer->deadline % SLOT_COUNT];
+    lst = g_list_find(*slot, timer);
+    if (lst){
+        *slot = g_list_delete_link(*slot, lst);
+        g_free(timer);
+    } else {
+        // Timer is being dispatched, it will be freed by tick_timeout()
+        timer->cancelled = TRUE;
+    }
+
+    return TRUE;
+}
+
+static void schedule_timer(SrnTimerWheel *self, SrnTimer *timer){
+    GList **slot;
+
+    timer->deadline = self->tick + timer->ticks;
+    slot = &self->slots[timer->deadline % SLOT_COUNT];
+    *slot = g_list_prepend(*slot, timer);
+}
+
+static gboolean tick_timeout(gpointer user_data){
+    GList *lst;
+    GList *expired;
+    GList **slot;
+    SrnTimerWheel *self;
+
+    self = user_data;
+    self->tick++;
+
+    /* Take expired timers out of slot first, callbacks may add or remove
+     * timers */
+    expired = NULL;
+    slot = &self->slots[self->tick % SLOT_COUNT];
+    lst = *slot;
+    while (lst){
+        GList *next;
+        SrnTimer *timer;
+
+        next = g_list_next(lst);
+        timer = lst->data;
+        if (timer->deadline <= self->tick){
+            *slot = g_list_remove_link(*slot, lst);
+            expired = g_list_concat(lst, expired);
+        }
+        lst = next;
+    }
+
+    lst = expired;
+    while (lst){
+        SrnTimer *timer;
+
+        timer = lst->data;
+        lst = g_list_next(lst);
+
+        if (!timer->cancelled){
+            DBG_FR("Timer %u (%s) expired at tick %" G_GUINT64_FORMAT,
+                    timer->id, timer->name, self->tick);
+            if (timer->func(timer->user_data) == G_SOURCE_CONTINUE){
+                if (!timer->cancelled){
+                    schedule_timer(self, timer);
+                    continue;
+                }
+            } else if (!timer->cancelled){
+                g_hash_table_remove(self->timer_table,
+                        GUINT_TO_POINTER(timer->id));
+            }
+        }
+        g_free(timer);
+    }
+    g_list_free(expired);
+
+    if (g_hash_table_size(self->timer_table) == 0){
+        DBG_FR("No timer in wheel, stop ticking");
+        self->source = 0;
+        return G_SOURCE_REMOVE;
+    }
+
+    return G_SOURCE_CONTINUE;
+}
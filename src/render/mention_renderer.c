@@ -21,146 +21,240 @@
 #include <string.h>
 
 #include "core/core.h"
-#include "markup_renderer.h"
 #include "i18n.h"
+#include "log.h"
+#include "intern.h"
+#include "keyword_matcher.h"
 
 #include "./renderer.h"
 
-struct Context {
-    SrnMessage *message;
-    GRegex *pattern;
+#define MATCHER_KEY "mention-matcher"
+
+typedef struct _MentionMatcher MentionMatcher;
+typedef struct _MentionMatch MentionMatch;
+
+enum {
+    KEYWORD_HIGHLIGHT,
+    KEYWORD_NEVER_HIGHLIGHT,
+};
+
+/**
+ * @brief MentionMatcher is cached in extra data of chat, it is rebuilt when
+ * our nick changes or chat config is reloaded. It is never modified after
+ * built, messages being rendered hold references to it, see prepare().
+ */
+struct _MentionMatcher {
+    int refcount;
+    const char *nick; // Interned
+    SrnKeywordMatcher *matcher;
+    SrnRenderScan first_bytes; // First bytes of highlighted keywords
+};
+
+struct _MentionMatch {
+    int start;
+    int end;
+    int tag;
 };
 
 static void init(void);
 static void finalize(void);
-static SrnRet render(SrnMessage *msg);
-static void text(GMarkupParseContext *context, const gchar *text,
-        gsize text_len, gpointer user_data, GError **error);
-static bool on_regex_replace(const GMatchInfo *match_info, GString *result,
-        gpointer user_data);
+static SrnRet render(SrnMessage *msg, SrnRenderText *text, void *state);
+static bool may_render(SrnMessage *msg, const SrnRenderScan *scan, void *state);
+static void* prepare(SrnChat *chat);
+static void release(void *state);
+static void invalidate(SrnExtraData *extra_data);
 
-static SrnMarkupRenderer *markup_renderer;
+static MentionMatcher* mention_matcher_new(SrnChat *chat, const char *nick);
+static MentionMatcher* mention_matcher_ref(MentionMatcher *self);
+static void mention_matcher_unref(MentionMatcher *self);
+static void mention_matcher_add(MentionMatcher *self, const char *keyword,
+        int tag);
+static void on_match(int start, int end, int tag, gpointer user_data);
 
 SrnMessageRenderer mention_renderer = {
     .name = "mention",
     .init = init,
     .finalize = finalize,
     .render = render,
+    .may_render = may_render,
+    .prepare = prepare,
+    .release = release,
+    .invalidate = invalidate,
 };
 
 void init(void) {
-    GMarkupParser *parser;
-
-    markup_renderer = srn_markup_renderer_new();
-    parser = srn_markup_renderer_get_markup_parser(markup_renderer);
-    parser->text = text;
 }
 
 void finalize(void) {
-    srn_markup_renderer_free(markup_renderer);
 }
 
-SrnRet render(SrnMessage *msg) {
-    char *nick = NULL;
-    char *pattern = NULL;
-    char *rendered_content = NULL;
-    GError *err = NULL;
-    GRegex *regex = NULL;
-    SrnRet ret = SRN_OK;
-    struct Context ctx;
+bool may_render(SrnMessage *msg, const SrnRenderScan *scan, void *state) {
+    MentionMatcher *matcher;
+
+    matcher = state;
+    if (!matcher){
+        return TRUE; // Let render() report it
+    }
+    if (msg->mentioned){
+        return FALSE;
+    }
+
+    // No highlighted keyword can start in content
+    return srn_render_scan_intersects(scan, &matcher->first_bytes);
+}
+
+SrnRet render(SrnMessage *msg, SrnRenderText *text, void *state) {
+    GArray *matches;
+    MentionMatcher *matcher;
 
-    g_return_val_if_fail(msg->chat
-            && msg->chat->srv
-            && msg->chat->srv->user, SRN_ERR);
+    matcher = state;
+    g_return_val_if_fail(matcher, SRN_ERR);
 
     if (msg->mentioned){
         return SRN_OK;
     }
 
-    /* Genertate pattern */
-    nick = g_regex_escape_string(msg->chat->srv->user->nick, -1);
-    pattern = g_strdup_printf("\\b%s\\b", nick);
-    regex = g_regex_new(pattern, G_REGEX_CASELESS, 0, &err);
-    if (!regex){
-        ret = RET_ERR(_("g_regex_new() failed: %1$s"), err->message);
-        goto FIN;
-    }
+    matches = g_array_new(FALSE, FALSE, sizeof(MentionMatch));
+    srn_keyword_matcher_match(matcher->matcher, text->str->str, text->str->len,
+            on_match, matches);
 
-    ctx.message = msg;
-    ctx.pattern = regex;
-    ret = srn_markup_renderer_render(markup_renderer,
-            msg->rendered_content, &rendered_content, &ctx);
-    if (!RET_IS_OK(ret)){
-        ret = RET_ERR(_("Failed to render markup text: %1$s"), RET_MSG(ret));
-        goto FIN;
-    }
-    if (rendered_content) {
-        g_free(msg->rendered_content);
-        msg->rendered_content = rendered_content;
-    }
+    for (int i = 0; i < matches->len; i++){
+        bool never;
+        MentionMatch *match;
 
-FIN:
-    if (err) {
-        g_error_free(err);
+        match = &g_array_index(matches, MentionMatch, i);
+        if (match->tag != KEYWORD_HIGHLIGHT){
+            continue;
+        }
+
+        /* Keyword overlaps with a never highlighted word is ignored */
+        never = FALSE;
+        for (int j = 0; j < matches->len; j++){
+            MentionMatch *other;
+
+            other = &g_array_index(matches, MentionMatch, j);
+            if (other->tag == KEYWORD_NEVER_HIGHLIGHT
+                    && other->start < match->end
+                    && match->start < other->end){
+                never = TRUE;
+                break;
+            }
+        }
+        if (never){
+            continue;
+        }
+
+        // Mark as mentioned
+        msg->mentioned = TRUE;
+        srn_render_text_add_span(text, SRN_RENDER_SPAN_MENTION,
+                match->start, match->end, NULL);
     }
-    if (regex){
-        g_regex_unref(regex);
+
+    g_array_free(matches, TRUE);
+
+    return SRN_OK;
+}
+
+static void invalidate(SrnExtraData *extra_data){
+    if (srn_extra_data_get(extra_data, MATCHER_KEY)){
+        srn_extra_data_set(extra_data, MATCHER_KEY, NULL, NULL);
     }
-    if (pattern){
-        g_free(pattern);
+}
+
+/**
+ * @brief prepare returns a reference to matcher of chat, it is built if not
+ * cached or outdated.
+ */
+static void* prepare(SrnChat *chat){
+    const char *nick;
+    MentionMatcher *matcher;
+
+    g_return_val_if_fail(chat->srv && chat->srv->user, NULL);
+
+    nick = chat->srv->user->nick;
+    matcher = srn_extra_data_get(chat->extra_data, MATCHER_KEY);
+    if (matcher && matcher->nick != nick){
+        // Interned strings are equal only if they are the same pointer
+        srn_extra_data_set(chat->extra_data, MATCHER_KEY, NULL, NULL);
+        matcher = NULL;
     }
-    if (nick){
-        g_free(nick);
+    if (!matcher){
+        matcher = mention_matcher_new(chat, nick);
+        srn_extra_data_set(chat->extra_data, MATCHER_KEY, matcher,
+                (GDestroyNotify)mention_matcher_unref);
     }
 
-    return ret;
+    return mention_matcher_ref(matcher);
+}
+
+static void release(void *state){
+    if (state){
+        mention_matcher_unref(state);
+    }
 }
 
-static void text(GMarkupParseContext *context, const gchar *text,
-        gsize text_len, gpointer user_data, GError **error){
-    int cur_pos;
-    struct Context *ctx;
-    GString *markup;
-    GMatchInfo *match_info;
-
-    cur_pos = 0;
-    ctx = srn_markup_renderer_get_user_data(user_data);
-    markup = srn_markup_renderer_get_markup(user_data);
-    g_regex_match_full(ctx->pattern, text, text_len, 0, 0, &match_info, NULL);
-    while(g_match_info_matches(match_info)) {
-        int start_pos, end_pos;
-        char *escaped_nonmatch, *escaped_match;
+static MentionMatcher* mention_matcher_new(SrnChat *chat, const char *nick){
+    MentionMatcher *self;
 
-        // Mark as mentioned
-        ctx->message->mentioned = TRUE;
+    self = g_malloc0(sizeof(MentionMatcher));
+    self->refcount = 1;
+    self->nick = srn_intern(nick);
+    self->matcher = srn_keyword_matcher_new();
+
+    /* Never highlighted words are added first so that they win when a word
+     * is in both lists */
+    for (GList *lst = chat->cfg->never_highlight_list; lst;
+            lst = g_list_next(lst)){
+        mention_matcher_add(self, lst->data, KEYWORD_NEVER_HIGHLIGHT);
+    }
+    mention_matcher_add(self, nick, KEYWORD_HIGHLIGHT);
+    for (GList *lst = chat->cfg->highlight_list; lst; lst = g_list_next(lst)){
+        mention_matcher_add(self, lst->data, KEYWORD_HIGHLIGHT);
+    }
+
+    // Compile it before sharing with worker threads
+    srn_keyword_matcher_compile(self->matcher);
 
-        // Fetch pos [start_pos, end_pos)
-        g_match_info_fetch_pos(match_info, 0, &start_pos, &end_pos);
-        escaped_nonmatch = g_markup_escape_text(text + cur_pos, start_pos - cur_pos);
-        escaped_match = g_markup_escape_text(text + start_pos, end_pos - start_pos);
-        cur_pos = end_pos;
+    DBG_FR("Mention matcher of chat %s built for nick %s", chat->name, nick);
 
-        // Escape non-matched text
-        g_string_append(markup, escaped_nonmatch);
+    return self;
+}
 
-        // Highlight and escape matched text
-        // TODO: Make this color configurable
-        g_string_append(markup, "<span foreground=\"#549ee7\"><b>");
-        g_string_append(markup, escaped_match);
-        g_string_append(markup, "</b></span>");
+static MentionMatcher* mention_matcher_ref(MentionMatcher *self){
+    g_atomic_int_inc(&self->refcount);
 
-        g_free(escaped_nonmatch);
-        g_free(escaped_match);
+    return self;
+}
 
-        g_match_info_next(match_info, NULL);
+static void mention_matcher_unref(MentionMatcher *self){
+    if (!g_atomic_int_dec_and_test(&self->refcount)){
+        return;
     }
-    g_match_info_free(match_info);
-
-    // Deal with the remaining text
-    if (cur_pos < text_len) {
-        char *escaped_text;
-        escaped_text = g_markup_escape_text(text + cur_pos, text_len - cur_pos);
-        g_string_append(markup, escaped_text);
-        g_free(escaped_text);
+    srn_keyword_matcher_free(self->matcher);
+    srn_intern_unref(self->nick);
+    g_free(self);
+}
+
+static void mention_matcher_add(MentionMatcher *self, const char *keyword,
+        int tag){
+    guint8 first;
+
+    srn_keyword_matcher_add(self->matcher, keyword, tag);
+    if (tag != KEYWORD_HIGHLIGHT || !keyword[0]){
+        return;
     }
+
+    // Keywords are matched case insensitively
+    first = keyword[0];
+    srn_render_scan_add(&self->first_bytes, g_ascii_tolower(first));
+    srn_render_scan_add(&self->first_bytes, g_ascii_toupper(first));
+}
+
+static void on_match(int start, int end, int tag, gpointer user_data){
+    MentionMatch match;
+
+    match.start = start;
+    match.end = end;
+    match.tag = tag;
+    g_array_append_val((GArray *)user_data, match);
 }
@@ -0,0 +1,88 @@
+/* Copyright (C) 2016-2021 Shengyu Zhang <i@silverrainz.me>
+ *
+ * This file is part of Srain.
+ *
+ * Srain is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file mirc.c
+ * @brief Scanning helpers shared by mIRC renderers.
+ * @author Shengyu Zhang <i@silverrainz.me>
+ * @version 1.2.0
+ * @date 2021-03-16
+ *
+ * ref: https://modern.ircdocs.horse/formatting.html
+ */
+
+#include <string.h>
+#include <glib.h>
+
+#include "srain.h"
+
+#include "./mirc.h"
+
+/**
+ * @brief srn_mirc_find_control finds the first mIRC control character in
+ * string. The plain run before it can be copied in bulk.
+ *
+ * @param str
+ *
+ * @return Pointer to the control character, or to the terminating NUL if
+ * there is none.
+ */
+const char* srn_mirc_find_control(const char *str){
+    // strcspn(3) is vectorized by libc, much faster than a byte loop
+    return str + strcspn(str, MIRC_CONTROLS);
+}
+
+/**
+ * @brief srn_mirc_parse_color parses the color code following MIRC_COLOR,
+ * in format "[fg_color[,bg_color]]", each color has at most 2 digits.
+ *
+ * @param str points to the character after MIRC_COLOR.
+ * @param fg_color returns foreground color, -1 if absent.
+ * @param bg_color returns background color, -1 if absent.
+ *
+ * @return Pointer to the first character after the color code.
+ */
+const char* srn_mirc_parse_color(const char *str, int *fg_color, int *bg_color){
+    int fg;
+    int bg;
+
+    fg = -1;
+    bg = -1;
+    if (g_ascii_isdigit(str[0])){
+        fg = str[0] - '0';
+        str++;
+        if (g_ascii_isdigit(str[0])){
+            fg = fg * 10 + str[0] - '0';
+            str++;
+        }
+        // Comma without following digit is a part of text
+        if (str[0] == ',' && g_ascii_isdigit(str[1])){
+            bg = str[1] - '0';
+            str += 2;
+            if (g_ascii_isdigit(str[0])){
+                bg = bg * 10 + str[0] - '0';
+                str++;
+            }
+        }
+    }
+
+    if (fg_color) *fg_color = fg;
+    if (bg_color) *bg_color = bg;
+
+    return str;
+}
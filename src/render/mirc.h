@@ -27,6 +27,11 @@
 #define MIRC_BLINK      0x06
 #define MIRC_PLAIN      0x0F
 #define MIRC_COLOR      0x03
+#define MIRC_STRIKETHROUGH  0x1E
+#define MIRC_MONOSPACE  0x11
+
+/* All control characters above, for strcspn(3) */
+#define MIRC_CONTROLS   "\x02\x03\x06\x0F\x11\x16\x1D\x1E\x1F"
 
 /* mIRC color code */
 enum {
@@ -49,4 +54,7 @@ enum {
     MIRC_COLOR_UNKNOWN      = 16, // Not a part of protocol, just for convenience
 };
 
+const char* srn_mirc_find_control(const char *str);
+const char* srn_mirc_parse_color(const char *str, int *fg_color, int *bg_color);
+
 #endif /* __MIRC_H */
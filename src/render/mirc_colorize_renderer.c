@@ -16,35 +16,44 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include <stdlib.h>
 #include <glib.h>
 #include <string.h>
 
 #include "srain.h"
 #include "log.h"
 #include "i18n.h"
-#include "markup_renderer.h"
 
 #include "render/render.h"
 #include "./renderer.h"
 #include "./mirc.h"
 
-#define MAX_CTX_STACK_SIZE 128
+typedef enum {
+    STYLE_BOLD,
+    STYLE_ITALICS,
+    STYLE_UNDERLINE,
+    STYLE_STRIKETHROUGH,
+    STYLE_MONOSPACE,
+    STYLE_FOREGROUND,
+    STYLE_BACKGROUND,
+    STYLE_MAX,
+} ColorizeStyle;
 
 typedef struct _ColorlizeContext {
-    int stack[MAX_CTX_STACK_SIZE];
-    int ptr; // Stack pointer
+    SrnRenderText *text;
+    int len; // Length of plain text built so far
+    int starts[STYLE_MAX]; // Start offset of each style, -1 if not applied
     unsigned fg_color;
     unsigned bg_color;
-    GString *str;
 } ColorlizeContext;
 
 static void init(void);
 static void finalize(void);
-static SrnRet render(SrnMessage *msg);
-static void text(GMarkupParseContext *context, const gchar *text,
-        gsize text_len, gpointer user_data, GError **error);
-static void do_colorize(ColorlizeContext *ctx, char ch);
+static SrnRet render(SrnMessage *msg, SrnRenderText *text, void *state);
+static bool may_render(SrnMessage *msg, const SrnRenderScan *scan, void *state);
+static void toggle_style(ColorlizeContext *ctx, ColorizeStyle style);
+static void set_color(ColorlizeContext *ctx, unsigned fg_color, unsigned bg_color);
+static void end_style(ColorlizeContext *ctx, ColorizeStyle style);
+static void end_all_styles(ColorlizeContext *ctx);
 
 /**
  * @brief mirc_strip_renderer is a render moduele for rendering mIRC color in
@@ -57,6 +66,7 @@ SrnMessageRenderer mirc_colorize_renderer = {
     .init = init,
     .finalize = finalize,
     .render = render,
+    .may_render = may_render,
 };
 
 // TODO: define in theme CSS?
@@ -80,237 +90,194 @@ static const char *color_map[] = {
     [MIRC_COLOR_UNKNOWN]        = "", // Preventing out of bound
 };
 
-static SrnMarkupRenderer *markup_renderer;
-
 void init(void) {
-    GMarkupParser *parser;
-
-    markup_renderer = srn_markup_renderer_new();
-    parser = srn_markup_renderer_get_markup_parser(markup_renderer);
-    parser->text = text;
 }
 
 void finalize(void) {
-    srn_markup_renderer_free(markup_renderer);
 }
 
-SrnRet render(SrnMessage *msg) {
-    char *rendered_content;
-    SrnRet ret;
+bool may_render(SrnMessage *msg, const SrnRenderScan *scan, void *state) {
+    return srn_render_scan_has_any(scan, MIRC_CONTROLS);
+}
 
-    rendered_content = NULL;
-    ret = srn_markup_renderer_render(markup_renderer,
-            msg->rendered_content, &rendered_content, msg);
-    if (!RET_IS_OK(ret)){
-        return RET_ERR(_("Failed to render markup text: %1$s"), RET_MSG(ret));
-    }
-    if (rendered_content) {
-        g_free(msg->rendered_content);
-        msg->rendered_content = rendered_content;
-    }
+SrnRet render(SrnMessage *msg, SrnRenderText *text, void *state) {
+    char *str;
+    char *dst;
+    const char *src;
+    ColorlizeContext ctx;
 
-    return SRN_OK;
-}
+    // Offsets of text are changed, spans can not be kept
+    g_warn_if_fail(text->spans->len == 0);
 
-void text(GMarkupParseContext *context, const gchar *text,
-        gsize text_len, gpointer user_data, GError **error) {
-    ColorlizeContext *ctx;
+    str = text->str->str;
+    src = srn_mirc_find_control(str);
+    if (*src == '\0'){
+        // No control character, the common case
+        return SRN_OK;
+    }
 
-    ctx = g_malloc0(sizeof(ColorlizeContext));
-    ctx->fg_color = MIRC_COLOR_UNKNOWN;
-    ctx->bg_color = MIRC_COLOR_UNKNOWN;
-    ctx->str = srn_markup_renderer_get_markup(user_data);
+    ctx.text = text;
+    ctx.len = src - str;
+    for (int i = 0; i < STYLE_MAX; i++){
+        ctx.starts[i] = -1;
+    }
+    ctx.fg_color = MIRC_COLOR_UNKNOWN;
+    ctx.bg_color = MIRC_COLOR_UNKNOWN;
 
-    for (int i = 0; i < text_len; i++){
-        switch (text[i]){
+    /* Control characters are stripped while scanning, plain runs are moved
+     * forward in place so spans can be added with their final offsets */
+    dst = (char *)src;
+    while (*src != '\0'){
+        const char *next;
+
+        switch (*src){
             case MIRC_COLOR:
                 {
-                    /* Format: "\30[fg_color],[bg_color]",
-                     * 0 <= length of fg_color or bg_color <= 2*/
-                    const char *startptr = &text[i] + 1;
-                    char *endptr = NULL;
-                    bool has_fg_color = FALSE;
-                    bool has_bg_color = FALSE;
-                    unsigned fg_color = strtoul(startptr, &endptr, 10);
-                    if (endptr > startptr){ // Get foreground color
-                        has_fg_color = TRUE;
-                        while (endptr - startptr > 2){ // Wrong number of digits
-                            fg_color = fg_color / 10;
-                            endptr--;
-                        }
-                        DBG_FR("Get foreground color: %u", fg_color);
-                        ctx->fg_color = fg_color;
-                    }
-                    i += endptr - startptr;
-                    if (*endptr == ',') { // background color exists
-                        endptr++;
-                        startptr = endptr;
-                        endptr = NULL;
-                        unsigned bg_color = strtoul(startptr, &endptr, 10);
-                        if (endptr > startptr){ // Get background color
-                            has_bg_color = TRUE;
-                            while (endptr - startptr > 2){ // Wrong number of digits
-                                bg_color = bg_color / 10;
-                                endptr--;
-                            }
-                            DBG_FR("Get background color: %u", bg_color);
-                            ctx->bg_color = bg_color;
-                        }
-                        i += endptr - startptr;
-                    }
-                    if (!has_fg_color && !has_bg_color) { // Clear previous color
-                        ctx->fg_color = MIRC_COLOR_UNKNOWN;
-                        ctx->bg_color = MIRC_COLOR_UNKNOWN;
+                    int fg_color;
+                    int bg_color;
+
+                    src = srn_mirc_parse_color(src + 1, &fg_color, &bg_color);
+                    if (fg_color < 0 && bg_color < 0) { // Clear previous color
+                        set_color(&ctx, MIRC_COLOR_UNKNOWN, MIRC_COLOR_UNKNOWN);
+                    } else {
+                        DBG_FR("Get color: %d,%d", fg_color, bg_color);
+                        set_color(&ctx,
+                                fg_color >= 0 ? fg_color : ctx.fg_color,
+                                bg_color >= 0 ? bg_color : ctx.bg_color);
                     }
-                    do_colorize(ctx, MIRC_COLOR);
                     break;
                 }
             case MIRC_BOLD:
+                toggle_style(&ctx, STYLE_BOLD);
+                src++;
+                break;
             case MIRC_ITALICS:
+                toggle_style(&ctx, STYLE_ITALICS);
+                src++;
+                break;
             case MIRC_UNDERLINE:
-            case MIRC_BLINK:
-            case MIRC_REVERSE:
+                toggle_style(&ctx, STYLE_UNDERLINE);
+                src++;
+                break;
+            case MIRC_STRIKETHROUGH:
+                toggle_style(&ctx, STYLE_STRIKETHROUGH);
+                src++;
+                break;
+            case MIRC_MONOSPACE:
+                toggle_style(&ctx, STYLE_MONOSPACE);
+                src++;
+                break;
             case MIRC_PLAIN:
-                do_colorize(ctx, text[i]);
+                DBG_FR("Reset all format");
+                end_all_styles(&ctx);
+                ctx.fg_color = MIRC_COLOR_UNKNOWN;
+                ctx.bg_color = MIRC_COLOR_UNKNOWN;
+                src++;
                 break;
+            case MIRC_REVERSE:
+            case MIRC_BLINK:
             default:
-                {
-                    // No control character, it is a utf-8 sequence
-                    const char *next = g_utf8_next_char(&text[i]);
-                    char *escape = g_markup_escape_text(&text[i], next - &text[i]);
-                    g_string_append(ctx->str, escape);
-                    g_free(escape);
-                    i += next - &text[i] - 1;
-                    break;
-                }
+                // TODO: Not supported yet
+                src++;
+                break;
         }
+
+        next = srn_mirc_find_control(src);
+        memmove(dst, src, next - src);
+        dst += next - src;
+        ctx.len += next - src;
+        src = next;
     }
+    g_string_truncate(text->str, dst - str);
+
+    end_all_styles(&ctx);
 
-    // Close all unclosed tags
-    do_colorize(ctx, MIRC_PLAIN);
-    g_free(ctx);
+    return SRN_OK;
 }
 
-static void do_colorize(ColorlizeContext *ctx, char ch){
-    int ptr;
-    bool open_tag = TRUE;
+static void toggle_style(ColorlizeContext *ctx, ColorizeStyle style){
+    if (ctx->starts[style] < 0){
+        ctx->starts[style] = ctx->len;
+    } else {
+        end_style(ctx, style);
+    }
+}
 
-    ptr = ctx->ptr - 1;
+static void set_color(ColorlizeContext *ctx, unsigned fg_color, unsigned bg_color){
+    if (fg_color > MIRC_COLOR_UNKNOWN){
+        WARN_FR("Invalid mirc foreground color: %u", fg_color);
+        fg_color = MIRC_COLOR_UNKNOWN;
+    }
+    if (bg_color > MIRC_COLOR_UNKNOWN){
+        WARN_FR("Invalid mirc background color: %u", bg_color);
+        bg_color = MIRC_COLOR_UNKNOWN;
+    }
 
-    if (ch == MIRC_PLAIN){
-        DBG_FR("Reset all format");
-        // Reset color
-        ctx->fg_color = MIRC_COLOR_UNKNOWN;
-        ctx->bg_color = MIRC_COLOR_UNKNOWN;
-        // Clear stack
-        while (ptr >= 0){
-            do_colorize(ctx, ctx->stack[ptr]);
-            ptr--;
+    if (fg_color != ctx->fg_color){
+        end_style(ctx, STYLE_FOREGROUND);
+        ctx->fg_color = fg_color;
+        if (fg_color != MIRC_COLOR_UNKNOWN){
+            ctx->starts[STYLE_FOREGROUND] = ctx->len;
         }
-        return;
     }
-
-    while (ptr >= 0){
-        if (ctx->stack[ptr] == ch){
-            open_tag = FALSE;
-            break;
+    if (bg_color != ctx->bg_color){
+        end_style(ctx, STYLE_BACKGROUND);
+        ctx->bg_color = bg_color;
+        if (bg_color != MIRC_COLOR_UNKNOWN){
+            ctx->starts[STYLE_BACKGROUND] = ctx->len;
         }
-        ptr--;
     }
+}
 
-    if (open_tag) {
-        DBG_FR("Opening tag: 0x%x", ch);
-
-        ctx->stack[ctx->ptr++] = ch;
-        if (ctx->ptr >= MAX_CTX_STACK_SIZE){
-            ERR_FR("Too many tags in stack, abort");
-            return;
-        }
+/**
+ * @brief end_style adds span of given style from where it starts to current
+ * end of text, if the style is applied.
+ */
+static void end_style(ColorlizeContext *ctx, ColorizeStyle style){
+    int start;
+    SrnRenderSpanType type;
+    const char *value;
 
-        switch (ch){
-            case MIRC_BOLD:
-                g_string_append(ctx->str, "<b>");
-                break;
-            case MIRC_ITALICS:
-                g_string_append(ctx->str, "<i>");
-                break;
-            case MIRC_UNDERLINE:
-                g_string_append(ctx->str, "<u>");
-                break;
-            case MIRC_REVERSE:
-                // TODO: Not supported yet
-                break;
-            case MIRC_BLINK:
-                // TODO: Not supported yet
-                break;
-            case MIRC_COLOR:
-                if (ctx->fg_color > MIRC_COLOR_UNKNOWN){
-                    WARN_FR("Invalid mirc foreground color: %u", ctx->fg_color);
-                    ctx->fg_color = MIRC_COLOR_UNKNOWN;
-                }
-                if (ctx->bg_color > MIRC_COLOR_UNKNOWN){
-                    WARN_FR("Invalid mirc background color: %u", ctx->bg_color);
-                    ctx->bg_color = MIRC_COLOR_UNKNOWN;
-                }
-                if (ctx->fg_color == MIRC_COLOR_UNKNOWN) {
-                    if (ctx->bg_color == MIRC_COLOR_UNKNOWN) {
-                        ctx->ptr--; // Default color, tag can be omitted
-                    } else {
-                        g_string_append_printf(ctx->str,
-                                "<span background=\"%s\">",
-                                color_map[ctx->bg_color]);
-                    }
-                } else {
-                    g_string_append_printf(ctx->str,
-                            "<span foreground=\"%s\">",
-                            color_map[ctx->fg_color]);
-                }
-                break;
-        }
-    } else {
-        DBG_FR("Closing tag: 0x%x", ch);
+    start = ctx->starts[style];
+    if (start < 0){
+        return;
+    }
+    ctx->starts[style] = -1;
 
-        // Closes all unclosed tags before the start tag corresponding to current tag
-        for (int i = ctx->ptr - 1; i >= ptr; i--){
-            DBG_FR("Tag: 0x%x will be closed because of 0x%x", ctx->stack[i], ch);
-            switch (ctx->stack[i]){
-                case MIRC_BOLD:
-                    g_string_append(ctx->str, "</b>");
-                    break;
-                case MIRC_ITALICS:
-                    g_string_append(ctx->str, "</i>");
-                    break;
-                case MIRC_UNDERLINE:
-                    g_string_append(ctx->str, "</u>");
-                    break;
-                case MIRC_REVERSE:
-                    // TODO: Not supported yet
-                    break;
-                case MIRC_BLINK:
-                    // TODO: Not supported yet
-                    break;
-                case MIRC_COLOR:
-                    g_string_append(ctx->str, "</span>");
-                    break;
-            }
-        }
-        int tmp_ptr = ctx->ptr;
-        ctx->ptr = ptr;
-        // Reopen the closed tag excepting the current tag
-        for (int i = ptr + 1; i < tmp_ptr; i++){
-            do_colorize(ctx, ctx->stack[i]);
-        }
+    value = NULL;
+    switch (style){
+        case STYLE_BOLD:
+            type = SRN_RENDER_SPAN_BOLD;
+            break;
+        case STYLE_ITALICS:
+            type = SRN_RENDER_SPAN_ITALICS;
+            break;
+        case STYLE_UNDERLINE:
+            type = SRN_RENDER_SPAN_UNDERLINE;
+            break;
+        case STYLE_STRIKETHROUGH:
+            type = SRN_RENDER_SPAN_STRIKETHROUGH;
+            break;
+        case STYLE_MONOSPACE:
+            type = SRN_RENDER_SPAN_MONOSPACE;
+            break;
+        case STYLE_FOREGROUND:
+            type = SRN_RENDER_SPAN_FOREGROUND;
+            value = color_map[ctx->fg_color];
+            break;
+        case STYLE_BACKGROUND:
+            type = SRN_RENDER_SPAN_BACKGROUND;
+            value = color_map[ctx->bg_color];
+            break;
+        default:
+            g_warn_if_reached();
+            return;
+    }
+    srn_render_text_add_span(ctx->text, type, start, ctx->len, value);
+}
 
-        if (ch == MIRC_COLOR) {
-            if (ctx->fg_color == MIRC_COLOR_UNKNOWN && ctx->bg_color == MIRC_COLOR_UNKNOWN ){
-                DBG_FR("Tag 0x%x closed with default {fore,back}ground color", ch);
-            } else {
-                DBG_FR("Reopening tag 0x%x because foreground color = %u and background = %u",
-                        ch, ctx->fg_color, ctx->bg_color);
-                // One or more of fg_color and bg_color is not default color,
-                // we should open a new tag for showing them.
-                do_colorize(ctx, MIRC_COLOR);
-            }
-        }
+static void end_all_styles(ColorlizeContext *ctx){
+    for (int i = 0; i < STYLE_MAX; i++){
+        end_style(ctx, i);
     }
 }
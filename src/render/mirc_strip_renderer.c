@@ -16,23 +16,20 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include <stdlib.h>
 #include <string.h>
 #include <glib.h>
 
 #include "srain.h"
 #include "log.h"
 #include "i18n.h"
-#include "markup_renderer.h"
 
 #include "./renderer.h"
 #include "./mirc.h"
 
 static void init(void);
 static void finalize(void);
-static SrnRet render(SrnMessage *msg);
-static void text(GMarkupParseContext *context, const gchar *text,
-        gsize text_len, gpointer user_data, GError **error);
+static SrnRet render(SrnMessage *msg, SrnRenderText *text, void *state);
+static bool may_render(SrnMessage *msg, const SrnRenderScan *scan, void *state);
 
 /**
  * @brief mirc_strip_renderer is a render moduele for strip mIRC color from
@@ -45,90 +42,51 @@ SrnMessageRenderer mirc_strip_renderer = {
     .init = init,
     .finalize = finalize,
     .render = render,
+    .may_render = may_render,
 };
 
-static SrnMarkupRenderer *markup_renderer;
-
 void init(void) {
-    GMarkupParser *parser;
-
-    markup_renderer = srn_markup_renderer_new();
-    parser = srn_markup_renderer_get_markup_parser(markup_renderer);
-    parser->text = text;
 }
 
 void finalize(void) {
-    srn_markup_renderer_free(markup_renderer);
 }
 
-SrnRet render(SrnMessage *msg) {
-    char *rendered_content;
-    SrnRet ret;
+bool may_render(SrnMessage *msg, const SrnRenderScan *scan, void *state) {
+    return srn_render_scan_has_any(scan, MIRC_CONTROLS);
+}
 
-    rendered_content = NULL;
-    ret = srn_markup_renderer_render(markup_renderer,
-            msg->rendered_content, &rendered_content, msg);
-    if (!RET_IS_OK(ret)){
-        return RET_ERR(_("Failed to render markup text: %1$s"), RET_MSG(ret));
-    }
-    if (rendered_content) {
-        g_free(msg->rendered_content);
-        msg->rendered_content = rendered_content;
-    }
+SrnRet render(SrnMessage *msg, SrnRenderText *text, void *state) {
+    char *str;
+    char *dst;
+    const char *src;
 
-    return SRN_OK;
-}
+    // Offsets of text are changed, spans can not be kept
+    g_warn_if_fail(text->spans->len == 0);
 
-static void text(GMarkupParseContext *context, const gchar *text,
-        gsize text_len, gpointer user_data, GError **error){
-    GString *str;
+    str = text->str->str;
+    src = srn_mirc_find_control(str);
+    if (*src == '\0'){
+        // No control character, the common case
+        return SRN_OK;
+    }
 
-    str = srn_markup_renderer_get_markup(user_data);
+    /* Text only shrinks, plain runs are moved forward in place */
+    dst = (char *)src;
+    while (*src != '\0'){
+        const char *next;
 
-    for (int i = 0; i < text_len; i++){
-        switch (text[i]){
-            case MIRC_COLOR:
-                {
-                    const char *startptr = &text[i] + 1;
-                    char *endptr = NULL;
-                    strtoul(startptr, &endptr, 10);
-                    if (endptr > startptr){ // Get foreground color
-                        while (endptr - startptr > 2){ // Wrong number of digits
-                            endptr--;
-                        }
-                    }
-                    i += endptr - startptr;
-                    if (*endptr == ',') { // background color exists
-                        endptr++;
-                        startptr = endptr;
-                        endptr = NULL;
-                        strtoul(startptr, &endptr, 10);
-                        if (endptr > startptr){ // Get background color
-                            while (endptr - startptr > 2){ // Wrong number of digits
-                                endptr--;
-                            }
-                        }
-                        i += endptr - startptr;
-                    }
-                    break;
-                }
-            case MIRC_BOLD:
-            case MIRC_ITALICS:
-            case MIRC_UNDERLINE:
-            case MIRC_BLINK:
-            case MIRC_REVERSE:
-            case MIRC_PLAIN:
-                break;
-            default:
-                {
-                    // No control character, it is a utf-8 sequence
-                    const char *next = g_utf8_next_char(&text[i]);
-                    char *escape = g_markup_escape_text(&text[i], next - &text[i]);
-                    str = g_string_append(str, escape);
-                    g_free(escape);
-                    i += next - &text[i] - 1;
-                    break;
-                }
+        if (*src == MIRC_COLOR){
+            src = srn_mirc_parse_color(src + 1, NULL, NULL);
+        } else {
+            src++;
         }
+
+        next = srn_mirc_find_control(src);
+        memmove(dst, src, next - src);
+        dst += next - src;
+        src = next;
     }
+    g_string_truncate(text->str, dst - str);
+
+    return SRN_OK;
 }
@@ -17,7 +17,6 @@
  */
 
 #include "core/core.h"
-#include "markup_renderer.h"
 #include "pattern_set.h"
 
 #include "./renderer.h"
@@ -26,20 +25,22 @@
 
 static void init(void);
 static void finalize(void);
-static SrnRet render(SrnMessage *msg);
-static GList** alloc_patterns();
-static void free_patterns(GList **patterns);
-static GList* get_patterns(SrnMessage *msg);
-static void text(GMarkupParseContext *context, const gchar *text,
-        gsize text_len, gpointer user_data, GError **error);
+static SrnRet render(SrnMessage *msg, SrnRenderText *text, void *state);
+static void render_regex(SrnMessage *msg, SrnRenderText *text,
+        const GRegex *regex);
+static void free_patterns(SrnPatternList *patterns);
 
-static SrnMarkupRenderer *markup_renderer;
+/* Number of patterns attached to all extra datas, message is not touched
+ * when it is 0 */
+static int npattern;
 
 /**
  * @brief pattern_renderer is a render module for extracting text from message
  * content via given pattern, and use them as new message content.
  *
  * NOTE: Make sure pattern_renderer is executed as first renderer.
+ * NOTE: It reads extra datas and changes interned strings of message, so it
+ * is always executed on main thread.
  */
 SrnMessageRenderer pattern_renderer = {
     .name = "pattern",
@@ -49,87 +50,56 @@ SrnMessageRenderer pattern_renderer = {
 };
 
 void init(void) {
-    GMarkupParser *parser;
-
-    markup_renderer = srn_markup_renderer_new();
-    parser = srn_markup_renderer_get_markup_parser(markup_renderer);
-    parser->start_element = NULL;
-    parser->end_element = NULL;
-    parser->text = text;
 }
 
 void finalize(void) {
-    srn_markup_renderer_free(markup_renderer);
 }
 
-static SrnRet render(SrnMessage *msg) {
-    char *raw_content;
-    GList *patterns;
-    GList *lst;
-    SrnRet ret;
-    SrnPatternSet *pattern_set;
+static SrnRet render(SrnMessage *msg, SrnRenderText *text, void *state) {
+    SrnExtraData *datas[4];
 
-    pattern_set = srn_application_get_default()->pattern_set;
-    g_return_val_if_fail(pattern_set, SRN_ERR);
+    if (npattern == 0) {
+        return SRN_OK;
+    }
 
-    patterns = get_patterns(msg);
+    datas[0] = msg->sender->extra_data;
+    datas[1] = msg->sender->srv_user->extra_data;
+    datas[2] = msg->chat->extra_data;
+    // Patterns of server chat are not applied twice
+    datas[3] = msg->chat != msg->chat->srv->chat
+        ? msg->chat->srv->chat->extra_data : NULL;
 
-    raw_content = NULL;
-    ret = srn_markup_renderer_render(markup_renderer,
-            msg->rendered_content, &raw_content, NULL);
-    if (!RET_IS_OK(ret)){
-        // ret = RET_ERR(_("Failed to render markup text: %1$s"), RET_MSG(ret));
-        // return TRUE;
-    }
-    lst = patterns;
-    while (lst) {
-        const char *pattern;
-        const GRegex *regex;
-
-        pattern = lst->data;
-        regex = srn_pattern_set_get(pattern_set, pattern);
-        if (regex) {
-            GMatchInfo *match_info;
-
-            match_info = NULL;
-            g_regex_match(regex, raw_content, 0, &match_info);
-            if (g_match_info_matches(match_info)) {
-                char *sender;
-                char *content;
-                char *time;
-
-                sender = g_match_info_fetch_named(match_info, "sender");
-                content = g_match_info_fetch_named(match_info, "content");
-                time = g_match_info_fetch_named(match_info, "time");
-
-                if (sender) {
-                    g_free(msg->rendered_remark);
-                    msg->rendered_remark = msg->rendered_sender;
-                    msg->rendered_sender = g_markup_escape_text(sender, -1);
-                }
-                if (content) {
-                    g_free(msg->rendered_content);
-                    msg->rendered_content = g_markup_escape_text(content, -1);
-                }
-                if (time) {
-                    g_free(msg->rendered_short_time);
-                    msg->rendered_short_time = g_markup_escape_text(time, -1);
-                }
-
-                g_free(sender);
-                g_free(content);
-                g_free(time);
-                g_match_info_free(match_info);
-            }
+    for (int i = 0; i < G_N_ELEMENTS(datas); i++) {
+        GPtrArray *regexes;
+        SrnPatternList *patterns;
+
+        if (!datas[i]) {
+            continue;
+        }
+        patterns = srn_extra_data_get(datas[i], PATTERNS_KEY);
+        if (!patterns) {
+            continue;
         }
-        lst = g_list_next(lst);
-    }
 
-    g_list_free(patterns);
+        regexes = srn_pattern_list_get_regexes(patterns);
+        for (int j = 0; j < regexes->len; j++) {
+            render_regex(msg, text, g_ptr_array_index(regexes, j));
+        }
+    }
 
     return SRN_OK;
 }
 
+/**
+ * @brief srn_render_has_pattern returns whether any pattern is attached,
+ * pattern renderer does nothing if not.
+ *
+ * @return
+ */
+bool srn_render_has_pattern(void){
+    return npattern > 0;
+}
+
 /**
  * @brief srn_render_attach_pattern attach a pattern name to given SrnExtraData.
  * The attached pattern name will be used to render message.
@@ -141,102 +111,77 @@ static SrnRet render(SrnMessage *msg) {
  * @return
  */
 SrnRet srn_render_attach_pattern(SrnExtraData *extra_data, const char *pattern){
-    GList **patterns;
-    GList *lst;
+    SrnRet ret;
+    SrnPatternList *patterns;
 
     patterns = srn_extra_data_get(extra_data, PATTERNS_KEY);
     if (!patterns) {
-        patterns = alloc_patterns();
+        patterns = srn_pattern_list_new(
+                srn_application_get_default()->pattern_set);
         srn_extra_data_set(extra_data, PATTERNS_KEY, patterns,
                 (GDestroyNotify)free_patterns);
     }
 
-    lst = *patterns;
-    while (lst) {
-        if (g_strcasecmp(lst->data, pattern) == 0) {
-            return SRN_ERR;
-        }
-        lst = g_list_next(lst);
+    ret = srn_pattern_list_add(patterns, pattern);
+    if (RET_IS_OK(ret)) {
+        npattern++;
     }
 
-    *patterns = g_list_append(*patterns, g_strdup(pattern));
-
-    return SRN_OK;
+    return ret;
 }
 
 SrnRet srn_render_detach_pattern(SrnExtraData *extra_data, const char *pattern){
-    GList **patterns;
-    GList *lst;
+    SrnRet ret;
+    SrnPatternList *patterns;
 
     patterns = srn_extra_data_get(extra_data, PATTERNS_KEY);
     g_return_val_if_fail(patterns, SRN_OK);
 
-    lst = *patterns;
-    while (lst) {
-        if (g_strcasecmp(lst->data, pattern) == 0) {
-            break;
-        }
-        lst = g_list_next(lst);
+    ret = srn_pattern_list_rm(patterns, pattern);
+    if (RET_IS_OK(ret)) {
+        npattern--;
     }
-    if (!lst) {
-        return SRN_ERR;
-    }
-
-    g_free(lst->data);
-    *patterns = g_list_delete_link(*patterns, lst);
 
-    return SRN_OK;
-}
-
-static GList** alloc_patterns()  {
-    return g_malloc0(sizeof(GList **));
+    return ret;
 }
 
-static void free_patterns(GList **patterns){
-    if (patterns) {
-        if (*patterns) {
-            g_list_free_full(*patterns, g_free);
+static void render_regex(SrnMessage *msg, SrnRenderText *text,
+        const GRegex *regex) {
+    GMatchInfo *match_info;
+
+    match_info = NULL;
+    g_regex_match(regex, msg->content, 0, &match_info);
+    if (g_match_info_matches(match_info)) {
+        char *sender;
+        char *content;
+        char *time;
+
+        sender = g_match_info_fetch_named(match_info, "sender");
+        content = g_match_info_fetch_named(match_info, "content");
+        time = g_match_info_fetch_named(match_info, "time");
+
+        if (sender) {
+            srn_message_set_rendered_remark(msg,
+                    msg->sender->srv_user->nick);
+            srn_message_set_rendered_sender(msg, sender);
         }
-        g_free(patterns);
-    }
-}
-
-/**
- * @brief get_patterns
- *
- * @return a list which contains const string, should be freed by g_list_free();
- */
-static GList* get_patterns(SrnMessage *msg) {
-    GList *iter;
-    GList *datas; // List of SrnExtraData
-    GList *patterns;
-
-    datas = NULL;
-    datas = g_list_append(datas, msg->sender->extra_data);
-    datas = g_list_append(datas, msg->sender->srv_user->extra_data);
-    datas = g_list_append(datas, msg->chat->extra_data);
-    datas = g_list_append(datas, msg->chat->srv->chat->extra_data);
-
-    patterns = NULL;
-    iter = datas;
-    while (iter) {
-        SrnExtraData *data;
-        GList **lp;
-
-        data = iter->data;
-        lp = srn_extra_data_get(data, PATTERNS_KEY);
-        if (lp && *lp) {
-            patterns = g_list_concat(patterns, g_list_copy(*lp));
+        if (content) {
+            // Replace the whole text, pattern renderer is the first
+            // renderer so no span is lost
+            srn_render_text_set_text(text, content);
+        }
+        if (time) {
+            srn_message_set_rendered_time(msg, time);
         }
-        iter = g_list_next(iter);
-    }
-
-    g_list_free(datas);
 
-    return patterns;
+        g_free(sender);
+        g_free(content);
+        g_free(time);
+    }
+    g_match_info_free(match_info);
 }
 
-static void text(GMarkupParseContext *context, const gchar *text,
-        gsize text_len, gpointer user_data, GError **error){
-    g_string_append_len(srn_markup_renderer_get_markup(user_data), text, text_len);
+static void free_patterns(SrnPatternList *patterns){
+    npattern -= srn_pattern_list_get_length(patterns);
+    srn_pattern_list_free(patterns);
 }
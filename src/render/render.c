@@ -16,6 +16,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <string.h>
 #include <glib.h>
 
 #include "srain.h"
@@ -24,16 +25,97 @@
 
 #include "render/render.h"
 #include "./renderer.h"
+#include "./render_cache.h"
 
 // Bits of a SrnRenderFlags(int)
 #define MAX_RENDERER   sizeof(SrnRenderFlags) * 8
 
+// Renderers which can only be applied in the first pass of rendering
+#define FIRST_PASS_FLAGS \
+    (SRN_RENDER_FLAG_PATTERN \
+     | SRN_RENDER_FLAG_MIRC_STRIP \
+     | SRN_RENDER_FLAG_MIRC_COLORIZE)
+
+typedef struct _SrnRenderJob SrnRenderJob;
+
+/**
+ * @brief SrnRenderQueue is shared by main thread and worker threads. Jobs
+ * are owned by main thread, except the ones in render pool which are not
+ * done yet.
+ */
+struct _SrnRenderQueue {
+    int refcount; // Held by owner, jobs in render pool and idle source
+    GQueue *jobs; // SrnRenderJobs in order of delivering, main thread only
+    GHashTable *leaders; // Set of jobs being rendered in render pool, used
+                         // for finding jobs of the same content, main
+                         // thread only
+
+    GMutex mutex; // Protects fields below, done and orphaned of jobs
+    GCond cond;
+    int running; // Number of jobs being rendered
+    bool cancelled;
+    unsigned source; // Idle source delivering done jobs
+};
+
+/**
+ * @brief SrnRenderJob renders a message. When it is rendered on worker
+ * thread, message is only updated by renderers and the result is applied on
+ * main thread.
+ */
+struct _SrnRenderJob {
+    SrnRenderQueue *queue;
+    SrnMessage *msg;
+    SrnRenderFlags flags;
+    SrnRenderFlags key_flags; // Flags of render cache entry of result
+    SrnRenderFunc func;
+    void *user_data;
+
+    bool pooled; // Pushed to render pool
+    bool done; // Rendered or cancelled, result can be delivered
+    bool orphaned; // Dropped from cancelled queue before worker thread
+                   // takes it, worker thread frees it
+    bool follower; // Result is taken from render cache after a previous
+                   // job of the same content is delivered
+    SrnRet ret;
+
+    /* Used by worker thread */
+    void *states[MAX_RENDERER]; // Snapshots returned by prepare() of renderers
+    SrnRenderText *text;
+    char *markup;
+    gint64 cost;
+};
+
 extern SrnMessageRenderer pattern_renderer;
 extern SrnMessageRenderer mirc_colorize_renderer;
 extern SrnMessageRenderer mirc_strip_renderer;
 extern SrnMessageRenderer url_renderer;
 extern SrnMessageRenderer mention_renderer;
 static SrnMessageRenderer *renderers[MAX_RENDERER];
+static GThreadPool *render_pool;
+
+static bool lookup_cache(SrnMessage *msg, SrnRenderFlags flags);
+static SrnRenderText* new_render_text(SrnMessage *msg);
+static SrnRet render_message(SrnMessage *msg, SrnRenderFlags flags);
+static SrnRet run_renderers(SrnMessage *msg, SrnRenderFlags flags,
+        SrnRenderText *text, void **states);
+static void finish_render(SrnMessage *msg, SrnRenderFlags flags,
+        SrnRenderText *text, char *markup, gint64 cost);
+static bool is_parallelizable(SrnRenderFlags flags);
+static void prepare_states(SrnChat *chat, SrnRenderFlags flags,
+        void **states);
+static void release_states(void **states);
+
+static void push_job(SrnRenderQueue *self, SrnMessage *msg,
+        SrnRenderFlags flags, SrnRenderFunc func, void *user_data,
+        bool head);
+static void deliver_jobs(SrnRenderQueue *self);
+static gboolean deliver_jobs_idle(gpointer user_data);
+static SrnRenderQueue* render_queue_ref(SrnRenderQueue *self);
+static void render_queue_unref(SrnRenderQueue *self);
+static void render_job_free(SrnRenderJob *job);
+static guint render_job_hash(gconstpointer key);
+static gboolean render_job_equal(gconstpointer a, gconstpointer b);
+static void render_job_func(gpointer data, gpointer user_data);
 
 void srn_render_init(void){
     int i;
@@ -54,9 +136,21 @@ void srn_render_init(void){
         }
         renderers[i]->init();
     }
+
+    render_pool = g_thread_pool_new(render_job_func, NULL,
+            g_get_num_processors(), FALSE, NULL);
+    if (!render_pool){
+        WARN_FR("Failed to create render thread pool, render on main thread");
+    }
 }
 
 void srn_render_finalize(void){
+    if (render_pool){
+        g_thread_pool_free(render_pool, FALSE, TRUE);
+        render_pool = NULL;
+    }
+    srn_render_cache_finalize();
+
     /* Finalize all renderers */
     for (int i = 0; i < MAX_RENDERER; i++){
         if (!renderers[i] || !renderers[i]->finalize) {
@@ -66,8 +160,228 @@ void srn_render_finalize(void){
     }
 }
 
+/**
+ * @brief srn_render_invalidate drops render states cached in extra data,
+ * it should be called when config of owner of extra data is changed.
+ *
+ * @param extra_data
+ */
+void srn_render_invalidate(SrnExtraData *extra_data){
+    srn_render_cache_invalidate(extra_data);
+    for (int i = 0; i < MAX_RENDERER; i++){
+        if (!renderers[i] || !renderers[i]->invalidate) {
+            continue;
+        }
+        renderers[i]->invalidate(extra_data);
+    }
+}
+
 SrnRet srn_render_message(SrnMessage *msg, SrnRenderFlags flags){
     g_return_val_if_fail(msg, SRN_ERR);
+    g_return_val_if_fail(!(msg->rendered_flags & flags), SRN_ERR);
+    g_return_val_if_fail(!msg->rendered_flags || !(flags & FIRST_PASS_FLAGS),
+            SRN_ERR);
+
+    if (!flags) {
+        return SRN_OK;
+    }
+
+    if (lookup_cache(msg, flags)) {
+        DBG_FR("Message %p is rendered from cache", msg);
+        return SRN_OK;
+    }
+
+    return render_message(msg, flags);
+}
+
+/**
+ * @brief srn_render_queue_new creates a queue for rendering messages of a
+ * chat.
+ *
+ * @return A new SrnRenderQueue.
+ */
+SrnRenderQueue* srn_render_queue_new(void){
+    SrnRenderQueue *self;
+
+    self = g_malloc0(sizeof(SrnRenderQueue));
+    self->refcount = 1;
+    self->jobs = g_queue_new();
+    self->leaders = g_hash_table_new(render_job_hash, render_job_equal);
+    g_mutex_init(&self->mutex);
+    g_cond_init(&self->cond);
+
+    return self;
+}
+
+/**
+ * @brief srn_render_queue_free cancels rendering of messages in queue, it
+ * waits for the messages being rendered on worker threads. Callbacks of
+ * messages not delivered yet are called with SRN_ERR, so that they can be
+ * freed.
+ *
+ * @param self
+ */
+void srn_render_queue_free(SrnRenderQueue *self){
+    unsigned source;
+    SrnRenderJob *job;
+
+    g_mutex_lock(&self->mutex);
+    self->cancelled = TRUE;
+    while (self->running > 0){
+        g_cond_wait(&self->cond, &self->mutex);
+    }
+    source = self->source;
+    self->source = 0;
+    g_mutex_unlock(&self->mutex);
+
+    if (source){
+        g_source_remove(source);
+    }
+
+    while ((job = g_queue_pop_head(self->jobs))){
+        bool orphaned;
+
+        /* No worker thread is running (running is 0), and the ones taking
+         * jobs later see cancelled before touching message, so message is
+         * owned by main thread and the callback can free it. func, msg and
+         * user_data are never written by worker thread */
+        job->func(job->msg, SRN_ERR, job->user_data);
+
+        /* Either main thread or worker thread frees the job, decided under
+         * mutex: job which is not done yet is still in render pool, it is
+         * freed by worker thread once taken */
+        g_mutex_lock(&self->mutex);
+        orphaned = job->pooled && !job->done;
+        job->orphaned = orphaned;
+        g_mutex_unlock(&self->mutex);
+        if (!orphaned){
+            render_job_free(job);
+        }
+    }
+
+    render_queue_unref(self);
+}
+
+/**
+ * @brief srn_render_queue_push renders a message according to the given
+ * flags like srn_render_message(), func is called when it is rendered and all
+ * messages pushed before it are delivered.
+ *
+ * The message is rendered on worker thread, it must not be modified or freed
+ * until func is called. func may be called before this function returns if
+ * the message does not need to be rendered on worker thread.
+ *
+ * @param self
+ * @param msg
+ * @param flags
+ * @param func
+ * @param user_data
+ */
+void srn_render_queue_push(SrnRenderQueue *self, SrnMessage *msg,
+        SrnRenderFlags flags, SrnRenderFunc func, void *user_data){
+    push_job(self, msg, flags, func, user_data, FALSE);
+}
+
+/**
+ * @brief srn_render_queue_push_head is like srn_render_queue_push(), but
+ * message is delivered before all messages in queue. func is never called
+ * before this function returns.
+ *
+ * @param self
+ * @param msg
+ * @param flags
+ * @param func
+ * @param user_data
+ */
+void srn_render_queue_push_head(SrnRenderQueue *self, SrnMessage *msg,
+        SrnRenderFlags flags, SrnRenderFunc func, void *user_data){
+    push_job(self, msg, flags, func, user_data, TRUE);
+}
+
+/**
+ * @brief srn_render_queue_is_empty returns whether all messages in queue are
+ * delivered.
+ *
+ * @param self
+ *
+ * @return
+ */
+bool srn_render_queue_is_empty(SrnRenderQueue *self){
+    return g_queue_is_empty(self->jobs);
+}
+
+/**
+ * @brief lookup_cache looks up the result of rendering message with both
+ * renderers already applied and given flags.
+ */
+static bool lookup_cache(SrnMessage *msg, SrnRenderFlags flags){
+    if (!srn_render_cache_lookup(msg, msg->rendered_flags | flags)) {
+        return FALSE;
+    }
+    msg->rendered_flags |= flags;
+
+    return TRUE;
+}
+
+/**
+ * @brief new_render_text creates the text to be rendered, it contains the
+ * result of previous render passes if any.
+ */
+static SrnRenderText* new_render_text(SrnMessage *msg){
+    SrnRenderText *text;
+
+    if (!msg->rendered_flags) {
+        return srn_render_text_new(msg->content);
+    }
+
+    text = srn_render_text_new(srn_message_get_plain_content(msg));
+    if (msg->rendered_spans) {
+        for (int i = 0; i < msg->rendered_spans->len; i++){
+            SrnRenderSpan *span;
+
+            span = &g_array_index(msg->rendered_spans, SrnRenderSpan, i);
+            srn_render_text_add_span(text, span->type,
+                    span->start, span->end, span->value);
+        }
+    }
+
+    return text;
+}
+
+static SrnRet render_message(SrnMessage *msg, SrnRenderFlags flags){
+    gint64 start;
+    SrnRet ret;
+    SrnRenderText *text;
+    void *states[MAX_RENDERER];
+
+    /* Renderers annotate the plain text in place, the markup is serialized
+     * only once after all of them run */
+    start = g_get_monotonic_time();
+    text = new_render_text(msg);
+    prepare_states(msg->chat, flags, states);
+    ret = run_renderers(msg, flags, text, states);
+    release_states(states);
+    if (!RET_IS_OK(ret)) {
+        srn_render_text_free(text);
+        return ret;
+    }
+    finish_render(msg, flags, text, srn_render_text_to_markup(text),
+            g_get_monotonic_time() - start);
+
+    return SRN_OK;
+}
+
+/**
+ * @brief run_renderers applies renderers to text, it may be called on worker
+ * thread.
+ */
+static SrnRet run_renderers(SrnMessage *msg, SrnRenderFlags flags,
+        SrnRenderText *text, void **states){
+    SrnRenderScan scan;
+
+    // Classify content once, renderers which can not match anything in it
+    // are skipped
+    srn_render_scan_init(&scan, msg->content);
 
     for (int i = 0; i < MAX_RENDERER; i++){
         SrnRet ret;
@@ -79,10 +393,14 @@ SrnRet srn_render_message(SrnMessage *msg, SrnRenderFlags flags){
         g_warn_if_fail(renderers[i]
                 && renderers[i]->name
                 && renderers[i]->render);
+        if (renderers[i]->may_render
+                && !renderers[i]->may_render(msg, &scan, states[i])) {
+            continue;
+        }
         DBG_FR("Rendering message %p via render module %s",
                 msg, renderers[i]->name);
 
-        ret = renderers[i]->render(msg);
+        ret = renderers[i]->render(msg, text, states[i]);
         if (!RET_IS_OK(ret)) {
             return RET_ERR("Renderer %s failed to render message %p: %s",
                     renderers[i]->name, msg, RET_MSG(ret));
@@ -91,3 +409,318 @@ SrnRet srn_render_message(SrnMessage *msg, SrnRenderFlags flags){
 
     return SRN_OK;
 }
+
+/**
+ * @brief finish_render applies the render result to message, it must be
+ * called on main thread. Ownership of text and markup is transferred.
+ */
+static void finish_render(SrnMessage *msg, SrnRenderFlags flags,
+        SrnRenderText *text, char *markup, gint64 cost){
+    srn_message_set_rendered_content(msg, markup);
+    // Filters read the plain text instead of parsing markup again
+    srn_message_set_plain_content(msg,
+            strcmp(text->str->str, msg->content) != 0 ? text->str->str : NULL);
+    // UI applies the spans to plain text without parsing markup
+    srn_message_set_rendered_spans(msg, srn_render_text_steal_spans(text));
+    srn_render_text_free(text);
+    msg->rendered_flags |= flags;
+
+    srn_render_cache_store(msg, msg->rendered_flags, cost);
+}
+
+/**
+ * @brief srn_render_scan_init scans content in one pass and records which
+ * bytes it contains.
+ *
+ * @param self
+ * @param content
+ */
+void srn_render_scan_init(SrnRenderScan *self, const char *content){
+    const guint8 *ptr;
+
+    memset(self->bytes, 0, sizeof(self->bytes));
+    for (ptr = (const guint8 *)content; *ptr; ptr++){
+        srn_render_scan_add(self, *ptr);
+    }
+}
+
+void srn_render_scan_add(SrnRenderScan *self, guint8 byte){
+    self->bytes[byte / 32] |= 1u << (byte % 32);
+}
+
+/**
+ * @brief srn_render_scan_has_any returns whether content contains any of
+ * given bytes.
+ *
+ * @param self
+ * @param bytes is a NUL-terminated string of bytes.
+ *
+ * @return TRUE if any byte is present.
+ */
+bool srn_render_scan_has_any(const SrnRenderScan *self, const char *bytes){
+    for (const guint8 *ptr = (const guint8 *)bytes; *ptr; ptr++){
+        if (self->bytes[*ptr / 32] & (1u << (*ptr % 32))){
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+bool srn_render_scan_intersects(const SrnRenderScan *self,
+        const SrnRenderScan *other){
+    for (int i = 0; i < G_N_ELEMENTS(self->bytes); i++){
+        if (self->bytes[i] & other->bytes[i]){
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+static bool is_parallelizable(SrnRenderFlags flags){
+    /* Pattern renderer modifies interned sender, remark and time of message,
+     * it is a no-op when no pattern is attached */
+    return !(flags & SRN_RENDER_FLAG_PATTERN) || !srn_render_has_pattern();
+}
+
+/**
+ * @brief prepare_states takes snapshots of states of chat for renderers
+ * in flags, they must be released by release_states().
+ */
+static void prepare_states(SrnChat *chat, SrnRenderFlags flags,
+        void **states){
+    for (int i = 0; i < MAX_RENDERER; i++){
+        states[i] = NULL;
+        if (!(flags & (1 << i))
+                || !renderers[i]
+                || !renderers[i]->prepare) {
+            continue;
+        }
+        states[i] = renderers[i]->prepare(chat);
+    }
+}
+
+static void release_states(void **states){
+    for (int i = 0; i < MAX_RENDERER; i++){
+        if (!states[i] || !renderers[i]->release) {
+            continue;
+        }
+        renderers[i]->release(states[i]);
+        states[i] = NULL;
+    }
+}
+
+static void push_job(SrnRenderQueue *self, SrnMessage *msg,
+        SrnRenderFlags flags, SrnRenderFunc func, void *user_data,
+        bool head){
+    SrnRenderJob *job;
+
+    job = g_malloc0(sizeof(SrnRenderJob));
+    job->queue = self;
+    job->msg = msg;
+    job->flags = flags;
+    job->key_flags = msg->rendered_flags | flags;
+    job->func = func;
+    job->user_data = user_data;
+    job->ret = SRN_OK;
+
+    if (msg->rendered_flags & flags
+            || (msg->rendered_flags && flags & FIRST_PASS_FLAGS)) {
+        g_warn_if_reached();
+        job->ret = SRN_ERR;
+        job->done = TRUE;
+    } else if (!flags || lookup_cache(msg, flags)) {
+        job->done = TRUE;
+    } else if (!render_pool || !is_parallelizable(flags)) {
+        job->ret = render_message(msg, flags);
+        job->done = TRUE;
+    } else if (!head && g_hash_table_contains(self->leaders, job)) {
+        /* Same content is being rendered, wait for its result rather than
+         * rendering it again */
+        job->follower = TRUE;
+    } else {
+        if (!g_hash_table_contains(self->leaders, job)) {
+            g_hash_table_add(self->leaders, job);
+        }
+        job->text = new_render_text(msg);
+        prepare_states(msg->chat, flags, job->states);
+        job->pooled = TRUE;
+        render_queue_ref(self);
+        g_thread_pool_push(render_pool, job, NULL);
+    }
+
+    if (head) {
+        g_queue_push_head(self->jobs, job);
+        if (job->done || job->follower) {
+            g_mutex_lock(&self->mutex);
+            if (!self->source) {
+                self->source = g_idle_add_full(G_PRIORITY_DEFAULT,
+                        deliver_jobs_idle, render_queue_ref(self),
+                        (GDestroyNotify)render_queue_unref);
+            }
+            g_mutex_unlock(&self->mutex);
+        }
+    } else {
+        g_queue_push_tail(self->jobs, job);
+        if (g_queue_get_length(self->jobs) == 1) {
+            deliver_jobs(self);
+        }
+    }
+}
+
+/**
+ * @brief deliver_jobs applies results of done jobs at head of queue to their
+ * messages and calls their callbacks, on main thread.
+ */
+static void deliver_jobs(SrnRenderQueue *self){
+    SrnRenderJob *job;
+
+    // Callback may free the queue
+    render_queue_ref(self);
+    while (!self->cancelled && (job = g_queue_peek_head(self->jobs))){
+        bool done;
+
+        g_mutex_lock(&self->mutex);
+        done = job->done;
+        g_mutex_unlock(&self->mutex);
+        if (!done && !job->follower) {
+            break;
+        }
+        g_queue_pop_head(self->jobs);
+
+        if (g_hash_table_lookup(self->leaders, job) == job) {
+            g_hash_table_remove(self->leaders, job);
+        }
+        if (job->follower) {
+            // Previous job of the same content has stored its result
+            if (!lookup_cache(job->msg, job->flags)) {
+                job->ret = render_message(job->msg, job->flags);
+            }
+        } else if (job->pooled && RET_IS_OK(job->ret)) {
+            finish_render(job->msg, job->flags, job->text, job->markup,
+                    job->cost);
+            job->text = NULL;
+            job->markup = NULL;
+        }
+
+        job->func(job->msg, job->ret, job->user_data);
+        render_job_free(job);
+    }
+    render_queue_unref(self);
+}
+
+static gboolean deliver_jobs_idle(gpointer user_data){
+    SrnRenderQueue *self;
+
+    self = user_data;
+    g_mutex_lock(&self->mutex);
+    self->source = 0;
+    g_mutex_unlock(&self->mutex);
+
+    deliver_jobs(self);
+
+    return G_SOURCE_REMOVE;
+}
+
+static SrnRenderQueue* render_queue_ref(SrnRenderQueue *self){
+    g_atomic_int_inc(&self->refcount);
+
+    return self;
+}
+
+static void render_queue_unref(SrnRenderQueue *self){
+    if (!g_atomic_int_dec_and_test(&self->refcount)){
+        return;
+    }
+    g_hash_table_destroy(self->leaders);
+    g_queue_free(self->jobs);
+    g_cond_clear(&self->cond);
+    g_mutex_clear(&self->mutex);
+    g_free(self);
+}
+
+/**
+ * @brief render_job_free frees job but not its message, it may be called on
+ * worker thread.
+ */
+static void render_job_free(SrnRenderJob *job){
+    release_states(job->states);
+    if (job->text) {
+        srn_render_text_free(job->text);
+    }
+    g_free(job->markup);
+    g_free(job);
+}
+
+/* Jobs of the same content and flags have the same result */
+static guint render_job_hash(gconstpointer key){
+    const SrnRenderJob *job = key;
+
+    return g_str_hash(job->msg->content) * 31 + job->key_flags;
+}
+
+static gboolean render_job_equal(gconstpointer a, gconstpointer b){
+    const SrnRenderJob *job1 = a;
+    const SrnRenderJob *job2 = b;
+
+    return job1->key_flags == job2->key_flags
+        && strcmp(job1->msg->content, job2->msg->content) == 0;
+}
+
+static void render_job_func(gpointer data, gpointer user_data){
+    gint64 start;
+    SrnRenderJob *job;
+    SrnRenderQueue *queue;
+
+    job = data;
+    queue = job->queue;
+
+    g_mutex_lock(&queue->mutex);
+    if (queue->cancelled) {
+        goto cancelled;
+    }
+    queue->running++;
+    g_mutex_unlock(&queue->mutex);
+
+    /* Pattern renderer is a no-op here, see is_parallelizable(). Messages
+     * are not touched by main thread until they are delivered */
+    start = g_get_monotonic_time();
+    job->ret = run_renderers(job->msg, job->flags & ~SRN_RENDER_FLAG_PATTERN,
+            job->text, job->states);
+    if (RET_IS_OK(job->ret)) {
+        job->markup = srn_render_text_to_markup(job->text);
+    }
+    job->cost = g_get_monotonic_time() - start;
+
+    g_mutex_lock(&queue->mutex);
+    queue->running--;
+    if (queue->cancelled) {
+        g_cond_signal(&queue->cond);
+        goto cancelled;
+    }
+    // Job is owned by main thread since now
+    job->done = TRUE;
+    if (!queue->source) {
+        queue->source = g_idle_add_full(G_PRIORITY_DEFAULT,
+                deliver_jobs_idle, render_queue_ref(queue),
+                (GDestroyNotify)render_queue_unref);
+    }
+    g_mutex_unlock(&queue->mutex);
+
+    render_queue_unref(queue);
+    return;
+
+cancelled:
+    /* Mutex is held. Job is freed by main thread when it is dropped from
+     * queue, unless it has been dropped already, see
+     * srn_render_queue_free(). It must not be touched after unlocking */
+    if (job->orphaned) {
+        g_mutex_unlock(&queue->mutex);
+        render_job_free(job);
+    } else {
+        job->done = TRUE;
+        g_mutex_unlock(&queue->mutex);
+    }
+    render_queue_unref(queue);
+}
@@ -0,0 +1,297 @@
+/* Copyright (C) 2016-2021 Shengyu Zhang <i@silverrainz.me>
+ *
+ * This file is part of Srain.
+ *
+ * Srain is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file render_cache.c
+ * @brief LRU cache of render results, so repeated messages (bot output, relay
+ * bridges, spam) skip the render pipeline.
+ * @author Shengyu Zhang <i@silverrainz.me>
+ * @version 1.2.0
+ * @date 2021-03-18
+ */
+
+#include <string.h>
+#include <glib.h>
+
+#include "srain.h"
+#include "log.h"
+#include "intern.h"
+#include "timer_wheel.h"
+
+#include "./renderer.h"
+#include "./render_cache.h"
+
+#define CACHE_KEY       "render_cache"
+#define CACHE_SIZE      64  // Number of entries per chat
+#define STATS_INTERVAL  (60 * 1000) // In milliseconds
+
+typedef struct _SrnRenderCache SrnRenderCache;
+typedef struct _SrnRenderCacheEntry SrnRenderCacheEntry;
+
+/**
+ * @brief SrnRenderCache is attached to extra data of chat, results are only
+ * valid for the nick and chat config they are rendered with.
+ */
+struct _SrnRenderCache {
+    const char *nick; // Interned, our nick when results are rendered
+    GHashTable *table; // SrnRenderCacheEntry -> GList link in queue
+    GQueue *queue; // Entries, most recently used first
+};
+
+struct _SrnRenderCacheEntry {
+    /* Key */
+    char *content; // Raw content
+    SrnRenderFlags flags;
+
+    /* Result */
+    char *rendered_content;
+    char *plain_content;
+    GArray *spans; // Shared with messages, never modified after rendering
+    GList *urls;
+    bool mentioned; // Only meaningful with SRN_RENDER_FLAG_MENTION
+    gint64 cost; // Time spent on rendering, in microseconds
+};
+
+static SrnRenderCache* get_cache(SrnMessage *msg, bool create);
+static bool is_cacheable(SrnRenderFlags flags);
+static SrnRenderCache* cache_new(const char *nick);
+static void cache_free(SrnRenderCache *self);
+static void entry_free(SrnRenderCacheEntry *entry);
+static guint entry_hash(gconstpointer key);
+static gboolean entry_equal(gconstpointer a, gconstpointer b);
+static void count_lookup(bool hit, gint64 saved);
+static gboolean stats_timeout(gpointer user_data);
+
+/* Statistics since last report */
+static unsigned hits;
+static unsigned misses;
+static gint64 saved_time;
+static unsigned stats_timer;
+
+void srn_render_cache_finalize(void){
+    if (stats_timer){
+        srn_timer_wheel_remove(
+                srn_application_get_default()->timer_wheel, stats_timer);
+        stats_timer = 0;
+    }
+}
+
+/**
+ * @brief srn_render_cache_lookup applies cached render result to message.
+ *
+ * @param msg is a message which is not rendered yet.
+ * @param flags
+ *
+ * @return TRUE if cache hit.
+ */
+bool srn_render_cache_lookup(SrnMessage *msg, SrnRenderFlags flags){
+    GList *link;
+    SrnRenderCache *cache;
+    SrnRenderCacheEntry key;
+    SrnRenderCacheEntry *entry;
+
+    if (!is_cacheable(flags)){
+        return FALSE;
+    }
+    cache = get_cache(msg, FALSE);
+    if (!cache){
+        count_lookup(FALSE, 0);
+        return FALSE;
+    }
+
+    key.content = msg->content;
+    key.flags = flags;
+    link = g_hash_table_lookup(cache->table, &key);
+    if (!link){
+        count_lookup(FALSE, 0);
+        return FALSE;
+    }
+
+    // Move to head
+    g_queue_unlink(cache->queue, link);
+    g_queue_push_head_link(cache->queue, link);
+
+    entry = link->data;
+    srn_message_set_rendered_content(msg, g_strdup(entry->rendered_content));
+    srn_message_set_plain_content(msg, entry->plain_content);
+    srn_message_set_rendered_spans(msg,
+            entry->spans ? g_array_ref(entry->spans) : NULL);
+    g_list_free_full(msg->urls, g_free);
+    msg->urls = g_list_copy_deep(entry->urls, (GCopyFunc)g_strdup, NULL);
+    if (flags & SRN_RENDER_FLAG_MENTION){
+        // Otherwise mention state is not decided by renderer, keep it
+        msg->mentioned = entry->mentioned;
+    }
+
+    count_lookup(TRUE, entry->cost);
+
+    return TRUE;
+}
+
+/**
+ * @brief srn_render_cache_store caches render result of message.
+ *
+ * @param msg is a message just rendered from its raw content.
+ * @param flags
+ * @param cost is time spent on rendering, in microseconds.
+ */
+void srn_render_cache_store(SrnMessage *msg, SrnRenderFlags flags,
+        gint64 cost){
+    SrnRenderCache *cache;
+    SrnRenderCacheEntry *entry;
+
+    if (!is_cacheable(flags)){
+        return;
+    }
+    cache = get_cache(msg, TRUE);
+
+    entry = g_malloc0(sizeof(SrnRenderCacheEntry));
+    entry->content = g_strdup(msg->content);
+    entry->flags = flags;
+    entry->rendered_content = g_strdup(msg->rendered_content);
+    entry->plain_content = g_strdup(msg->plain_content);
+    entry->spans = msg->rendered_spans ? g_array_ref(msg->rendered_spans) : NULL;
+    entry->urls = g_list_copy_deep(msg->urls, (GCopyFunc)g_strdup, NULL);
+    entry->mentioned = msg->mentioned;
+    entry->cost = cost;
+
+    if (g_hash_table_contains(cache->table, entry)){
+        entry_free(entry);
+        return;
+    }
+
+    g_queue_push_head(cache->queue, entry);
+    g_hash_table_insert(cache->table, entry, cache->queue->head);
+
+    if (cache->queue->length > CACHE_SIZE){
+        entry = g_queue_pop_tail(cache->queue);
+        g_hash_table_remove(cache->table, entry);
+        entry_free(entry);
+    }
+}
+
+void srn_render_cache_invalidate(SrnExtraData *extra_data){
+    if (srn_extra_data_get(extra_data, CACHE_KEY)){
+        srn_extra_data_set(extra_data, CACHE_KEY, NULL, NULL);
+    }
+}
+
+static SrnRenderCache* get_cache(SrnMessage *msg, bool create){
+    const char *nick;
+    SrnExtraData *extra_data;
+    SrnRenderCache *cache;
+
+    extra_data = msg->chat->extra_data;
+    nick = msg->chat->srv->user->nick;
+    cache = srn_extra_data_get(extra_data, CACHE_KEY);
+    if (cache && cache->nick != nick){
+        // Our nick is changed, mentions are outdated
+        srn_extra_data_set(extra_data, CACHE_KEY, NULL, NULL);
+        cache = NULL;
+    }
+    if (!cache && create){
+        cache = cache_new(nick);
+        srn_extra_data_set(extra_data, CACHE_KEY, cache,
+                (GDestroyNotify)cache_free);
+    }
+
+    return cache;
+}
+
+static bool is_cacheable(SrnRenderFlags flags){
+    /* Result of pattern renderer depends on sender and changes sender, remark
+     * and time of message, which are not cached */
+    return !(flags & SRN_RENDER_FLAG_PATTERN) || !srn_render_has_pattern();
+}
+
+static SrnRenderCache* cache_new(const char *nick){
+    SrnRenderCache *self;
+
+    self = g_malloc0(sizeof(SrnRenderCache));
+    self->nick = srn_intern(nick);
+    self->table = g_hash_table_new(entry_hash, entry_equal);
+    self->queue = g_queue_new();
+
+    return self;
+}
+
+static void cache_free(SrnRenderCache *self){
+    g_hash_table_destroy(self->table);
+    g_queue_free_full(self->queue, (GDestroyNotify)entry_free);
+    srn_intern_unref(self->nick);
+    g_free(self);
+}
+
+static void entry_free(SrnRenderCacheEntry *entry){
+    g_free(entry->content);
+    g_free(entry->rendered_content);
+    g_free(entry->plain_content);
+    if (entry->spans){
+        g_array_unref(entry->spans);
+    }
+    g_list_free_full(entry->urls, g_free);
+    g_free(entry);
+}
+
+static guint entry_hash(gconstpointer key){
+    const SrnRenderCacheEntry *entry = key;
+
+    return g_str_hash(entry->content) * 31 + entry->flags;
+}
+
+static gboolean entry_equal(gconstpointer a, gconstpointer b){
+    const SrnRenderCacheEntry *entry1 = a;
+    const SrnRenderCacheEntry *entry2 = b;
+
+    return entry1->flags == entry2->flags
+        && strcmp(entry1->content, entry2->content) == 0;
+}
+
+static void count_lookup(bool hit, gint64 saved){
+    if (hit){
+        hits++;
+        saved_time += saved;
+    } else {
+        misses++;
+    }
+
+    if (!stats_timer){
+        stats_timer = srn_timer_wheel_add(
+                srn_application_get_default()->timer_wheel,
+                "render cache stats", STATS_INTERVAL, stats_timeout, NULL);
+    }
+}
+
+static gboolean stats_timeout(gpointer user_data){
+    if (hits + misses == 0){
+        // No message is rendered, stop reporting until next lookup
+        stats_timer = 0;
+        return G_SOURCE_REMOVE;
+    }
+
+    DBG_FR("Render cache: %u hits, %u misses (%.1f%%), %" G_GINT64_FORMAT
+            " us saved in last %d seconds",
+            hits, misses, 100.0 * hits / (hits + misses), saved_time,
+            STATS_INTERVAL / 1000);
+
+    hits = 0;
+    misses = 0;
+    saved_time = 0;
+
+    return G_SOURCE_CONTINUE;
+}
@@ -0,0 +1,33 @@
+/* Copyright (C) 2016-2021 Shengyu Zhang <i@silverrainz.me>
+ *
+ * This file is part of Srain.
+ *
+ * Srain is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* This is a private header file and should not be exported. */
+
+#ifndef __IN_RENDER_CACHE_H
+#define __IN_RENDER_CACHE_H
+
+#include "core/core.h"
+#include "render/render.h"
+
+void srn_render_cache_finalize(void);
+bool srn_render_cache_lookup(SrnMessage *msg, SrnRenderFlags flags);
+void srn_render_cache_store(SrnMessage *msg, SrnRenderFlags flags,
+        gint64 cost);
+void srn_render_cache_invalidate(SrnExtraData *extra_data);
+
+#endif /* __IN_RENDER_CACHE_H */
@@ -0,0 +1,331 @@
+/* Copyright (C) 2016-2021 Shengyu Zhang <i@silverrainz.me>
+ *
+ * This file is part of Srain.
+ *
+ * Srain is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file render_text.c
+ * @brief Span based intermediate representation of rendering message.
+ * @author Shengyu Zhang <i@silverrainz.me>
+ * @version 1.2.0
+ * @date 2021-03-14
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+
+#include "srain.h"
+#include "log.h"
+#include "markup_escape.h"
+
+#include "./render_text.h"
+
+static void clear_span(SrnRenderSpan *span);
+static int compare_span(const void *a, const void *b);
+static int compare_int(const void *a, const void *b);
+static void append_open_tag(GString *markup, SrnRenderSpan *span);
+static void append_close_tag(GString *markup, SrnRenderSpan *span);
+
+SrnRenderText* srn_render_text_new(const char *text){
+    SrnRenderText *self;
+
+    self = g_malloc0(sizeof(SrnRenderText));
+    self->str = g_string_new(text);
+    self->spans = srn_render_span_array_new();
+
+    return self;
+}
+
+void srn_render_text_free(SrnRenderText *self){
+    g_string_free(self->str, TRUE);
+    g_array_unref(self->spans);
+    g_free(self);
+}
+
+/**
+ * @brief srn_render_text_set_text replaces the plain text, all spans are
+ * dropped because their offsets are no longer valid.
+ *
+ * @param self
+ * @param text
+ */
+void srn_render_text_set_text(SrnRenderText *self, const char *text){
+    g_string_assign(self->str, text);
+    g_array_set_size(self->spans, 0);
+}
+
+/**
+ * @brief srn_render_text_add_span applies an attribute to range
+ * [start, end) of plain text. Spans may overlap with each other.
+ *
+ * @param self
+ * @param type
+ * @param start
+ * @param end
+ * @param value is copied, can be NULL.
+ */
+void srn_render_text_add_span(SrnRenderText *self, SrnRenderSpanType type,
+        int start, int end, const char *value){
+    SrnRenderSpan span;
+
+    g_return_if_fail(start >= 0 && end <= self->str->len);
+    if (start >= end){
+        return;
+    }
+
+    span.type = type;
+    span.start = start;
+    span.end = end;
+    span.value = g_strdup(value);
+    g_array_append_val(self->spans, span);
+}
+
+/**
+ * @brief srn_render_text_to_markup serializes the text and its spans to
+ * markup in one linear pass. Overlapping spans which are not properly
+ * nested are split so that the result is always valid markup.
+ *
+ * @param self
+ *
+ * @return A newly allocated markup string.
+ */
+char* srn_render_text_to_markup(SrnRenderText *self){
+    int nbound;
+    int next_span;
+    int *bounds;
+    GString *markup;
+    GPtrArray *stack; // Opened spans
+    GPtrArray *reopen;
+
+    markup = g_string_sized_new(self->str->len + 16);
+    if (self->spans->len == 0){
+        srn_markup_escape_append(markup, self->str->str, self->str->len);
+        return g_string_free(markup, FALSE);
+    }
+
+    // Spans start earlier and end later are opened first
+    g_array_sort(self->spans, compare_span);
+
+    /* Collect boundaries of all spans */
+    bounds = g_malloc((self->spans->len * 2 + 1) * sizeof(int));
+    nbound = 0;
+    bounds[nbound++] = 0;
+    for (int i = 0; i < self->spans->len; i++){
+        SrnRenderSpan *span;
+
+        span = &g_array_index(self->spans, SrnRenderSpan, i);
+        bounds[nbound++] = span->start;
+        bounds[nbound++] = span->end;
+    }
+    qsort(bounds, nbound, sizeof(int), compare_int);
+
+    stack = g_ptr_array_new();
+    reopen = g_ptr_array_new();
+    next_span = 0;
+    for (int i = 0; i < nbound; i++){
+        int bound;
+        int next_bound;
+        int closed;
+
+        bound = bounds[i];
+        if (i > 0 && bound == bounds[i - 1]){
+            continue;
+        }
+
+        /* Close spans which end here, and the spans opened after them */
+        closed = -1;
+        for (int j = 0; j < stack->len; j++){
+            SrnRenderSpan *span;
+
+            span = g_ptr_array_index(stack, j);
+            if (span->end <= bound){
+                closed = j;
+                break;
+            }
+        }
+        if (closed >= 0){
+            for (int j = stack->len - 1; j >= closed; j--){
+                SrnRenderSpan *span;
+
+                span = g_ptr_array_index(stack, j);
+                append_close_tag(markup, span);
+                if (span->end > bound){
+                    g_ptr_array_add(reopen, span);
+                }
+            }
+            g_ptr_array_set_size(stack, closed);
+            for (int j = reopen->len - 1; j >= 0; j--){
+                SrnRenderSpan *span;
+
+                span = g_ptr_array_index(reopen, j);
+                append_open_tag(markup, span);
+                g_ptr_array_add(stack, span);
+            }
+            g_ptr_array_set_size(reopen, 0);
+        }
+
+        /* Open spans which start here */
+        while (next_span < self->spans->len){
+            SrnRenderSpan *span;
+
+            span = &g_array_index(self->spans, SrnRenderSpan, next_span);
+            if (span->start != bound){
+                break;
+            }
+            append_open_tag(markup, span);
+            g_ptr_array_add(stack, span);
+            next_span++;
+        }
+
+        /* Text until next boundary */
+        next_bound = self->str->len;
+        for (int j = i + 1; j < nbound; j++){
+            if (bounds[j] != bound){
+                next_bound = bounds[j];
+                break;
+            }
+        }
+        srn_markup_escape_append(markup, self->str->str + bound,
+                next_bound - bound);
+    }
+
+    for (int j = stack->len - 1; j >= 0; j--){
+        append_close_tag(markup, g_ptr_array_index(stack, j));
+    }
+
+    g_ptr_array_free(reopen, TRUE);
+    g_ptr_array_free(stack, TRUE);
+    g_free(bounds);
+
+    return g_string_free(markup, FALSE);
+}
+
+/**
+ * @brief srn_render_text_steal_spans takes all spans away from text.
+ *
+ * @param self
+ *
+ * @return A GArray of SrnRenderSpan, should be freed by g_array_unref().
+ */
+GArray* srn_render_text_steal_spans(SrnRenderText *self){
+    GArray *spans;
+
+    spans = self->spans;
+    self->spans = srn_render_span_array_new();
+
+    return spans;
+}
+
+GArray* srn_render_span_array_new(void){
+    GArray *spans;
+
+    spans = g_array_new(FALSE, FALSE, sizeof(SrnRenderSpan));
+    g_array_set_clear_func(spans, (GDestroyNotify)clear_span);
+
+    return spans;
+}
+
+static void clear_span(SrnRenderSpan *span){
+    g_free(span->value);
+    span->value = NULL;
+}
+
+static int compare_span(const void *a, const void *b){
+    const SrnRenderSpan *span1 = a;
+    const SrnRenderSpan *span2 = b;
+
+    if (span1->start != span2->start){
+        return span1->start - span2->start;
+    }
+    return span2->end - span1->end;
+}
+
+static int compare_int(const void *a, const void *b){
+    return *(const int *)a - *(const int *)b;
+}
+
+static void append_open_tag(GString *markup, SrnRenderSpan *span){
+    switch (span->type){
+        case SRN_RENDER_SPAN_BOLD:
+            g_string_append(markup, "<b>");
+            break;
+        case SRN_RENDER_SPAN_ITALICS:
+            g_string_append(markup, "<i>");
+            break;
+        case SRN_RENDER_SPAN_UNDERLINE:
+            g_string_append(markup, "<u>");
+            break;
+        case SRN_RENDER_SPAN_STRIKETHROUGH:
+            g_string_append(markup, "<s>");
+            break;
+        case SRN_RENDER_SPAN_MONOSPACE:
+            g_string_append(markup, "<tt>");
+            break;
+        case SRN_RENDER_SPAN_FOREGROUND:
+            g_string_append(markup, "<span foreground=\"");
+            srn_markup_escape_append(markup, span->value, -1);
+            g_string_append(markup, "\">");
+            break;
+        case SRN_RENDER_SPAN_BACKGROUND:
+            g_string_append(markup, "<span background=\"");
+            srn_markup_escape_append(markup, span->value, -1);
+            g_string_append(markup, "\">");
+            break;
+        case SRN_RENDER_SPAN_LINK:
+            g_string_append(markup, "<a href=\"");
+            srn_markup_escape_append(markup, span->value, -1);
+            g_string_append(markup, "\">");
+            break;
+        case SRN_RENDER_SPAN_MENTION:
+            g_string_append(markup, "<span foreground=\"" SRN_RENDER_MENTION_COLOR "\"><b>");
+            break;
+        default:
+            g_warn_if_reached();
+    }
+}
+
+static void append_close_tag(GString *markup, SrnRenderSpan *span){
+    switch (span->type){
+        case SRN_RENDER_SPAN_BOLD:
+            g_string_append(markup, "</b>");
+            break;
+        case SRN_RENDER_SPAN_ITALICS:
+            g_string_append(markup, "</i>");
+            break;
+        case SRN_RENDER_SPAN_UNDERLINE:
+            g_string_append(markup, "</u>");
+            break;
+        case SRN_RENDER_SPAN_STRIKETHROUGH:
+            g_string_append(markup, "</s>");
+            break;
+        case SRN_RENDER_SPAN_MONOSPACE:
+            g_string_append(markup, "</tt>");
+            break;
+        case SRN_RENDER_SPAN_FOREGROUND:
+        case SRN_RENDER_SPAN_BACKGROUND:
+            g_string_append(markup, "</span>");
+            break;
+        case SRN_RENDER_SPAN_LINK:
+            g_string_append(markup, "</a>");
+            break;
+        case SRN_RENDER_SPAN_MENTION:
+            g_string_append(markup, "</b></span>");
+            break;
+        default:
+            g_warn_if_reached();
+    }
+}
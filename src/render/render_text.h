@@ -0,0 +1,51 @@
+/* Copyright (C) 2016-2021 Shengyu Zhang <i@silverrainz.me>
+ *
+ * This file is part of Srain.
+ *
+ * Srain is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* This is a private header file and should not be exported. */
+
+#ifndef __IN_RENDER_TEXT_H
+#define __IN_RENDER_TEXT_H
+
+#include <glib.h>
+
+#include "srain.h"
+#include "render/render_span.h"
+
+typedef struct _SrnRenderText SrnRenderText;
+
+/**
+ * @brief SrnRenderText is the intermediate representation shared by all
+ * renderers: a plain text and a list of spans. Renderers annotate it in
+ * place, and it is serialized to markup only once after all renderers run.
+ */
+struct _SrnRenderText {
+    GString *str;   // Plain text, not escaped
+    GArray *spans;  // Array of SrnRenderSpan
+};
+
+SrnRenderText* srn_render_text_new(const char *text);
+void srn_render_text_free(SrnRenderText *self);
+void srn_render_text_set_text(SrnRenderText *self, const char *text);
+void srn_render_text_add_span(SrnRenderText *self, SrnRenderSpanType type,
+        int start, int end, const char *value);
+char* srn_render_text_to_markup(SrnRenderText *self);
+GArray* srn_render_text_steal_spans(SrnRenderText *self);
+
+GArray* srn_render_span_array_new(void);
+
+#endif /* __IN_RENDER_TEXT_H */
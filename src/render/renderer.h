@@ -23,17 +23,56 @@
 
 #include "core/core.h"
 
+#include "./render_text.h"
+
 /**
  * @brief SrnMessageRenderer defines a module context of a SrnMessgae rendering
  *module.
  */
 typedef struct _SrnMessageRenderer SrnMessageRenderer;
+typedef struct _SrnRenderScan SrnRenderScan;
+
+/**
+ * @brief SrnRenderScan classifies raw content of message by the bytes it
+ * contains, it is built in one pass before any renderer runs. Renderers only
+ * remove bytes from text (or replace it with a substring of raw content), so
+ * it remains a superset of what later renderers see.
+ */
+struct _SrnRenderScan {
+    guint32 bytes[256 / 32]; // Bitmap of bytes present in content
+};
 
+/**
+ * @brief SrnMessageRenderer renders messages on worker threads unless noted
+ * otherwise, render() only reads the message and the state returned by
+ * prepare(), which is called on main thread before the message is queued.
+ */
 struct _SrnMessageRenderer {
     const char *name;
     void (*init) (void);
-    SrnRet (*render) (SrnMessage *msg);
+    SrnRet (*render) (SrnMessage *msg, SrnRenderText *text, void *state);
     void (*finalize) (void);
+    // Return FALSE if render() can not change the message according to
+    // scan of its content, so that it is skipped, can be NULL
+    bool (*may_render) (SrnMessage *msg, const SrnRenderScan *scan,
+            void *state);
+    // Take a snapshot of states of chat which render() needs, so that they
+    // can be rebuilt on main thread while messages are being rendered, can
+    // be NULL
+    void* (*prepare) (SrnChat *chat);
+    // Free the state returned by prepare(), it may be called on worker
+    // thread, can be NULL
+    void (*release) (void *state);
+    // Drop states cached in extra data, can be NULL
+    void (*invalidate) (SrnExtraData *extra_data);
 };
 
+bool srn_render_has_pattern(void);
+
+void srn_render_scan_init(SrnRenderScan *self, const char *content);
+bool srn_render_scan_has_any(const SrnRenderScan *self, const char *bytes);
+bool srn_render_scan_intersects(const SrnRenderScan *self,
+        const SrnRenderScan *other);
+void srn_render_scan_add(SrnRenderScan *self, guint8 byte);
+
 #endif /* __IN_RENDERER_H */
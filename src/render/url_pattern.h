@@ -0,0 +1,78 @@
+/* Copyright (C) 2016-2021 Shengyu Zhang <i@silverrainz.me>
+ *
+ * This file is part of Srain.
+ *
+ * Srain is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* This is a private header file and should not be exported.
+ * Patterns of url_renderer.c, shared with url_renderer_test.c */
+
+#ifndef __IN_URL_PATTERN_H
+#define __IN_URL_PATTERN_H
+
+/* Some patterns are copied from hexchat/src/common/url.c */
+#define PROTO_PATTERN       "(http|https|ftp|git|svn|irc|ircs|xmpp)"
+
+#define DOMAIN_PATTERN      "[_\\pL\\pN\\pS][-_\\pL\\pN\\pS]*(\\.[-_\\pL\\pN\\pS]+)*"
+
+#define TLD_PATTERN         "\\.[\\pL][-\\pL\\pN]*[\\pL]"
+/* Ref: https://w3techs.com/technologies/overview/top_level_domain/all */
+#define POP_TLD_PATTERN     "\\.(com|ru|org|net|de|jp|uk|br|it|pl|fr|in|au|ir"  \
+                            "|info|nl|cn|es|cz|kr|ca|eu|ua|co|gr|ro|za|biz|ch"  \
+                            "|se|tw|mx|vn|hu|be|at|tr|dk|tv|me|ar|sk|no|us|fi"  \
+                            "|id|cl|xyz|io|pt|by|il|ie|nz|kz|hk|lt|cc|my|sg"    \
+                            "|club|bg|рф|edu|top|pk|su|th|hr|rs|pro|pe|si|az"   \
+                            "|lv|pw|ae|ph|ng|online|ee|ve|cat|moe|tk|ml)"
+#define IP_PATTERN          "[0-9]{1,3}(\\.[0-9]{1,3}){3}"
+
+#define PORT_PATTERN        "(:[1-9][0-9]{0,4})"
+#define HOST_PATTERN        "(" DOMAIN_PATTERN TLD_PATTERN "|" IP_PATTERN "|" "localhost" ")" PORT_PATTERN "?"
+/* Only match popular tld name for signal */
+#define SINGLY_HOST_PATTERN "(" DOMAIN_PATTERN POP_TLD_PATTERN "|" IP_PATTERN "|" "localhost" ")" PORT_PATTERN "?" "\\b"
+
+/* For convenience, last character of URL is limited */
+#define URL_PATH_PATTERN    "(/[A-Za-z0-9-_.~:/?#\\[\\]@!&'()*+,;=%|]*[A-Za-z0-9-_/])?/?"
+#define URL_PATTERN         PROTO_PATTERN "://" HOST_PATTERN URL_PATH_PATTERN
+
+/* Ref: https://tools.ietf.org/html/rfc1459#section-1.3
+   For convenience, last character of channel is limited */
+#define CHANNEL_PATTERN     "[#&][^\x07\x2C\\s,:]{0,199}[A-Za-z0-9-_+]"
+
+#define EMAIL_PATTERN       "[a-z0-9][._+%a-z0-9-]+@" HOST_PATTERN
+
+typedef enum {
+    MATCH_URL,
+    MATCH_HOST,
+    MATCH_CHANNEL,
+    MATCH_EMAIL,
+
+    /* ... */
+    MATCH_MAX,
+} MatchType;
+
+/* All patterns are combined into one alternation, PCRE finds the leftmost
+ * match and tries alternatives in the order of MatchType at that position */
+#define COMBINED_PATTERN \
+    "(?<url>" URL_PATTERN ")" \
+    "|(?<host>" SINGLY_HOST_PATTERN ")" \
+    "|(?<channel>" CHANNEL_PATTERN ")" \
+    "|(?<email>" EMAIL_PATTERN ")"
+
+/* Every match of COMBINED_PATTERN contains one of these bytes, except the
+ * bare "localhost" */
+#define LINK_CANDIDATES     ".:@#&"
+#define LOCALHOST           "localhost"
+
+#endif /* __IN_URL_PATTERN_H */
@@ -22,20 +22,19 @@
 
 #include "log.h"
 #include "i18n.h"
-#include "markup_renderer.h"
 
 #include "render/render.h"
 #include "./renderer.h"
+#include "./url_pattern.h"
 
 static void init(void);
 static void finalize(void);
-static SrnRet render(SrnMessage *msg);
-static void text(GMarkupParseContext *context, const gchar *text,
-        gsize text_len, gpointer user_data, GError **error);
-static bool match_pattern(const char *pattern, const char *str, int *start,
-        int *end);
+static SrnRet render(SrnMessage *msg, SrnRenderText *text, void *state);
+static bool may_render(SrnMessage *msg, const SrnRenderScan *scan, void *state);
+static void* prepare(SrnChat *chat);
+static void release(void *state);
 
-static SrnMarkupRenderer *markup_renderer;
+static GRegex *url_regex;
 
  /**
   * @brief url_renderer is a render moduele for rendering URL in message.
@@ -45,206 +44,157 @@ SrnMessageRenderer url_renderer = {
     .init = init,
     .finalize = finalize,
     .render = render,
+    .may_render = may_render,
+    .prepare = prepare,
+    .release = release,
 };
 
-/* Some patterns are copied from hexchat/src/common/url.c */
-#define PROTO_PATTERN       "(http|https|ftp|git|svn|irc|ircs|xmpp)"
-
-#define DOMAIN_PATTERN      "[_\\pL\\pN\\pS][-_\\pL\\pN\\pS]*(\\.[-_\\pL\\pN\\pS]+)*"
-
-#define TLD_PATTERN         "\\.[\\pL][-\\pL\\pN]*[\\pL]"
-/* Ref: https://w3techs.com/technologies/overview/top_level_domain/all */
-#define POP_TLD_PATTERN     "\\.(com|ru|org|net|de|jp|uk|br|it|pl|fr|in|au|ir"  \
-                            "|info|nl|cn|es|cz|kr|ca|eu|ua|co|gr|ro|za|biz|ch"  \
-                            "|se|tw|mx|vn|hu|be|at|tr|dk|tv|me|ar|sk|no|us|fi"  \
-                            "|id|cl|xyz|io|pt|by|il|ie|nz|kz|hk|lt|cc|my|sg"    \
-                            "|club|bg|рф|edu|top|pk|su|th|hr|rs|pro|pe|si|az"   \
-                            "|lv|pw|ae|ph|ng|online|ee|ve|cat|moe|tk|ml)"
-#define IP_PATTERN          "[0-9]{1,3}(\\.[0-9]{1,3}){3}"
-
-#define PORT_PATTERN        "(:[1-9][0-9]{0,4})"
-#define HOST_PATTERN        "(" DOMAIN_PATTERN TLD_PATTERN "|" IP_PATTERN "|" "localhost" ")" PORT_PATTERN "?"
-/* Only match popular tld name for signal */
-#define SINGLY_HOST_PATTERN "(" DOMAIN_PATTERN POP_TLD_PATTERN "|" IP_PATTERN "|" "localhost" ")" PORT_PATTERN "?" "\\b"
-
-/* For convenience, last character of URL is limited */
-#define URL_PATH_PATTERN    "(/[A-Za-z0-9-_.~:/?#\\[\\]@!&'()*+,;=%|]*[A-Za-z0-9-_/])?/?"
-#define URL_PATTERN         PROTO_PATTERN "://" HOST_PATTERN URL_PATH_PATTERN
-
-/* Ref: https://tools.ietf.org/html/rfc1459#section-1.3
-   For convenience, last character of channel is limited */
-#define CHANNEL_PATTERN     "[#&][^\x07\x2C\\s,:]{0,199}[A-Za-z0-9-_+]"
-
-#define EMAIL_PATTERN       "[a-z0-9][._+%a-z0-9-]+@" HOST_PATTERN
-
-typedef enum {
-    MATCH_URL,
-    MATCH_HOST,
-    MATCH_CHANNEL,
-    MATCH_EMAIL,
-
-    /* ... */
-    MATCH_MAX,
-} MatchType;
-
-static char* patterns[MATCH_MAX + 1] = {
-    [MATCH_URL] = URL_PATTERN,
-    [MATCH_CHANNEL] = CHANNEL_PATTERN,
-    [MATCH_EMAIL] = EMAIL_PATTERN,
-    [MATCH_HOST] = SINGLY_HOST_PATTERN,
+/* Names of capture group of each pattern in the combined pattern */
+static const char* match_names[MATCH_MAX] = {
+    [MATCH_URL] = "url",
+    [MATCH_HOST] = "host",
+    [MATCH_CHANNEL] = "channel",
+    [MATCH_EMAIL] = "email",
 };
 
+static MatchType fetch_match(GMatchInfo *match_info, int *start, int *end);
+static bool has_localhost(const char *str);
+
 void init(void) {
-    GMarkupParser *parser;
+    GError *err;
 
-    markup_renderer = srn_markup_renderer_new();
-    parser = srn_markup_renderer_get_markup_parser(markup_renderer);
-    parser->text = text;
+    err = NULL;
+    url_regex = g_regex_new(COMBINED_PATTERN,
+            G_REGEX_CASELESS | G_REGEX_OPTIMIZE, 0, &err);
+    if (!url_regex){
+        ERR_FR("g_regex_new() failed, err: %s", err->message);
+        g_error_free(err);
+    }
 }
 
 void finalize(void) {
-    srn_markup_renderer_free(markup_renderer);
+    if (url_regex){
+        g_regex_unref(url_regex);
+        url_regex = NULL;
+    }
 }
 
-SrnRet render(SrnMessage *msg) {
-    char *rendered_content;
-    SrnRet ret;
-
-    rendered_content = NULL;
-    ret = srn_markup_renderer_render(markup_renderer,
-            msg->rendered_content, &rendered_content, msg);
-    if (!RET_IS_OK(ret)){
-        return RET_ERR(_("Failed to render markup text: %1$s"), RET_MSG(ret));
+bool may_render(SrnMessage *msg, const SrnRenderScan *scan, void *state) {
+    if (!url_regex){
+        return FALSE;
     }
-    if (rendered_content) {
-        g_free(msg->rendered_content);
-        msg->rendered_content = rendered_content;
+    if (srn_render_scan_has_any(scan, LINK_CANDIDATES)){
+        return TRUE;
+    }
+    if (srn_render_scan_has_any(scan, "lL")){
+        return has_localhost(msg->content);
     }
 
-    return SRN_OK;
+    return FALSE;
 }
 
-void text(GMarkupParseContext *context, const gchar *text, gsize text_len,
-        gpointer user_data, GError **error) {
+SrnRet render(SrnMessage *msg, SrnRenderText *text, void *state) {
     int start, end;
-    int tmpstart, tmpend;
-    char *left;
-    const char *ptr, *ptrend;
-    char *url, *markuped_url;
-    GString *rcontent;
-    SrnMarkupRenderer *markup_renderer;
-    SrnMessage *msg;
+    char *url, *href;
+    GMatchInfo *match_info;
     MatchType type;
 
-    markup_renderer = user_data;
-    rcontent = srn_markup_renderer_get_markup(markup_renderer);
-    msg = srn_markup_renderer_get_user_data(markup_renderer);
-
-    ptr = text;
-    ptrend = ptr + text_len;
-    while (ptr < ptrend) {
-        type = MATCH_MAX;
-        start = end = strlen(ptr);
-
-        for (int i = 0; i < MATCH_MAX; i++){
-            if (!patterns[i]) continue;
-
-            if (match_pattern(patterns[i], ptr, &tmpstart, &tmpend)){
-                DBG_FR("Temp Match[%d,%d): %.*s ",
-                        tmpstart, tmpend, tmpend - tmpstart, ptr + tmpstart);
-
-                if (tmpstart < start){
-                    start = tmpstart;
-                    end = tmpend;
-                    type = i;
-                }
-            }
+    if (!url_regex){
+        return SRN_OK;
+    }
+
+    /* Find all links in one left-to-right pass */
+    match_info = NULL;
+    g_regex_match_full(url_regex, text->str->str, text->str->len, 0, 0,
+            &match_info, NULL);
+    while (g_match_info_matches(match_info)) {
+        type = fetch_match(match_info, &start, &end);
+        if (type == MATCH_MAX){
+            g_match_info_next(match_info, NULL);
+            continue;
         }
 
-        /* Markup the left of the matched(maybe) url */
-        left = g_markup_escape_text(ptr, start);
-        g_string_append(rcontent, left);
-        g_free(left);
-
-        /* If something matched */
-        if (type != MATCH_MAX){
-            url = g_strndup(ptr + start, end - start);
-
-            DBG_FR("Match url: %s, type: %d", url, type);
-
-            switch(type){
-                case MATCH_URL:
-                    markuped_url = g_markup_printf_escaped(
-                            "<a href=\"%s\">%s</a>", url, url);
-                    break;
-                case MATCH_HOST:
-                    /* Fallback to http protocol */
-                    markuped_url = g_markup_printf_escaped(
-                            "<a href=\"http://%s\">%s</a>", url, url);
-                    break;
-                case MATCH_CHANNEL:
-                    if (msg->chat->srv->cfg->irc->tls){
-                        markuped_url = g_markup_printf_escaped(
-                                "<a href=\"ircs://%s:%d/%s\">%s</a>",
-                                msg->chat->srv->addr->host,
-                                msg->chat->srv->addr->port,
-                                url,
-                                url);
-                    } else {
-                        markuped_url = g_markup_printf_escaped(
-                                "<a href=\"irc://%s:%d/%s\">%s</a>",
-                                msg->chat->srv->addr->host,
-                                msg->chat->srv->addr->port,
-                                url,
-                                url);
-                    }
-                    break;
-                case MATCH_EMAIL:
-                    markuped_url = g_markup_printf_escaped(
-                            "<a href=\"mailto:%s\">%s</a>", url, url);
-                    break;
-                default:
-                    markuped_url = NULL;
-                    break;
-            }
-
-            msg->urls = g_list_append(msg->urls, url);
-            g_string_append(rcontent, markuped_url);
-
-            DBG_FR("Appended url: %s", url);
-            DBG_FR("Markuped url: %s", markuped_url);
-
-            g_free(markuped_url);
+        url = g_strndup(text->str->str + start, end - start);
+
+        DBG_FR("Match url: %s, type: %d", url, type);
+
+        switch(type){
+            case MATCH_URL:
+                href = g_strdup(url);
+                break;
+            case MATCH_HOST:
+                /* Fallback to http protocol */
+                href = g_strdup_printf("http://%s", url);
+                break;
+            case MATCH_CHANNEL:
+                href = g_strconcat(state, url, NULL);
+                break;
+            case MATCH_EMAIL:
+                href = g_strdup_printf("mailto:%s", url);
+                break;
+            default:
+                href = NULL;
+                break;
         }
 
-        ptr += end;
-    }
-}
+        msg->urls = g_list_append(msg->urls, url);
+        srn_render_text_add_span(text, SRN_RENDER_SPAN_LINK, start, end, href);
 
-bool match_pattern(const char *pattern, const char *str, int *start, int *end) {
-    bool ret;
-    GError *err;
-    GRegex *regex;
-    GMatchInfo *match_info;
+        DBG_FR("Link: %s", href);
 
-    err = NULL;
-    regex = g_regex_new(pattern, G_REGEX_CASELESS | G_REGEX_OPTIMIZE, 0, &err);
-    if (!regex){
-        ERR_FR("g_regex_new() failed, pattern: %s, err: %s", pattern, err->message);
-        return FALSE;
+        g_free(href);
+        g_match_info_next(match_info, NULL);
     }
+    g_match_info_free(match_info);
+
+    return SRN_OK;
+}
 
-    g_regex_match(regex, str, 0, &match_info);
+/**
+ * @brief prepare returns the prefix of links of channels on server of chat,
+ * server address may change while messages are being rendered.
+ */
+static void* prepare(SrnChat *chat){
+    return g_strdup_printf("%s://%s:%d/",
+            chat->srv->cfg->irc->tls ? "ircs" : "irc",
+            chat->srv->addr->host,
+            chat->srv->addr->port);
+}
+
+static void release(void *state){
+    g_free(state);
+}
 
-    if (!(ret = g_match_info_matches(match_info))){
-        goto fin;
+/**
+ * @brief fetch_match gets type and position of current match of
+ * COMBINED_PATTERN.
+ *
+ * @return MATCH_MAX if no named group matched, it should not happen.
+ */
+MatchType fetch_match(GMatchInfo *match_info, int *start, int *end) {
+    for (int i = 0; i < MATCH_MAX; i++){
+        if (g_match_info_fetch_named_pos(match_info, match_names[i], start, end)
+                && *start >= 0){
+            DBG_FR("Match[%d,%d) as %s", *start, *end, match_names[i]);
+            return i;
+        }
     }
 
-    ret = g_match_info_fetch_pos(match_info, 0, start, end);
+    g_warn_if_reached();
+    return MATCH_MAX;
+}
 
-fin:
-    g_match_info_free(match_info);
-    g_regex_unref(regex);
+/**
+ * @brief has_localhost returns whether str contains "localhost", case
+ * insensitive like COMBINED_PATTERN.
+ */
+bool has_localhost(const char *str) {
+    for (const char *ptr = str; *ptr; ptr++){
+        if (g_ascii_tolower(*ptr) == 'l'
+                && g_ascii_strncasecmp(ptr, LOCALHOST, strlen(LOCALHOST)) == 0){
+            return TRUE;
+        }
+    }
 
-    return ret;
+    return FALSE;
 }
@@ -0,0 +1,355 @@
+/* Copyright (C) 2016-2021 Shengyu Zhang <i@silverrainz.me>
+ *
+ * This file is part of Srain.
+ *
+ * Srain is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file url_renderer_test.c
+ * @brief Test case for patterns of url_renderer.c, the combined pattern
+ * should find the same links as matching patterns one by one.
+ * @author Shengyu Zhang <i@silverrainz.me>
+ * @version 1.2.0
+ * @date 2021-03-20
+ *
+ * Run "url_renderer_test -m perf" for a comparison of their speed in
+ * messages per second. Messages are contents of PRIVMSGs and NOTICEs in
+ * bench/session.log under G_TEST_SRCDIR, or in the file given by
+ * SRN_BENCH_SESSION.
+ */
+
+#include <string.h>
+#include <glib.h>
+
+#include "./url_pattern.h"
+
+#define PERF_ROUND  20 // Rounds of matching with precompiled patterns
+
+typedef struct {
+    int start;
+    int end;
+    MatchType type;
+} Match;
+
+static const char *patterns[MATCH_MAX] = {
+    [MATCH_URL] = URL_PATTERN,
+    [MATCH_HOST] = SINGLY_HOST_PATTERN,
+    [MATCH_CHANNEL] = CHANNEL_PATTERN,
+    [MATCH_EMAIL] = EMAIL_PATTERN,
+};
+
+static const char *samples[] = {
+    "",
+    "nothing to see here",
+    "see https://example.com/path?a=1&b=2 and http://localhost:8080/",
+    "visit srain.im or www.example.org.",
+    "(https://en.wikipedia.org/wiki/Foo_(bar)), ok",
+    "irc://irc.libera.chat:6697/#srain and ircs://irc.example.net/",
+    "git://github.com/SrainApp/srain.git xmpp://a@b.im",
+    "join #srain and &local, or #a #chan,#other:#third",
+    "mail me at foo.bar+baz@example.com! or foo@bar.com#channel",
+    "ip 192.168.1.1:6667 and 10.0.0.1, 999.1.1.1",
+    "LOCALHOST:80 and Localhost, localhostx",
+    "example.com:99999 example.net:0 a.b c.d e.com x@y.z",
+    "中文https://例子.测试/路径 结束，srain.im。",
+    "xn--fiqs8s.cn, пример.рф and HTTP://EXAMPLE.COM/UPPER",
+    "http://[::1]/ ftp://ftp.example.org/pub/ svn://svn.example.org",
+    "a...b.com@@c.com ##x && ..:: @@",
+};
+
+static void test_combined(void);
+static void test_candidates(void);
+static void test_perf(void);
+static GPtrArray* load_messages(const char *path, GError **err);
+static GRegex* new_regex(const char *pattern);
+static GArray* match_combined(GRegex *regex, const char *str);
+static GArray* match_separately(GRegex **regexes, const char *str);
+
+int main(int argc, char *argv[]){
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/url_renderer/combined", test_combined);
+    g_test_add_func("/url_renderer/candidates", test_candidates);
+    if (g_test_perf()){
+        g_test_add_func("/url_renderer/perf", test_perf);
+    }
+
+    return g_test_run();
+}
+
+static void test_combined(void){
+    GRegex *combined;
+    GRegex *regexes[MATCH_MAX];
+
+    combined = new_regex(COMBINED_PATTERN);
+    for (int i = 0; i < MATCH_MAX; i++){
+        regexes[i] = new_regex(patterns[i]);
+    }
+
+    for (int i = 0; i < G_N_ELEMENTS(samples); i++){
+        GArray *expected;
+        GArray *actual;
+
+        expected = match_separately(regexes, samples[i]);
+        actual = match_combined(combined, samples[i]);
+
+        g_test_message("%s: %u links", samples[i], actual->len);
+        g_assert_cmpuint(actual->len, ==, expected->len);
+        for (int j = 0; j < actual->len; j++){
+            Match *e;
+            Match *a;
+
+            e = &g_array_index(expected, Match, j);
+            a = &g_array_index(actual, Match, j);
+            g_assert_cmpint(a->start, ==, e->start);
+            g_assert_cmpint(a->end, ==, e->end);
+            g_assert_cmpint(a->type, ==, e->type);
+        }
+
+        g_array_free(expected, TRUE);
+        g_array_free(actual, TRUE);
+    }
+
+    for (int i = 0; i < MATCH_MAX; i++){
+        g_regex_unref(regexes[i]);
+    }
+    g_regex_unref(combined);
+}
+
+/* may_render() of url renderer relies on LINK_CANDIDATES */
+static void test_candidates(void){
+    GRegex *combined;
+
+    combined = new_regex(COMBINED_PATTERN);
+    for (int i = 0; i < G_N_ELEMENTS(samples); i++){
+        GArray *matches;
+
+        matches = match_combined(combined, samples[i]);
+        for (int j = 0; j < matches->len; j++){
+            gboolean found;
+            Match *m;
+
+            m = &g_array_index(matches, Match, j);
+            found = FALSE;
+            for (int k = m->start; k < m->end; k++){
+                if (strchr(LINK_CANDIDATES, samples[i][k])
+                        || g_ascii_strncasecmp(samples[i] + k, LOCALHOST,
+                            strlen(LOCALHOST)) == 0){
+                    found = TRUE;
+                    break;
+                }
+            }
+            g_assert_true(found);
+        }
+        g_array_free(matches, TRUE);
+    }
+    g_regex_unref(combined);
+}
+
+static void test_perf(void){
+    double recompiling;
+    double separately;
+    double combined;
+    char *path;
+    GError *err;
+    GPtrArray *msgs;
+    GTimer *timer;
+    GRegex *regex;
+    GRegex *regexes[MATCH_MAX];
+
+    if (g_getenv("SRN_BENCH_SESSION")){
+        path = g_strdup(g_getenv("SRN_BENCH_SESSION"));
+    } else {
+        path = g_test_build_filename(G_TEST_DIST, "bench", "session.log",
+                NULL);
+    }
+    err = NULL;
+    msgs = load_messages(path, &err);
+    if (!msgs){
+        g_test_skip(err->message);
+        g_error_free(err);
+        g_free(path);
+        return;
+    }
+
+    regex = new_regex(COMBINED_PATTERN);
+    for (int i = 0; i < MATCH_MAX; i++){
+        regexes[i] = new_regex(patterns[i]);
+    }
+
+    // Patterns used to be compiled for every match, it is too slow to
+    // replay more than one round
+    timer = g_timer_new();
+    for (int j = 0; j < msgs->len; j++){
+        g_array_free(match_separately(NULL, msgs->pdata[j]), TRUE);
+    }
+    recompiling = msgs->len / g_timer_elapsed(timer, NULL);
+
+    g_timer_start(timer);
+    for (int i = 0; i < PERF_ROUND; i++){
+        for (int j = 0; j < msgs->len; j++){
+            g_array_free(match_separately(regexes, msgs->pdata[j]), TRUE);
+        }
+    }
+    separately = msgs->len * PERF_ROUND / g_timer_elapsed(timer, NULL);
+
+    g_timer_start(timer);
+    for (int i = 0; i < PERF_ROUND; i++){
+        for (int j = 0; j < msgs->len; j++){
+            g_array_free(match_combined(regex, msgs->pdata[j]), TRUE);
+        }
+    }
+    combined = msgs->len * PERF_ROUND / g_timer_elapsed(timer, NULL);
+
+    g_test_maximized_result(combined,
+            "Messages of %s per second: combined: %.0f, "
+            "separately: %.0f, compiled per match: %.0f (%u messages)",
+            path, combined, separately, recompiling, msgs->len);
+
+    g_timer_destroy(timer);
+    for (int i = 0; i < MATCH_MAX; i++){
+        g_regex_unref(regexes[i]);
+    }
+    g_regex_unref(regex);
+    g_ptr_array_free(msgs, TRUE);
+    g_free(path);
+}
+
+/**
+ * @brief load_messages reads contents of PRIVMSGs and NOTICEs from a file
+ * of IRC messages, one per line.
+ *
+ * @return Array of contents, or NULL if failed to read the file.
+ */
+static GPtrArray* load_messages(const char *path, GError **err){
+    char *data;
+    char **lines;
+    GPtrArray *msgs;
+
+    if (!g_file_get_contents(path, &data, NULL, err)){
+        return NULL;
+    }
+    lines = g_strsplit(data, "\n", -1);
+    g_free(data);
+
+    msgs = g_ptr_array_new_with_free_func(g_free);
+    for (int i = 0; lines[i]; i++){
+        const char *content;
+
+        if (!strstr(lines[i], " PRIVMSG ") && !strstr(lines[i], " NOTICE ")){
+            continue;
+        }
+        content = strstr(lines[i], " :");
+        if (content){
+            g_ptr_array_add(msgs, g_strdup(content + 2));
+        }
+    }
+    g_strfreev(lines);
+
+    return msgs;
+}
+
+static GRegex* new_regex(const char *pattern){
+    GError *err;
+    GRegex *regex;
+
+    err = NULL;
+    regex = g_regex_new(pattern, G_REGEX_CASELESS | G_REGEX_OPTIMIZE, 0, &err);
+    g_assert_no_error(err);
+    g_assert_nonnull(regex);
+
+    return regex;
+}
+
+/**
+ * @brief match_combined finds links like url_renderer.c.
+ */
+static GArray* match_combined(GRegex *regex, const char *str){
+    const char *names[MATCH_MAX] = { "url", "host", "channel", "email" };
+    GArray *matches;
+    GMatchInfo *match_info;
+
+    matches = g_array_new(FALSE, FALSE, sizeof(Match));
+    g_regex_match(regex, str, 0, &match_info);
+    while (g_match_info_matches(match_info)){
+        Match m;
+
+        m.type = MATCH_MAX;
+        for (int i = 0; i < MATCH_MAX; i++){
+            if (g_match_info_fetch_named_pos(match_info, names[i],
+                        &m.start, &m.end) && m.start >= 0){
+                m.type = i;
+                break;
+            }
+        }
+        g_assert_cmpint(m.type, !=, MATCH_MAX);
+        g_array_append_val(matches, m);
+        g_match_info_next(match_info, NULL);
+    }
+    g_match_info_free(match_info);
+
+    return matches;
+}
+
+/**
+ * @brief match_separately finds links like url_renderer.c used to do:
+ * every pattern is matched from the end of last link, the leftmost match
+ * wins, and the pattern with smaller MatchType wins a tie.
+ *
+ * @param regexes Compiled patterns, if it is NULL, patterns are compiled
+ *        for every match as url_renderer.c did.
+ */
+static GArray* match_separately(GRegex **regexes, const char *str){
+    const char *ptr;
+    GArray *matches;
+
+    matches = g_array_new(FALSE, FALSE, sizeof(Match));
+    ptr = str;
+    while (*ptr){
+        Match m;
+
+        m.type = MATCH_MAX;
+        m.start = m.end = strlen(ptr);
+        for (int i = 0; i < MATCH_MAX; i++){
+            int start;
+            int end;
+            GRegex *regex;
+            GMatchInfo *match_info;
+
+            regex = regexes ? g_regex_ref(regexes[i]) : new_regex(patterns[i]);
+            g_regex_match(regex, ptr, 0, &match_info);
+            if (g_match_info_matches(match_info)
+                    && g_match_info_fetch_pos(match_info, 0, &start, &end)
+                    && start < m.start){
+                m.start = start;
+                m.end = end;
+                m.type = i;
+            }
+            g_match_info_free(match_info);
+            g_regex_unref(regex);
+        }
+        if (m.type == MATCH_MAX){
+            break;
+        }
+
+        // Positions are relative to ptr
+        m.start += ptr - str;
+        m.end += ptr - str;
+        ptr = str + m.end;
+        g_array_append_val(matches, m);
+    }
+
+    return matches;
+}
@@ -122,17 +122,51 @@ void sui_activate_buffer(SuiBuffer *buf){
 }
 
 void sui_buffer_add_message(SuiBuffer *buf, SuiMessage *msg){
-    GType type;
     SuiWindow *win;
     SuiSideBar *sidebar;
     SuiSideBarItem *item;
-    SuiMessageList *list;
 
     g_return_if_fail(SUI_IS_BUFFER(buf));
     g_return_if_fail(SUI_IS_MESSAGE(msg));
 
     /* Add message */
+    sui_buffer_insert_message(buf, msg);
+
+    /* Update side bar */
+    win = SUI_WINDOW(gtk_widget_get_toplevel(GTK_WIDGET(buf)));
+    g_return_if_fail(SUI_IS_WINDOW(win));
+
+    sidebar = sui_window_get_side_bar(win);
+    item = sui_side_bar_get_item(sidebar, buf);
+    sui_message_update_side_bar_item(msg, item);
+
+    if (buf == sui_common_get_cur_buffer()){
+        // Don't show counter while buffer is active
+        sui_side_bar_item_clear_count(item);
+    }
+}
+
+/**
+ * @brief ``sui_buffer_insert_message`` adds message to the message list of
+ * ``buf`` without updating side bar, it is used for the message which has
+ * been accounted by ``sui_buffer_add_pending_message``.
+ *
+ * @param buf
+ * @param msg
+ */
+void sui_buffer_insert_message(SuiBuffer *buf, SuiMessage *msg){
+    GType type;
+    SuiMessageList *list;
+
+    g_return_if_fail(SUI_IS_BUFFER(buf));
+    g_return_if_fail(SUI_IS_MESSAGE(msg));
+
     sui_message_set_buffer(msg, buf);
+    if (!sui_buffer_is_content_built(buf)){
+        // Message list will be built when buffer is shown
+        sui_buffer_queue_message(buf, msg);
+        return;
+    }
     sui_message_update(msg);
     list = sui_buffer_get_message_list(buf);
     type = G_OBJECT_TYPE(msg);
@@ -145,25 +179,84 @@ void sui_buffer_add_message(SuiBuffer *buf, SuiMessage *msg){
     } else {
         g_warn_if_reached();
     }
+}
+
+/**
+ * @brief ``sui_buffer_prepend_message`` adds message to the top of message
+ * list of ``buf`` without updating side bar, it is used for the message
+ * which is older than all existing messages, such as scrollback history.
+ *
+ * @param buf
+ * @param msg
+ */
+void sui_buffer_prepend_message(SuiBuffer *buf, SuiMessage *msg){
+    GType type;
+    SuiMessageList *list;
+
+    g_return_if_fail(SUI_IS_BUFFER(buf));
+    g_return_if_fail(SUI_IS_MESSAGE(msg));
+
+    sui_buffer_build_content(buf);
+    sui_message_set_buffer(msg, buf);
+    sui_message_update(msg);
+    list = sui_buffer_get_message_list(buf);
+    type = G_OBJECT_TYPE(msg);
+    if (type == SUI_TYPE_MISC_MESSAGE){
+        sui_message_list_prepend_message(list, msg, GTK_ALIGN_CENTER);
+    } else if (type == SUI_TYPE_SEND_MESSAGE){
+        sui_message_list_prepend_message(list, msg, GTK_ALIGN_END);
+    } else if (type == SUI_TYPE_RECV_MESSAGE){
+        sui_message_list_prepend_message(list, msg, GTK_ALIGN_START);
+    } else {
+        g_warn_if_reached();
+    }
+}
+
+/**
+ * @brief ``sui_buffer_add_pending_message`` updates the side bar item of
+ * ``buf`` for a message whose SuiMessage has not been created yet.
+ *
+ * @param buf
+ * @param nick is markup sender of message, can be NULL.
+ * @param content is markup content of message.
+ */
+void sui_buffer_add_pending_message(SuiBuffer *buf, const char *nick,
+        const char *content){
+    SuiWindow *win;
+    SuiSideBar *sidebar;
+    SuiSideBarItem *item;
+
+    g_return_if_fail(SUI_IS_BUFFER(buf));
 
-    /* Update side bar */
     win = SUI_WINDOW(gtk_widget_get_toplevel(GTK_WIDGET(buf)));
     g_return_if_fail(SUI_IS_WINDOW(win));
 
     sidebar = sui_window_get_side_bar(win);
     item = sui_side_bar_get_item(sidebar, buf);
-    sui_message_update_side_bar_item(msg, item);
-
-    if (buf == sui_common_get_cur_buffer()){
-        // Don't show counter while buffer is active
-        sui_side_bar_item_clear_count(item);
-    }
+    sui_side_bar_item_update(item, nick, content);
+    sui_side_bar_item_inc_count(item);
 }
 
 void sui_free_message(SuiMessage *msg){
     // TODO
 }
 
+/**
+ * @brief ``sui_update_message_content`` refreshes the content of ``msg``
+ * after it is changed, such as a repeated message is collapsed into it.
+ * Other parts of message (sender, time, URL previewers...) are not touched.
+ *
+ * @param msg
+ */
+void sui_update_message_content(SuiMessage *msg){
+    g_return_if_fail(SUI_IS_MESSAGE(msg));
+
+    if (!sui_message_get_buffer(msg)){
+        return; // Not yet added to buffer
+    }
+    sui_message_update_content(msg);
+}
+
 /**
  * @brief ``sui_notify_message`` sends a notification about the ``msg`` as
  * appropriate.
@@ -232,12 +325,22 @@ void sui_free_user(SuiUser *user){
     sui_user_free(user);
 }
 
+/* The user list of a SuiChatBuffer is not built until the buffer is shown,
+ * it is filled with the joined users of chat at that time, so changes made
+ * before that can be simply ignored. */
+
 void sui_update_user(SuiBuffer *buf, SuiUser *user){
+    SuiUserList *list;
+
     g_return_if_fail(SUI_IS_CHAT_BUFFER(buf));
     g_return_if_fail(user);
 
-    sui_user_list_update_user(
-            sui_chat_buffer_get_user_list(SUI_CHAT_BUFFER(buf)), user);
+    list = sui_chat_buffer_get_user_list(SUI_CHAT_BUFFER(buf));
+    if (!list){
+        return;
+    }
+
+    sui_user_list_update_user(list, user);
 }
 
 void sui_add_user(SuiBuffer *buf, SuiUser *user){
@@ -249,6 +352,9 @@ void sui_add_user(SuiBuffer *buf, SuiUser *user){
 
     chat_buf = SUI_CHAT_BUFFER(buf);
     list = sui_chat_buffer_get_user_list(chat_buf);
+    if (!list){
+        return;
+    }
 
     sui_user_list_add_user(list, user);
 }
@@ -262,10 +368,32 @@ void sui_rm_user(SuiBuffer *buf, SuiUser *user){
 
     chat_buf = SUI_CHAT_BUFFER(buf);
     list = sui_chat_buffer_get_user_list(chat_buf);
+    if (!list){
+        return;
+    }
 
     sui_user_list_rm_user(list, user);
 }
 
+/**
+ * @brief ``sui_freeze_users`` and ``sui_thaw_users`` wrap a batch of
+ * ``sui_add_user`` and ``sui_rm_user`` calls, the user list of ``buf`` is
+ * updated only once when it is thawed.
+ *
+ * @param buf
+ */
+void sui_freeze_users(SuiBuffer *buf){
+    g_return_if_fail(SUI_IS_CHAT_BUFFER(buf));
+
+    sui_chat_buffer_freeze_user_list(SUI_CHAT_BUFFER(buf));
+}
+
+void sui_thaw_users(SuiBuffer *buf){
+    g_return_if_fail(SUI_IS_CHAT_BUFFER(buf));
+
+    sui_chat_buffer_thaw_user_list(SUI_CHAT_BUFFER(buf));
+}
+
 void sui_set_topic(SuiBuffer *buf, const char *topic){
     SuiBuffer *buffer;
 
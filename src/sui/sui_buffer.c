@@ -42,6 +42,7 @@
 #include "utils.h"
 
 static GtkListStore* real_completion_func(SuiBuffer *self, const char *context);
+static void real_build_content(SuiBuffer *self);
 static bool push_input_history(SuiBuffer *self, char *msg);
 static void start_browse_input(SuiBuffer *self);
 static void reset_browse_input(SuiBuffer *self);
@@ -132,14 +133,7 @@ static void sui_buffer_init(SuiBuffer *self){
             GTK_WIDGET(self->topic_menu_item));
     g_object_unref(builder);
 
-    /* Init msg list */
-    self->msg_list = sui_message_list_new();
-    gtk_box_pack_start(self->msg_list_box, GTK_WIDGET(self->msg_list),
-            TRUE, TRUE, 0);
-    gtk_widget_show(GTK_WIDGET(self->msg_list));
-
-    /* Setup completion */
-    self->completion = sui_completion_new(self->input_text_buffer);
+    /* Message list and completion are built by sui_buffer_build_content() */
 
     g_signal_connect(self->topic_label, "activate-link",
             G_CALLBACK(sui_common_activate_gtk_label_link), self);
@@ -158,6 +152,12 @@ static void sui_buffer_constructed(GObject *object){
 }
 
 static void sui_buffer_finalize(GObject *object){
+    SuiBuffer *self;
+
+    self = SUI_BUFFER(object);
+    g_list_free_full(self->pending_msg_list, g_object_unref);
+    self->pending_msg_list = NULL;
+
     G_OBJECT_CLASS(sui_buffer_parent_class)->finalize(object);
 }
 
@@ -223,6 +223,7 @@ static void sui_buffer_class_init(SuiBufferClass *class){
     gtk_widget_class_bind_template_child(widget_class, SuiBuffer, input_text_buffer);
 
     class->completion_func = real_completion_func;
+    class->build_content = real_build_content;
 }
 
 
@@ -238,6 +239,55 @@ SuiBuffer* sui_buffer_new(void *ctx, SuiBufferEvents *events, SuiBufferConfig *c
             NULL);
 }
 
+/**
+ * @brief sui_buffer_build_content builds the message list, completion and
+ * other widgets which are only useful when the buffer is shown.
+ *
+ * A buffer only holds its side bar item and template widgets after creation,
+ * this function is called when it is selected at the first time, calling it
+ * again does nothing.
+ *
+ * @param self
+ */
+void sui_buffer_build_content(SuiBuffer *self){
+    SuiBufferClass *class;
+
+    g_return_if_fail(SUI_IS_BUFFER(self));
+
+    if (self->content_built){
+        return;
+    }
+    self->content_built = TRUE;
+
+    DBG_FR("Building content of buffer %s", sui_buffer_get_name(self));
+
+    class = SUI_BUFFER_GET_CLASS(self);
+    g_return_if_fail(class->build_content);
+    class->build_content(self);
+}
+
+bool sui_buffer_is_content_built(SuiBuffer *self){
+    g_return_val_if_fail(SUI_IS_BUFFER(self), FALSE);
+
+    return self->content_built;
+}
+
+/**
+ * @brief sui_buffer_queue_message keeps the message which is added before the
+ * message list is built, it is moved to the message list by
+ * sui_buffer_build_content().
+ *
+ * @param self
+ * @param msg
+ */
+void sui_buffer_queue_message(SuiBuffer *self, SuiMessage *msg){
+    g_return_if_fail(SUI_IS_BUFFER(self));
+    g_return_if_fail(!self->content_built);
+
+    self->pending_msg_list = g_list_prepend(self->pending_msg_list,
+            g_object_ref_sink(msg));
+}
+
 void sui_buffer_insert_text(SuiBuffer *self, const char *text, int line, int offset){
     GtkTextMark *insert;
     GtkTextIter iter;
@@ -270,6 +320,8 @@ void sui_buffer_show_topic(SuiBuffer *self, bool isshow){
  * @param self
  */
 void sui_buffer_complete(SuiBuffer *self){
+    g_return_if_fail(self->completion);
+
     sui_completion_complete(self->completion, sui_buffer_completion_func, self);
 }
 
@@ -483,6 +535,27 @@ static void topic_menu_item_on_toggled(GtkWidget* widget, gpointer user_data){
     }
 }
 
+static void real_build_content(SuiBuffer *self){
+    GList *lst;
+
+    /* Init msg list */
+    self->msg_list = sui_message_list_new();
+    gtk_box_pack_start(self->msg_list_box, GTK_WIDGET(self->msg_list),
+            TRUE, TRUE, 0);
+    gtk_widget_show(GTK_WIDGET(self->msg_list));
+
+    /* Setup completion */
+    self->completion = sui_completion_new(self->input_text_buffer);
+
+    /* Move queued messages to message list */
+    self->pending_msg_list = g_list_reverse(self->pending_msg_list);
+    for (lst = self->pending_msg_list; lst; lst = g_list_next(lst)){
+        sui_buffer_insert_message(self, lst->data);
+    }
+    g_list_free_full(self->pending_msg_list, g_object_unref);
+    self->pending_msg_list = NULL;
+}
+
 static GtkListStore* real_completion_func(SuiBuffer *self, const char *context){
     const char *prev;
     const char *prefix;
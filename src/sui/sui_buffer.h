@@ -56,9 +56,12 @@ struct _SuiBuffer {
     /* Message list */
     GtkBox *msg_list_box;
     SuiMessageList *msg_list;
+    GList *pending_msg_list; // SuiMessages added before msg_list is built
 
     GtkTextBuffer *input_text_buffer;
     SuiCompletion *completion;
+
+    bool content_built; // Whether msg_list and etc. have been built
     GList *input_history;
     GList *input_history_iter;
     GList *input_stage;
@@ -70,10 +73,16 @@ struct _SuiBufferClass {
     // SuiBuffer and its child class should implement this functions for input
     // completing.
     GtkListStore* (*completion_func)(SuiBuffer *self, const char *context);
+    // Build the widgets which are not needed until buffer is shown, child
+    // class should chain up.
+    void (*build_content)(SuiBuffer *self);
 };
 
 GType sui_buffer_get_type(void);
 
+void sui_buffer_build_content(SuiBuffer *self);
+bool sui_buffer_is_content_built(SuiBuffer *self);
+void sui_buffer_queue_message(SuiBuffer *self, SuiMessage *msg);
 void sui_buffer_insert_text(SuiBuffer *self, const char *text, int line, int offset);
 void sui_buffer_show_topic(SuiBuffer *self, bool show);
 void sui_buffer_complete(SuiBuffer *self);
@@ -27,6 +27,8 @@
 #include <gtk/gtk.h>
 #include <string.h>
 
+#include "core/core.h"
+
 #include "sui_buffer.h"
 #include "sui_chat_buffer.h"
 
@@ -116,11 +118,8 @@ static void sui_chat_buffer_init(SuiChatBuffer *self){
             GTK_MENU_SHELL(sui_buffer_get_menu(SUI_BUFFER(self))),
             GTK_WIDGET(self->user_list_menu_item));
     g_object_unref(builder);
-    
-    /* Init user list*/
-    self->user_list = sui_user_list_new();
-    gtk_container_add(GTK_CONTAINER(self->parent.user_list_revealer), // FIXME
-            GTK_WIDGET(self->user_list));
+
+    /* User list is built by sui_chat_buffer_build_content() */
 
     gtk_widget_show(GTK_WIDGET(self->user_list_menu_item));
 
@@ -136,6 +135,38 @@ static void sui_chat_buffer_finalize(GObject *object){
     G_OBJECT_CLASS(sui_chat_buffer_parent_class)->finalize(object);
 }
 
+static void sui_chat_buffer_build_content(SuiBuffer *_self){
+    SrnChat *ctx;
+    SuiChatBuffer *self;
+
+    SUI_BUFFER_CLASS(sui_chat_buffer_parent_class)->build_content(_self);
+
+    self = SUI_CHAT_BUFFER(_self);
+    ctx = sui_buffer_get_ctx(_self);
+
+    /* Init user list*/
+    self->user_list = sui_user_list_new();
+    gtk_container_add(GTK_CONTAINER(self->parent.user_list_revealer), // FIXME
+            GTK_WIDGET(self->user_list));
+
+    /* Keep freezes which happened before user list is built */
+    for (int i = 0; i < self->user_list_freeze_count; i++){
+        sui_user_list_freeze(self->user_list);
+    }
+
+    /* Fill with users who have joined */
+    sui_user_list_freeze(self->user_list);
+    for (GList *lst = ctx->user_list; lst; lst = g_list_next(lst)){
+        SrnChatUser *user;
+
+        user = lst->data;
+        if (user->is_joined){
+            sui_user_list_add_user(self->user_list, user->ui);
+        }
+    }
+    sui_user_list_thaw(self->user_list);
+}
+
 static GtkListStore* sui_chat_buffer_completion_func(SuiBuffer *_self,
         const char *context){
     const char *prev;
@@ -214,6 +245,7 @@ static void sui_chat_buffer_class_init(SuiChatBufferClass *class){
     buffer_class = SUI_BUFFER_CLASS(class);
 
     buffer_class->completion_func = sui_chat_buffer_completion_func;
+    buffer_class->build_content = sui_chat_buffer_build_content;
 }
 
 /*****************************************************************************
@@ -228,6 +260,29 @@ SuiUserList* sui_chat_buffer_get_user_list(SuiChatBuffer *self){
     return self->user_list;
 }
 
+/**
+ * @brief sui_chat_buffer_freeze_user_list freezes the user list, if the user
+ * list is not yet built, the freeze is applied once it is built.
+ * Every call should be paired with a sui_chat_buffer_thaw_user_list().
+ *
+ * @param self
+ */
+void sui_chat_buffer_freeze_user_list(SuiChatBuffer *self){
+    self->user_list_freeze_count++;
+    if (self->user_list){
+        sui_user_list_freeze(self->user_list);
+    }
+}
+
+void sui_chat_buffer_thaw_user_list(SuiChatBuffer *self){
+    g_return_if_fail(self->user_list_freeze_count > 0);
+
+    self->user_list_freeze_count--;
+    if (self->user_list){
+        sui_user_list_thaw(self->user_list);
+    }
+}
+
 void sui_chat_buffer_show_user_list(SuiChatBuffer *self, bool isshow){
     gtk_check_menu_item_set_active(self->user_list_menu_item, isshow);
 }
@@ -36,7 +36,8 @@ struct _SuiChatBuffer {
 
     GtkCheckMenuItem *user_list_menu_item;
     GtkRevealer *user_list_revealer;
-    SuiUserList *user_list;
+    SuiUserList *user_list; // Built when buffer is shown
+    int user_list_freeze_count;
 };
 
 struct _SuiChatBufferClass {
@@ -51,5 +52,7 @@ GType sui_chat_buffer_get_type(void);
 void sui_chat_buffer_show_user_list(SuiChatBuffer *self, bool isshow);
 SuiServerBuffer* sui_chat_buffer_get_server_buffer(SuiChatBuffer *self);
 SuiUserList* sui_chat_buffer_get_user_list(SuiChatBuffer *self);
+void sui_chat_buffer_freeze_user_list(SuiChatBuffer *self);
+void sui_chat_buffer_thaw_user_list(SuiChatBuffer *self);
 
 #endif /* __SUI_CHAT_BUFFER_H */
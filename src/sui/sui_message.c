@@ -41,6 +41,7 @@
 #include "i18n.h"
 #include "meta.h"
 #include "utils.h"
+#include "intern.h"
 
 static void sui_message_real_update(SuiMessage *self);
 static void sui_message_real_update_side_bar_item(SuiMessage *self,
@@ -50,7 +51,12 @@ static void sui_message_real_compose_next(SuiMessage *self, SuiMessage *next);
 static SuiNotification* sui_message_real_new_notification(SuiMessage *self);
 
 static void sui_message_set_ctx(SuiMessage *self, void *ctx);
+static void sui_message_set_content(SuiMessage *self);
 
+static bool spans_has_link(GArray *spans);
+static PangoAttrList* spans_to_attr_list(GArray *spans);
+static void attr_list_insert_range(PangoAttrList *attrs, PangoAttribute *attr,
+        int start, int end);
 static char* label_get_selection(GtkLabel *label);
 static void copy_menu_item_on_activate(GtkWidget* widget, gpointer user_data);
 static void froward_submenu_item_on_activate(GtkWidget* widget, gpointer user_data);
@@ -154,6 +160,7 @@ static void sui_message_class_init(SuiMessageClass *class){
             obj_properties);
 
     class->update = sui_message_real_update;
+    class->update_content = sui_message_set_content;
     class->update_side_bar_item = sui_message_real_update_side_bar_item;
     class->compose_prev = sui_message_real_compose_prev;
     class->compose_next = sui_message_real_compose_next;
@@ -168,6 +175,30 @@ void* sui_message_get_ctx(SuiMessage *self){
     return self->ctx;
 }
 
+/**
+ * @brief sui_message_set_content_markup sets the markup of message label, a
+ * counter is appended if repeated messages are collapsed into this one.
+ *
+ * @param self
+ * @param markup
+ */
+void sui_message_set_content_markup(SuiMessage *self, const char *markup){
+    char *counted;
+
+    // Attributes set by sui_message_set_content() would be merged with markup
+    gtk_label_set_attributes(self->message_label, NULL);
+
+    if (self->ctx->repeat_count <= 1){
+        gtk_label_set_markup(self->message_label, markup);
+        return;
+    }
+
+    counted = g_strdup_printf("%s <small><b>×%d</b></small>",
+            markup, self->ctx->repeat_count);
+    gtk_label_set_markup(self->message_label, counted);
+    g_free(counted);
+}
+
 void sui_message_set_buffer(SuiMessage *self, SuiBuffer *buf){
     self->buf = buf;
 }
@@ -186,6 +217,16 @@ void sui_message_update(SuiMessage *self){
     class->update(self);
 }
 
+void sui_message_update_content(SuiMessage *self){
+    SuiMessageClass *class;
+
+    g_return_if_fail(SUI_IS_MESSAGE(self));
+    class = SUI_MESSAGE_GET_CLASS(self);
+    g_return_if_fail (class->update_content);
+
+    class->update_content(self);
+}
+
 void sui_message_update_side_bar_item(SuiMessage *self, SuiSideBarItem *item){
     SuiMessageClass *class;
 
@@ -206,7 +247,7 @@ void sui_message_compose_prev(SuiMessage *self, SuiMessage *prev){
 
     // Only compose messages sent by same user.
     if (self->ctx->sender != prev->ctx->sender
-            || g_ascii_strcasecmp(self->ctx->rendered_sender, prev->ctx->rendered_sender) != 0){
+            || !srn_intern_equal(self->ctx->rendered_sender, prev->ctx->rendered_sender)){
         return;
     }
 
@@ -223,7 +264,7 @@ void sui_message_compose_next(SuiMessage *self, SuiMessage *next){
 
     // Only compose messages sent by same user.
     if (self->ctx->sender != next->ctx->sender
-            || g_ascii_strcasecmp(self->ctx->rendered_sender, next->ctx->rendered_sender) != 0){
+            || !srn_intern_equal(self->ctx->rendered_sender, next->ctx->rendered_sender)){
         return;
     }
 
@@ -301,15 +342,47 @@ const char* sui_message_get_time(SuiMessage *self){
 
     ctx = sui_message_get_ctx(self);
 
-    return ctx->rendered_short_time;
+    return srn_message_get_short_time(ctx);
 }
 
-const char* sui_message_get_full_time(SuiMessage *self){
+/**
+ * @brief sui_message_get_full_time
+ *
+ * @param self
+ *
+ * @return Full format time of message, should be freed by g_free().
+ */
+char* sui_message_get_full_time(SuiMessage *self){
     SrnMessage *ctx;
 
     ctx = sui_message_get_ctx(self);
 
-    return ctx->rendered_full_time;
+    return srn_message_get_full_time(ctx);
+}
+
+/**
+ * @brief sui_message_time_on_query_tooltip shows full format time of message
+ * as tooltip, it is only formatted when the tooltip is about to be shown.
+ *
+ * @param widget must has property "has-tooltip" set.
+ * @param x
+ * @param y
+ * @param keyboard_mode
+ * @param tooltip
+ * @param user_data is a SuiMessage.
+ *
+ * @return
+ */
+gboolean sui_message_time_on_query_tooltip(GtkWidget *widget, int x, int y,
+        gboolean keyboard_mode, GtkTooltip *tooltip, gpointer user_data){
+    char *full_time;
+
+    full_time = sui_message_get_full_time(SUI_MESSAGE(user_data));
+    g_return_val_if_fail(full_time, FALSE);
+    gtk_tooltip_set_text(tooltip, full_time);
+    g_free(full_time);
+
+    return TRUE;
 }
 
 bool sui_message_is_mentioned(SuiMessage *self){
@@ -328,7 +401,7 @@ static void sui_message_real_update(SuiMessage *self){
     GtkStyleContext *style_context;
 
     // Update message content
-    gtk_label_set_markup(self->message_label, self->ctx->rendered_content);
+    sui_message_update_content(self);
 
     // Show url previewer if needed
     if (self->buf->cfg->preview_url) {
@@ -566,6 +639,142 @@ static void url_previewer_on_notify_content_type(GObject *object,
     }
 }
 
+/**
+ * @brief sui_message_set_content sets the content of message label from the
+ * plain text and spans of rendered message, so that GTK needs not to parse
+ * markup. Fallback to rendered markup if there is no span or there is any
+ * link, which can only be activated when the label uses markup.
+ *
+ * @param self
+ */
+static void sui_message_set_content(SuiMessage *self){
+    int len;
+    GString *text;
+    PangoAttrList *attrs;
+
+    if (!self->ctx->rendered_spans || spans_has_link(self->ctx->rendered_spans)){
+        sui_message_set_content_markup(self, self->ctx->rendered_content);
+        return;
+    }
+
+    text = g_string_new(srn_message_get_plain_content(self->ctx));
+    attrs = spans_to_attr_list(self->ctx->rendered_spans);
+
+    if (self->ctx->repeat_count > 1){
+        g_string_append_c(text, ' ');
+        len = text->len;
+        g_string_append_printf(text, "×%d", self->ctx->repeat_count);
+        attr_list_insert_range(attrs,
+                pango_attr_scale_new(PANGO_SCALE_SMALL), len, text->len);
+        attr_list_insert_range(attrs,
+                pango_attr_weight_new(PANGO_WEIGHT_BOLD), len, text->len);
+    }
+
+    gtk_label_set_text(self->message_label, text->str);
+    gtk_label_set_attributes(self->message_label, attrs);
+
+    pango_attr_list_unref(attrs);
+    g_string_free(text, TRUE);
+}
+
+static bool spans_has_link(GArray *spans){
+    for (int i = 0; i < spans->len; i++){
+        SrnRenderSpan *span;
+
+        span = &g_array_index(spans, SrnRenderSpan, i);
+        if (span->type == SRN_RENDER_SPAN_LINK){
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+static PangoAttrList* spans_to_attr_list(GArray *spans){
+    PangoAttrList *attrs;
+
+    attrs = pango_attr_list_new();
+    for (int i = 0; i < spans->len; i++){
+        PangoColor color;
+        SrnRenderSpan *span;
+
+        span = &g_array_index(spans, SrnRenderSpan, i);
+        switch (span->type){
+            case SRN_RENDER_SPAN_BOLD:
+                attr_list_insert_range(attrs,
+                        pango_attr_weight_new(PANGO_WEIGHT_BOLD),
+                        span->start, span->end);
+                break;
+            case SRN_RENDER_SPAN_ITALICS:
+                attr_list_insert_range(attrs,
+                        pango_attr_style_new(PANGO_STYLE_ITALIC),
+                        span->start, span->end);
+                break;
+            case SRN_RENDER_SPAN_UNDERLINE:
+                attr_list_insert_range(attrs,
+                        pango_attr_underline_new(PANGO_UNDERLINE_SINGLE),
+                        span->start, span->end);
+                break;
+            case SRN_RENDER_SPAN_STRIKETHROUGH:
+                attr_list_insert_range(attrs,
+                        pango_attr_strikethrough_new(TRUE),
+                        span->start, span->end);
+                break;
+            case SRN_RENDER_SPAN_MONOSPACE:
+                attr_list_insert_range(attrs,
+                        pango_attr_family_new("monospace"),
+                        span->start, span->end);
+                break;
+            case SRN_RENDER_SPAN_FOREGROUND:
+                if (!span->value || !pango_color_parse(&color, span->value)){
+                    WARN_FR("Invalid foreground color: %s", span->value);
+                    break;
+                }
+                attr_list_insert_range(attrs,
+                        pango_attr_foreground_new(
+                            color.red, color.green, color.blue),
+                        span->start, span->end);
+                break;
+            case SRN_RENDER_SPAN_BACKGROUND:
+                if (!span->value || !pango_color_parse(&color, span->value)){
+                    WARN_FR("Invalid background color: %s", span->value);
+                    break;
+                }
+                attr_list_insert_range(attrs,
+                        pango_attr_background_new(
+                            color.red, color.green, color.blue),
+                        span->start, span->end);
+                break;
+            case SRN_RENDER_SPAN_MENTION:
+                pango_color_parse(&color, SRN_RENDER_MENTION_COLOR);
+                attr_list_insert_range(attrs,
+                        pango_attr_foreground_new(
+                            color.red, color.green, color.blue),
+                        span->start, span->end);
+                attr_list_insert_range(attrs,
+                        pango_attr_weight_new(PANGO_WEIGHT_BOLD),
+                        span->start, span->end);
+                break;
+            default:
+                g_warn_if_reached();
+        }
+    }
+
+    return attrs;
+}
+
+/**
+ * @brief attr_list_insert_range applies attribute to byte range [start, end)
+ * of text, ownership of attribute is transferred to list.
+ */
+static void attr_list_insert_range(PangoAttrList *attrs, PangoAttribute *attr,
+        int start, int end){
+    attr->start_index = start;
+    attr->end_index = end;
+    // Later spans take precedence over earlier ones, like nested markup
+    pango_attr_list_insert(attrs, attr);
+}
+
 /**
  * @brief Get the selected text (utf-8 supported) of `label`.
  * If no text was selected, return all of the text in this label.
@@ -70,6 +70,8 @@ struct _SuiMessageClass {
 
     // Update the view of SuiMessage according self->ctx
     void (*update) (SuiMessage *self);
+    // Update only the content of message_label according self->ctx
+    void (*update_content) (SuiMessage *self);
     // Update the view of SuiSidebarItem
     void (*update_side_bar_item) (SuiMessage *self, SuiSideBarItem *item);
     // Compose self to previous message
@@ -83,20 +85,24 @@ struct _SuiMessageClass {
 GType sui_message_get_type(void);
 
 void sui_message_update(SuiMessage *self);
+void sui_message_update_content(SuiMessage *self);
 void sui_message_update_side_bar_item(SuiMessage *self, SuiSideBarItem *item);
 void sui_message_compose_prev(SuiMessage *self, SuiMessage *prev);
 void sui_message_compose_next(SuiMessage *self, SuiMessage *next);
 SuiNotification* sui_message_new_notification(SuiMessage *self);
 
 void* sui_message_get_ctx(SuiMessage *self);
+void sui_message_set_content_markup(SuiMessage *self, const char *markup);
 void sui_message_set_buffer(SuiMessage *self, SuiBuffer *buf);
 SuiBuffer* sui_message_get_buffer(SuiMessage *self);
 SuiMessage* sui_message_get_prev(SuiMessage *self);
 SuiMessage* sui_message_get_next(SuiMessage *self);
 const char* sui_message_get_time(SuiMessage *self);
-const char* sui_message_get_full_time(SuiMessage *self);
+char* sui_message_get_full_time(SuiMessage *self);
 bool sui_message_is_mentioned(SuiMessage *self);
 
 void sui_message_label_on_popup(GtkLabel *label, GtkMenu *menu, gpointer user_data);
+gboolean sui_message_time_on_query_tooltip(GtkWidget *widget, int x, int y,
+        gboolean keyboard_mode, GtkTooltip *tooltip, gpointer user_data);
 
 #endif /* __SUI_MESSAGE_H */
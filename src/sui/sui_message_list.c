@@ -186,7 +186,6 @@ void sui_message_list_append_message(SuiMessageList *self, SuiMessage *msg,
 
 void sui_message_list_prepend_message(SuiMessageList *self, SuiMessage *msg,
         GtkAlign halign){
-    GtkBox *box;
     GtkListBoxRow *row;
 
     if (self->first_msg
@@ -199,10 +198,9 @@ void sui_message_list_prepend_message(SuiMessageList *self, SuiMessage *msg,
         self->last_msg = msg;
     }
 
-    box = GTK_BOX(gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 0));
-    gtk_box_pack_start(box, GTK_WIDGET(msg), TRUE, TRUE, 0);
-    gtk_widget_set_halign(GTK_WIDGET(msg), halign);
-    row = sui_common_unfocusable_list_box_row_new(GTK_WIDGET(box));
+    // Same as sui_message_list_append_message(), message is the direct
+    // child of row
+    row = sui_common_unfocusable_list_box_row_new(GTK_WIDGET(msg));
     gtk_list_box_prepend(self->list_box, GTK_WIDGET(row));
     self->first_row = row;
     if (!self->last_row) {
@@ -33,6 +33,7 @@ GType sui_message_list_get_type(void);
 SuiMessageList *sui_message_list_new(void);
 
 void sui_message_list_add_message(SuiMessageList *self, SuiMessage *msg, GtkAlign halign);
+void sui_message_list_prepend_message(SuiMessageList *self, SuiMessage *msg, GtkAlign halign);
 GList *sui_message_list_get_recent_messages(SuiMessageList *self, int limit);
 
 void sui_message_list_scroll_up(SuiMessageList *self, double step);
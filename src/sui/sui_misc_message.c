@@ -32,7 +32,7 @@
 #include "utils.h"
 #include "i18n.h"
 
-static void sui_misc_message_update(SuiMessage *_self);
+static void sui_misc_message_update_content(SuiMessage *_self);
 static void sui_misc_message_update_side_bar_item(SuiMessage *_self,
         SuiSideBarItem *item);
 static void sui_misc_message_compose_prev(SuiMessage *_self, SuiMessage *_prev);
@@ -97,6 +97,9 @@ static void sui_misc_message_init(SuiMiscMessage *self){
             G_CALLBACK(sui_common_activate_gtk_label_link), self);
     g_signal_connect(SUI_MESSAGE(self)->message_label, "populate-popup",
             G_CALLBACK(sui_message_label_on_popup), self);
+    gtk_widget_set_has_tooltip(GTK_WIDGET(SUI_MESSAGE(self)->message_label), TRUE);
+    g_signal_connect(SUI_MESSAGE(self)->message_label, "query-tooltip",
+            G_CALLBACK(sui_message_time_on_query_tooltip), self);
 }
 
 static void sui_misc_message_class_init(SuiMiscMessageClass *class){
@@ -129,15 +132,14 @@ static void sui_misc_message_class_init(SuiMiscMessageClass *class){
     gtk_widget_class_bind_template_child(widget_class, SuiMessage, message_label);
 
     message_class = SUI_MESSAGE_CLASS(class);
-    message_class->update = sui_misc_message_update;
+    message_class->update_content = sui_misc_message_update_content;
     message_class->update_side_bar_item = sui_misc_message_update_side_bar_item;
     message_class->compose_prev = sui_misc_message_compose_prev;
     message_class->compose_next = sui_misc_message_compose_next;
     message_class->new_notification = sui_misc_message_new_notification;
 }
 
-static void sui_misc_message_update(SuiMessage *_self){
-    const char *full_time;
+static void sui_misc_message_update_content(SuiMessage *_self){
     SrnMessage *ctx;
     SuiMiscMessage *self;
 
@@ -145,20 +147,17 @@ static void sui_misc_message_update(SuiMessage *_self){
     g_return_if_fail(ctx);
     self = SUI_MISC_MESSAGE(_self);
 
-    full_time = sui_message_get_full_time(_self);
-    g_return_if_fail(full_time);
-    gtk_widget_set_tooltip_text(GTK_WIDGET(_self->message_label), full_time);
-
-    SUI_MESSAGE_CLASS(sui_misc_message_parent_class)->update(_self);
-
     /* Override the content of message_label */
     if (self->style == SUI_MISC_MESSAGE_STYLE_ACTION) {
         char *action_msg;
 
         action_msg = g_strdup_printf("<b>%s</b> %s", ctx->rendered_sender, ctx->rendered_content);
-        gtk_label_set_markup(_self->message_label, action_msg);
+        sui_message_set_content_markup(_self, action_msg);
         g_free(action_msg);
+        return;
     }
+
+    SUI_MESSAGE_CLASS(sui_misc_message_parent_class)->update_content(_self);
 }
 
 static void sui_misc_message_update_side_bar_item(SuiMessage *_self,
@@ -244,6 +244,8 @@ on_child_changed(GtkWidget *widget, GParamSpec *pspec, SuiSideBar *sidebar){
         gtk_list_box_select_row(sidebar->list, GTK_LIST_BOX_ROW(row));
     }
 
+    // Buffer is shown at the first time
+    sui_buffer_build_content(buf);
     sui_buffer_event_hdr(buf, SUI_EVENT_CUTOVER, NULL);
 }
 
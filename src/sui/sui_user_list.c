@@ -52,6 +52,7 @@ struct _SuiUserList {
     GtkListStore *user_list_store;
     GtkTreeModel *user_tree_model_filter;   // FilterTreeModel of user_list_store
                                             // TODO: user search
+    int freeze_count;
 };
 
 struct _SuiUserListClass {
@@ -138,6 +139,45 @@ void sui_user_list_update_user(SuiUserList *self, SuiUser *user){
             gtk_widget_get_window(GTK_WIDGET(self)));
 }
 
+/**
+ * @brief sui_user_list_freeze stops sorting and displaying the user list,
+ * so that a large number of users can be added or removed quickly.
+ * Every call should be paired with a sui_user_list_thaw().
+ *
+ * @param self
+ */
+void sui_user_list_freeze(SuiUserList *self){
+    if (self->freeze_count++ > 0){
+        return;
+    }
+
+    g_signal_handlers_block_by_func(self->user_list_store,
+            user_list_store_on_row_changed, self);
+    gtk_tree_view_set_model(self->user_tree_view, NULL);
+    gtk_tree_sortable_set_sort_column_id(
+            GTK_TREE_SORTABLE(self->user_list_store),
+            GTK_TREE_SORTABLE_UNSORTED_SORT_COLUMN_ID,
+            GTK_SORT_ASCENDING);
+}
+
+void sui_user_list_thaw(SuiUserList *self){
+    g_return_if_fail(self->freeze_count > 0);
+
+    if (--self->freeze_count > 0){
+        return;
+    }
+
+    gtk_tree_sortable_set_sort_column_id(
+            GTK_TREE_SORTABLE(self->user_list_store),
+            GTK_TREE_SORTABLE_DEFAULT_SORT_COLUMN_ID,
+            GTK_SORT_ASCENDING);
+    gtk_tree_view_set_model(self->user_tree_view,
+            self->user_tree_model_filter);
+    g_signal_handlers_unblock_by_func(self->user_list_store,
+            user_list_store_on_row_changed, self);
+    stat_label_update_stat(self);
+}
+
 void sui_user_list_clear(SuiUserList *self){
     gtk_list_store_clear(self->user_list_store);
     memset(&self->user_stat, 0, sizeof(self->user_stat));
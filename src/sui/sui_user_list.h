@@ -35,6 +35,8 @@ SuiUserList *sui_user_list_new(void);
 void sui_user_list_add_user(SuiUserList *list, SuiUser *user);
 void sui_user_list_rm_user(SuiUserList *list, SuiUser *user);
 void sui_user_list_update_user(SuiUserList *list, SuiUser *user);
+void sui_user_list_freeze(SuiUserList *list);
+void sui_user_list_thaw(SuiUserList *list);
 void sui_user_list_clear(SuiUserList *list);
 GList* sui_user_list_get_users_by_prefix(SuiUserList *self, const char *prefix);
 
@@ -408,7 +408,11 @@ void sui_window_add_buffer(SuiWindow *self, SuiBuffer *buf){
     gtk_stack_add_named(self->buffer_stack, GTK_WIDGET(buf), gstr->str);
     g_string_free(gstr, TRUE);
 
-    gtk_stack_set_visible_child(self->buffer_stack, GTK_WIDGET(buf));
+    /* Chat buffers stay in background until they are activated, so that the
+     * content of them need not to be built */
+    if (SUI_IS_SERVER_BUFFER(buf)){
+        gtk_stack_set_visible_child(self->buffer_stack, GTK_WIDGET(buf));
+    }
     set_server_visibility(self);
 }
 